@@ -16,6 +16,7 @@
 #define PRS_BITMAP_H
 
 #include "export.h"
+#include "file.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -96,6 +97,10 @@ PRS_EXPORT Bitmap *create_bitmap(int width, int height);
 PRS_EXPORT Bitmap *load_bitmap(const char *filename);
 /** @brief Write/Overwrite a bitmap file. */
 PRS_EXPORT int write_bitmap(Bitmap *bitmap, const char *filename);
+/** @brief Load a bitmap from an open file, e.g. a memory file. */
+PRS_EXPORT Bitmap *load_file_bitmap(file_t *file);
+/** @brief Write a bitmap to an open file, e.g. a memory file. */
+PRS_EXPORT int write_file_bitmap(Bitmap *bitmap, file_t *file);
 /** @brief Flip bitmap vertically. */
 PRS_EXPORT void flip_vertical_bitmap(Bitmap **bitmap);
 /** @brief Randomise data inside bitmap. */
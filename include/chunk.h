@@ -0,0 +1,80 @@
+/**
+ * @file chunk.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Content defined chunking of files, for deduplication.
+ **********************************************************************
+ * @details Chunk boundaries come from a gear rolling hash over the
+ * bytes themselves, the way FastCDC picks them, so an insert or delete
+ * only changes the chunks around it. Every chunk comes with a 128 bit
+ * hash to tell it apart from the others. Boundaries only depend on the
+ * data and the sizes, they stay the same between versions.
+ **********************************************************************
+ */
+
+#ifndef PRS_CHUNK_H
+#define PRS_CHUNK_H
+
+#include <stddef.h>
+#include "export.h"
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHUNK_MIN_DEFAULT 2048	/**< Default smallest chunk. */
+#define CHUNK_AVG_DEFAULT 8192	/**< Default average chunk. */
+#define CHUNK_MAX_DEFAULT 65536	/**< Default largest chunk. */
+
+/** @brief Chunk sizes and the state of chunking a file. */
+typedef struct chunk chunk_t;
+
+/** @brief One chunk of a file. */
+typedef struct chunk_block {
+	file_off_t offset;	/**< Offset of the chunk in the file. */
+	size_t length;		/**< Bytes in the chunk. */
+	unsigned long long hash[2];	/**< MurmurHash3 x64_128 of them. */
+	const unsigned char *data;	/**< The bytes, until the next call. */
+} chunk_block_t;
+
+/** @brief Called for every chunk; non-zero stops chunking. */
+typedef int (*chunk_each_t)(const chunk_block_t *block, void *arg);
+
+/**
+ * @brief Create a chunker for chunks of min to max bytes, avg on average.
+ *
+ * Zero picks the default for a size. avg must be a power of two from 64
+ * on and min < avg < max; returns NULL if not or memory runs out.
+ */
+PRS_EXPORT chunk_t *create_chunk(size_t min, size_t avg, size_t max);
+/** @brief Destroy a chunker. */
+PRS_EXPORT void destroy_chunk(chunk_t **chunk);
+
+/**
+ * @brief Length of the first chunk of len bytes at buf.
+ *
+ * Returns less than len only at a boundary; len itself means there was
+ * none, and more data is needed to tell unless this is the end.
+ */
+PRS_EXPORT size_t cut_chunk(const chunk_t *chunk, const void *buf,
+	size_t len);
+
+/**
+ * @brief Next chunk from the current position of file.
+ *
+ * Returns 1 and leaves the file just past the chunk, 0 at the end of
+ * the file and -1 on error. A file left where the last call left it
+ * goes on with the bytes already read.
+ */
+PRS_EXPORT int chunk_file(file_t *file, chunk_t *chunk, chunk_block_t *block);
+/** @brief Call each for every chunk from the current position on;
+ * returns how many there were or -1. */
+PRS_EXPORT file_off_t chunk_all_file(file_t *file, chunk_t *chunk,
+	chunk_each_t each, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
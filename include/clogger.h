@@ -14,7 +14,9 @@
 #ifndef PRS_CLOGGER_H
 #define PRS_CLOGGER_H
 
+#include <stddef.h>
 #include "export.h"
+#include "file.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +27,7 @@ extern "C" {
 #endif
 
 #define MAX_LOGS 5 /**< Max number of logs */
+#define CLOG_RING 1048576 /**< Default bytes in the ring of an async log */
 
 /**
  * @brief Error codes for clogger.
@@ -48,14 +51,59 @@ enum CLOG_ENUM {
 	CLOG4
 };
 
+/**
+ * @brief What write_log() does when the ring of an async log is full.
+ */
+enum CLOG_OVERFLOW {
+	CLOG_BLOCK, /**< Wait for the flusher to make room. */
+	CLOG_DROP,  /**< Drop the message. */
+	CLOG_COUNT  /**< Drop it and write how many were dropped to the log. */
+};
+
 /** @brief This function must be run first. */
 PRS_EXPORT void init_logger();
 /** @brief Open a log file for reading writing. */
 PRS_EXPORT void open_log(int logNum, const char *name);
-/** @brief Read a log file. */
+/** @brief Use an open file (e.g. a memory file) as log, which owns it. */
+PRS_EXPORT void attach_log(int logNum, file_t *file);
+/** @brief Read a line of a log file; returns '\n', EOF or the last byte. */
 PRS_EXPORT int read_log(int logNum, char *buf, int size);
 /** @brief Write to a log file. */
 PRS_EXPORT void write_log(int logNum, const char *data, ...);
+/**
+ * @brief Make writes to a log asynchronous; zero on success.
+ *
+ * Write_log() formats into a lock-free ring of size bytes (zero for
+ * CLOG_RING, rounded up to a power of two) and returns; a thread of the
+ * log writes the messages out in batches and flushes once per batch.
+ * Overflow is one of CLOG_OVERFLOW. Messages over a quarter of the ring
+ * are cut short. Lasts until close_log().
+ */
+PRS_EXPORT int set_async_log(int logNum, size_t size, int overflow);
+/** @brief Wait until every message written so far is flushed to the file. */
+PRS_EXPORT void flush_log(int logNum);
+/** @brief Get the number of messages an async log dropped when full. */
+PRS_EXPORT unsigned long get_dropped_log(int logNum);
+/**
+ * @brief Make write_log() store binary records; zero on success.
+ *
+ * A record holds the id of the format, the time in nanoseconds and the
+ * arguments as raw bytes, strings copied; formatting is left to
+ * decode_log(). Each format is written to the log once, the first time
+ * it is used, and known by its address after that, so formats must not
+ * change (string literals). Ones with conversions that cannot be stored
+ * raw (%n, wide or long double) are formatted at once instead. The log
+ * should be opened in binary mode, see attach_log().
+ */
+PRS_EXPORT int set_binary_log(int logNum);
+/**
+ * @brief Turn a binary log into text, a record at a time.
+ *
+ * With stamp non-zero each message starts with its UTC time. Returns the
+ * number of messages written, or -1 if in is not a binary log or is
+ * damaged; a record cut off at the end is left out.
+ */
+PRS_EXPORT long decode_log(file_t *in, file_t *out, int stamp);
 /** @brief Close an opened log file. */
 PRS_EXPORT void close_log(int logNum);
 /** @brief Print status of log file. */
@@ -0,0 +1,34 @@
+/**
+ * @file crc.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief CRC32C (Castagnoli) checksums.
+ **********************************************************************
+ * @details Uses the SSE4.2 crc32 instruction when the CPU has it and
+ * slicing-by-8 tables otherwise. Checksums of neighbouring pieces can
+ * be combined, so pieces may be checksummed on different threads.
+ **********************************************************************
+ */
+
+#ifndef PRS_CRC_H
+#define PRS_CRC_H
+
+#include <stddef.h>
+#include "export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Add len bytes to crc (start from 0); returns the new crc. */
+PRS_EXPORT unsigned int update_crc(unsigned int crc, const void *buf,
+	size_t len);
+/** @brief Checksum of A followed by B, from both and B's length. */
+PRS_EXPORT unsigned int combine_crc(unsigned int crc_a, unsigned int crc_b,
+	size_t len_b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,15 +37,126 @@ enum {
     FILE_ERROR_READ,
     FILE_ERROR_WRITE,
     FILE_ERROR_SEEK,
-    FILE_ERROR_TELL
+    FILE_ERROR_TELL,
+    FILE_ERROR_UTF8
+};
+
+/** @brief Access patterns for advise_file(). */
+enum {
+    FILE_ADVISE_NORMAL,             /**< No special treatment. */
+    FILE_ADVISE_SEQUENTIAL,         /**< Read in order, read far ahead. */
+    FILE_ADVISE_RANDOM,             /**< Read in no order, no read-ahead. */
+    FILE_ADVISE_WILLNEED,           /**< Range is needed soon, load it. */
+    FILE_ADVISE_DONTNEED            /**< Range is done with, drop it. */
 };
 
 /** @brief File structure, for handling files in this library. */
 typedef struct file file_t;
 
-/** @brief Open a file with open mode. */
+/**
+ * @brief Buffers every file_t starts with, used by GETC_FILE() and
+ * PUTC_FILE(); not to be touched otherwise.
+ */
+typedef struct file_buf {
+    char* rbuf;                     /**< Bytes read ahead. */
+    size_t rpos;                    /**< Bytes of rbuf handed out. */
+    size_t rlen;                    /**< Bytes of rbuf filled. */
+    char* wbuf;                     /**< Bytes waiting to be written. */
+    size_t wlen;                    /**< Bytes of wbuf in use. */
+    size_t wcap;                    /**< Room PUTC_FILE() may use in wbuf. */
+} file_buf_t;
+
+/** @brief Signed 64-bit file offset, size or line number. */
+#if defined(_MSC_VER)
+typedef __int64 file_off_t;
+#else
+typedef long long file_off_t;
+#endif
+
+/** @brief One buffer of a vectored read or write. */
+typedef struct file_vec {
+    void* buf;                      /**< Start of the buffer. */
+    size_t len;                     /**< Length of the buffer in bytes. */
+} file_vec_t;
+
+/**
+ * @brief Completion callback for asynchronous requests.
+ *
+ * Gets the file and buffer of the request, the number of bytes moved
+ * (-1 on failure), a FILE_ERROR_* code and the user data pointer.
+ */
+typedef void (*file_done_t)(file_t* file, void* buf, file_off_t bytes,
+    int err, void* data);
+
+/**
+ * @brief Backend of a file opened with open_io_file().
+ *
+ * Every call gets the ctx pointer given at open. read and write return
+ * the bytes moved or -1, seek moves to *off from whence and stores the
+ * new position back into *off, returning zero on success. Unused
+ * callbacks may be NULL; close releases ctx when the file is closed.
+ */
+typedef struct file_io {
+    long (*read)(void* ctx, void* buf, size_t len);
+    long (*write)(void* ctx, const void* buf, size_t len);
+    int (*seek)(void* ctx, file_off_t* off, int whence);
+    int (*close)(void* ctx);
+} file_io_t;
+
+/**
+ * @brief Defined where files can be made of a backend.
+ *
+ * Open_io_file(), open_memory_file(), get_memory_file() and mode 'z'
+ * need a stream made of callbacks (fopencookie or funopen), which
+ * windows and some C libraries do not have.
+ */
+#if defined(__linux) || defined(__APPLE__) || defined(__FreeBSD__) || \
+    defined(__NetBSD__) || defined(__OpenBSD__)
+#define FILE_HAVE_IO 1
+#endif
+
+/**
+ * @brief Open a file with open mode.
+ *
+ * Mode is the same as fopen() with a few additions, 'm' maps a file
+ * opened read-only (e.g. "rbm") so it can be read in place with
+ * get_view_file(). 'z' reads or writes a stream of compressed blocks
+ * (see lz.h). 'd' reads or writes around the page cache with direct
+ * I/O, falling back to plain I/O where the file system refuses it; no
+ * stdio buffer sits in between, whole blocks of a buffer from
+ * alloc_direct_file() go to the disk as they are. Files opened with 'z'
+ * are read only or write only, with 'd' and '+' they are plain files.
+ */
 PRS_EXPORT file_t*
 open_file(const char* filename, const char* mode);
+/**
+ * @brief Open a file over an already open descriptor, which it owns.
+ *
+ * The descriptor is closed if the file cannot be opened.
+ */
+PRS_EXPORT file_t*
+open_fd_file(int fd, const char* mode);
+/** @brief Open an anonymous file living in memory (memfd or tmpfile). */
+PRS_EXPORT file_t*
+open_memfd_file(const char* name, const char* mode);
+#ifdef FILE_HAVE_IO
+/**
+ * @brief Open a growable in-memory file holding a copy of data.
+ *
+ * Mode 'w' starts empty; get_memory_file() returns the contents.
+ */
+PRS_EXPORT file_t*
+open_memory_file(const void* data, size_t len, const char* mode);
+/**
+ * @brief Open a file over a user backend; name is only for display.
+ *
+ * Data goes straight between the file's own buffers and the backend;
+ * the stream made of it is unbuffered and only carries formatted I/O.
+ */
+PRS_EXPORT file_t*
+open_io_file(const file_io_t* io, void* ctx, const char* name,
+    const char* mode);
+#endif
 /** @brief Reopen a file with open mode. */
 PRS_EXPORT file_t*
 reopen_file(file_t *file, const char* mode);
@@ -60,15 +171,34 @@ PRS_EXPORT void
 close_file(file_t* file);
 
 /** @brief Read from a file, this is like fread(). */
-PRS_EXPORT int
+PRS_EXPORT size_t
 read_file (file_t* file, void* buf, size_t nmem, size_t size);
 /** @brief Write to a file, this is like fwrite(). */
-PRS_EXPORT int
+PRS_EXPORT size_t
 write_file (file_t* file, const void* buf, size_t nmem, size_t size);
+/**
+ * @brief Read len bytes at offset; returns bytes read.
+ *
+ * Leaves the file position alone and can be called from several
+ * threads at once. Flush pending writes before using it.
+ */
+PRS_EXPORT size_t
+read_at_file (file_t* file, void* buf, size_t len, file_off_t offset);
+/** @brief Write several buffers at once; returns bytes written. */
+PRS_EXPORT size_t
+writev_file (file_t* file, const file_vec_t* vec, int count);
+/** @brief Read into several buffers at once; returns bytes read. */
+PRS_EXPORT size_t
+readv_file (file_t* file, const file_vec_t* vec, int count);
 /** @brief Write formatted text to file. */
 PRS_EXPORT int
 writef_file (file_t* file, const char* buf, ...);
-/** @brief Read formatted text from file. */
+/**
+ * @brief Read formatted text from file.
+ *
+ * Fails with FILE_ERROR_READ, reading nothing, while bytes read ahead
+ * from a stream that cannot seek back (a pipe) are still unread.
+ */
 PRS_EXPORT int
 readf_file (file_t* file, const char* buf, ...);
 /** @brief Like vprintf() but, for files. */
@@ -77,9 +207,27 @@ vwritef_file (file_t* file, const char* buf, va_list ap);
 /** @brief Get line of text from file. */
 PRS_EXPORT char*
 gets_file (file_t* file, char* buf, long size);
+/**
+ * @brief Get next line of text without copying it.
+ *
+ * Returns a pointer to the line (newline included, not NUL terminated)
+ * and its length in len, or NULL at end of file. The line lives in a
+ * buffer owned by the file and is valid until the next call on it.
+ */
+PRS_EXPORT const char*
+next_line_file (file_t* file, size_t* len);
 /** @brief Put line of text to file. */
 PRS_EXPORT int
 puts_file (file_t* file, const char* buf);
+/** @brief Write integer as text, buffered; faster than writef_file(). */
+PRS_EXPORT int
+write_i64_file (file_t* file, long long value);
+/** @brief Write double as shortest round trip text, buffered. */
+PRS_EXPORT int
+write_f64_file (file_t* file, double value);
+/** @brief Write string, buffered along with the typed writers. */
+PRS_EXPORT int
+write_str_file (file_t* file, const char* str);
 /** @brief Get character from file. */
 PRS_EXPORT int
 getc_file (file_t* file);
@@ -89,18 +237,121 @@ putc_file (file_t* file, int c);
 /** @brief Put character back on buffer. */
 PRS_EXPORT void
 ungetc_file (file_t* file, int c);
+/** @brief Refill for GETC_FILE(), use that instead. */
+PRS_EXPORT int
+fill_getc_file (file_t* file);
+/** @brief Flush for PUTC_FILE(), use that instead. */
+PRS_EXPORT int
+flush_putc_file (file_t* file, int c);
+
+/**
+ * @brief Get character from file like getc_file(), without a call.
+ *
+ * Works on the file's own buffer and calls into the library only to
+ * refill it, which is where errors are reported. Evaluates f more than
+ * once.
+ */
+#define GETC_FILE(f) \
+    (((file_buf_t*)(f))->rpos < ((file_buf_t*)(f))->rlen ? \
+    (int)(unsigned char)((file_buf_t*)(f))->rbuf[((file_buf_t*)(f))->rpos++] \
+    : fill_getc_file(f))
+/**
+ * @brief Put character to file like putc_file(), without a call.
+ *
+ * Returns c, or EOF when it cannot be buffered; write errors show up
+ * when the buffer is flushed. Evaluates f more than once.
+ */
+#define PUTC_FILE(f, c) \
+    (((file_buf_t*)(f))->wlen < ((file_buf_t*)(f))->wcap ? \
+    (int)(unsigned char)(((file_buf_t*)(f))->wbuf[ \
+    ((file_buf_t*)(f))->wlen++] = (char)(c)) : flush_putc_file((f), (c)))
 /** @brief Seek through file. */
 PRS_EXPORT int
 seek_file (file_t* file, long bytes, int seek);
+/** @brief Seek through file with a 64-bit offset. */
+PRS_EXPORT int
+seek64_file (file_t* file, file_off_t bytes, int seek);
 /** @brief Rewind file, start from beginning. */
 PRS_EXPORT void
 rewind_file (file_t* file);
 /** @brief Tell file, where are we in the file. */
 PRS_EXPORT long
 tell_file (file_t* file);
+/** @brief Tell file, where are we in the file as a 64-bit offset. */
+PRS_EXPORT file_off_t
+tell64_file (file_t* file);
 /** @brief Flush file. */
 PRS_EXPORT int
 flush_file (file_t* file);
+/**
+ * @brief Give the kernel a FILE_ADVISE_* hint about a range of the file.
+ *
+ * A len of zero means up to the end of the file. Goes to madvise() for
+ * mapped files and posix_fadvise() otherwise; DONTNEED syncs a written
+ * file first so its pages can really be dropped. Returns zero when the
+ * hint was taken or there is nothing to give it to, -1 on failure.
+ */
+PRS_EXPORT int
+advise_file (file_t* file, file_off_t offset, file_off_t len, int pattern);
+/**
+ * @brief Give the stream a buffer of size bytes, zero for none.
+ *
+ * Call right after opening, before the first read or write. Files made
+ * of a backend have no stream buffer and return -1.
+ */
+PRS_EXPORT int
+set_buffer_file (file_t* file, size_t size);
+/** @brief Allocate a buffer aligned for direct I/O, writes skip a copy. */
+PRS_EXPORT void*
+alloc_direct_file (size_t size);
+/** @brief Free a buffer from alloc_direct_file(). */
+PRS_EXPORT void
+free_direct_file (void* ptr);
+
+/**
+ * @brief Start an asynchronous read of len bytes at offset.
+ *
+ * Requests run on io_uring where the kernel has it and on a pool of
+ * worker threads otherwise. They work on the underlying descriptor at
+ * an explicit offset and leave the file position alone. Submitting,
+ * reaping and closing files with requests pending is not locked and
+ * must all happen on one thread. close_file() waits for the requests
+ * of its file and runs their callbacks first.
+ */
+PRS_EXPORT int
+submit_read_file (file_t* file, void* buf, size_t len, file_off_t offset,
+    file_done_t done, void* data);
+/** @brief Start an asynchronous write of len bytes at offset. */
+PRS_EXPORT int
+submit_write_file (file_t* file, const void* buf, size_t len,
+    file_off_t offset, file_done_t done, void* data);
+/** @brief Run callbacks of finished requests, wait for one if asked. */
+PRS_EXPORT int
+reap_file (int wait);
+
+/**
+ * @brief Reserve disk blocks for the next bytes written to file.
+ *
+ * Keeps the size of the file, so appends and get_size_file() are not
+ * affected, and blocks left unused are given back on close. Returns
+ * zero on success, -1 where the system cannot reserve.
+ */
+PRS_EXPORT int
+reserve_file (file_t* file, file_off_t bytes);
+/** @brief Copy the rest of src to dst; returns bytes copied. */
+PRS_EXPORT file_off_t
+copy_file (file_t* src, file_t* dst);
+/**
+ * @brief Copy len bytes from src_off in src to dst_off in dst.
+ *
+ * Uses copy_file_range() (sharing extents on file systems that can),
+ * then sendfile(), then a large buffer. Holes in src found with
+ * SEEK_DATA/SEEK_HOLE are not read and stay holes in dst. File
+ * positions are unchanged.
+ */
+PRS_EXPORT file_off_t
+copy_range_file (file_t* src, file_off_t src_off, file_t* dst,
+    file_off_t dst_off, file_off_t len);
 
 /** @brief Get the name of the file. */
 PRS_EXPORT const char*
@@ -108,9 +359,53 @@ get_name_file (file_t* file);
 /** @brief Get the size of the file in bytes. */
 PRS_EXPORT long
 get_size_file (file_t* file);
+/** @brief Get the size of the file in bytes as a 64-bit value. */
+PRS_EXPORT file_off_t
+get_size64_file (file_t* file);
 /** @brief Get the number of lines in the file. */
 PRS_EXPORT int
 get_lines_file (file_t* file);
+/** @brief Get the number of lines in the file as a 64-bit value. */
+PRS_EXPORT file_off_t
+get_lines64_file (file_t* file);
+/** @brief Seek to the start of a line (zero based) using the line index. */
+PRS_EXPORT int
+get_line_at_file (file_t* file, file_off_t line);
+/** @brief Get the mapped view of a file opened with 'm' (or NULL). */
+PRS_EXPORT const void*
+get_view_file (file_t* file, size_t* len);
+/**
+ * @brief Start (on non-zero) or stop checksumming data, resetting it.
+ *
+ * Covers data moved by read_file(), write_file(), readv_file(),
+ * writev_file() and the typed writers; not formatted text or lines.
+ */
+PRS_EXPORT void
+set_checksum_file (file_t* file, int on);
+/** @brief Get CRC32C of data moved since set_checksum_file(), see crc.h. */
+PRS_EXPORT unsigned int
+get_checksum_file (file_t* file);
+/**
+ * @brief Start (on non-zero) or stop checking text read is UTF-8.
+ *
+ * Covers read_file(), gets_file(), next_line_file() and GETC_FILE(),
+ * reading straight through; the read-ahead is checked as it is filled,
+ * so bad text costs no extra pass. The first bad byte sets
+ * FILE_ERROR_UTF8, see utf8.h.
+ */
+PRS_EXPORT void
+set_utf8_file (file_t* file, int on);
+/**
+ * @brief Get the offset, in bytes read since set_utf8_file(), of the
+ * first one that is not well formed UTF-8, or -1 if none.
+ */
+PRS_EXPORT file_off_t
+check_utf8_file (file_t* file);
+#ifdef FILE_HAVE_IO
+/** @brief Get the contents of a memory file, NULL for other files. */
+PRS_EXPORT const void*
+get_memory_file (file_t* file, size_t* len);
+#endif
 /** @brief Get the handle to the file. */
 PRS_EXPORT FILE*
 get_handle_file (file_t* file);
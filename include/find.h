@@ -0,0 +1,66 @@
+/**
+ * @file find.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Fast search for literal patterns in files.
+ **********************************************************************
+ * @details One pattern is looked for by comparing its first and last
+ * bytes sixteen or thirty two places at a time; several go through an
+ * Aho-Corasick automaton in one pass. Every match is reported, ones
+ * that overlap included, with its offset and line number.
+ **********************************************************************
+ */
+
+#ifndef PRS_FIND_H
+#define PRS_FIND_H
+
+#include <stddef.h>
+#include "export.h"
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Set of patterns to search for. */
+typedef struct find find_t;
+
+/** @brief One match of a pattern. */
+typedef struct find_match {
+	file_off_t offset;	/**< Offset of the first byte of the match. */
+	file_off_t line;	/**< Zero based line the match starts on. */
+	size_t pattern;		/**< Index of the pattern that matched. */
+} find_match_t;
+
+/** @brief Called for every match; non-zero stops the search. */
+typedef int (*find_each_t)(const find_match_t *match, void *arg);
+
+/**
+ * @brief Create a set of count patterns to search for.
+ *
+ * Patterns are NUL terminated and not empty; they are copied. Returns
+ * NULL if one is empty or memory runs out.
+ */
+PRS_EXPORT find_t *create_find(const char **patterns, size_t count);
+/** @brief Destroy a set of patterns. */
+PRS_EXPORT void destroy_find(find_t **find);
+
+/**
+ * @brief Find the next match from the current position of file.
+ *
+ * Returns 1 and leaves the file just past the match, 0 when there is
+ * none left and -1 when memory runs out. A file left where the last
+ * search with find left it is carried on with, overlapping matches
+ * included; matches come in the order they end, longer ones first.
+ */
+PRS_EXPORT int find_file(file_t *file, find_t *find, find_match_t *match);
+/** @brief Call each for every match from the current position on;
+ * returns how many there were or -1. */
+PRS_EXPORT file_off_t find_all_file(file_t *file, find_t *find,
+	find_each_t each, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * @file hash.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Fast non-cryptographic hashes of blocks of memory.
+ **********************************************************************
+ * @details The 64 bit hash is XXH64 and the 128 bit one MurmurHash3
+ * x64_128, both giving the same values as their reference code, so
+ * they can be checked against other tools. Neither is any good
+ * against someone choosing the data on purpose.
+ **********************************************************************
+ */
+
+#ifndef PRS_HASH_H
+#define PRS_HASH_H
+
+#include <stddef.h>
+#include "export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief XXH64 of len bytes with seed. */
+PRS_EXPORT unsigned long long digest64_hash(const void *buf, size_t len,
+	unsigned long long seed);
+/** @brief MurmurHash3 x64_128 of len bytes with seed, into out. */
+PRS_EXPORT void digest128_hash(const void *buf, size_t len, unsigned int seed,
+	unsigned long long out[2]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
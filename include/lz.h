@@ -0,0 +1,52 @@
+/**
+ * @file lz.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Small and fast LZ77 block codec.
+ **********************************************************************
+ * @details Each block is compressed on its own, so blocks can be
+ * decoded in any order and on any thread. The format is a list of
+ * sequences, one token byte (literal length in the high nibble, match
+ * length minus four in the low one, 15 meaning more length bytes of
+ * up to 255 follow), the literals, then a two byte little endian match
+ * offset. The last sequence has literals only.
+ *
+ * Files opened with mode 'z' (see open_file()) are framed as an eight
+ * byte header "PRSZ", version 1 and three zero bytes, then blocks of
+ * a four byte little endian raw length, a four byte little endian
+ * stored length with LZ_STORED set when the block was kept as is, and
+ * the stored bytes.
+ **********************************************************************
+ */
+
+#ifndef PRS_LZ_H
+#define PRS_LZ_H
+
+#include <stddef.h>
+#include "export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Bit of a frame's stored length for uncompressed blocks. */
+#define LZ_STORED 0x80000000UL
+
+/** @brief Largest compressed size of len bytes. */
+PRS_EXPORT size_t bound_lz(size_t len);
+/** @brief Compress a block; returns its size, zero if over cap. */
+PRS_EXPORT size_t compress_lz(const void *src, size_t len, void *dst,
+	size_t cap);
+/**
+ * @brief Decompress a whole block; zero on success, -1 when corrupt.
+ *
+ * On entry *dlen is the room in dst, on return the bytes written.
+ */
+PRS_EXPORT int decompress_lz(const void *src, size_t len, void *dst,
+	size_t *dlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file pfile.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Parallel processing of text files by whole lines.
+ **********************************************************************
+ * @details Split a file into byte ranges that start and end on line
+ * boundaries, run a callback on every range from a pool of worker
+ * threads and merge the results in file order on the calling thread.
+ **********************************************************************
+ */
+
+#ifndef PRS_PFILE_H
+#define PRS_PFILE_H
+
+#include <stddef.h>
+#include "export.h"
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Range of whole lines handed to a worker. */
+typedef struct pfile_chunk {
+	const char *data;       /**< Bytes of the chunk (not NUL terminated). */
+	size_t len;             /**< Length of data in bytes. */
+	file_off_t offset;      /**< Offset of data in the file. */
+	int index;              /**< Chunk number in file order. */
+} pfile_chunk_t;
+
+/** @brief Work on one chunk (worker thread), returns its result. */
+typedef void *(*pfile_map_t)(const pfile_chunk_t *chunk, void *arg);
+/** @brief Merge one chunk result (calling thread, in file order). */
+typedef void (*pfile_reduce_t)(void *result, void *arg);
+
+/**
+ * @brief Split a file into line aligned ranges.
+ *
+ * Fills bounds with up to chunks+1 offsets, chunk i being
+ * [bounds[i], bounds[i+1]). Returns the number of chunks, which can
+ * be less than asked for when lines are long, or -1 on error.
+ */
+PRS_EXPORT int split_pfile(file_t *file, int chunks, file_off_t *bounds);
+/**
+ * @brief Run map on every chunk in parallel, then reduce in order.
+ *
+ * Chunks of zero (or less) picks a count from the file size; threads
+ * of zero (or less) uses one per CPU. Mapped files (mode 'm') hand out
+ * slices of the view, others read each chunk into its own buffer.
+ * Returns zero on success.
+ */
+PRS_EXPORT int run_pfile(file_t *file, int chunks, int threads,
+	pfile_map_t map, pfile_reduce_t reduce, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @file record.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Files of fixed size binary records with random access.
+ **********************************************************************
+ * @details A record file is a 32 byte header, "PRSR", a four byte
+ * little endian version (1), the eight byte little endian record size
+ * and record count and eight zero bytes, followed by the records packed
+ * one after another. Record i is at 32 + i * size, so reading or
+ * writing any record is one seek. Records are stored as given, so
+ * files only move between hosts with the same struct layout.
+ **********************************************************************
+ */
+
+#ifndef PRS_RECORD_H
+#define PRS_RECORD_H
+
+#include <stddef.h>
+#include "export.h"
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RECORD_HEADER 32	/**< Bytes before the first record. */
+
+/** @brief Open file of fixed size records. */
+typedef struct record record_t;
+
+/**
+ * @brief Open a record file.
+ *
+ * Mode "r" maps the file read only, "r+" reads and writes and "w"
+ * creates or truncates it for both. A size of zero takes the record
+ * size from the header, other sizes must match it (and are needed for
+ * "w"). The count comes from the length of the file, so records added
+ * after the last sync_record() survive a crash; a torn last record is
+ * dropped. Returns NULL on error.
+ */
+PRS_EXPORT record_t *open_record(const char *filename, const char *mode,
+	size_t size);
+/** @brief Write the count into the header and close the file. */
+PRS_EXPORT void close_record(record_t *rec);
+/** @brief Write the count into the header and flush; zero on success. */
+PRS_EXPORT int sync_record(record_t *rec);
+
+/** @brief Copy record index into out; zero on success, -1 if none. */
+PRS_EXPORT int get_record(record_t *rec, file_off_t index, void *out);
+/** @brief Write record index, or add it when index is the count. */
+PRS_EXPORT int put_record(record_t *rec, file_off_t index, const void *data);
+/** @brief Add n records at the end; returns the first index or -1. */
+PRS_EXPORT file_off_t append_record(record_t *rec, const void *data,
+	size_t n);
+/** @brief Get the records of a file opened with "r" in place (or NULL). */
+PRS_EXPORT const void *get_view_record(record_t *rec, file_off_t *count);
+/** @brief Get the number of records. */
+PRS_EXPORT file_off_t get_count_record(record_t *rec);
+/** @brief Get the size of a record in bytes. */
+PRS_EXPORT size_t get_size_record(record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
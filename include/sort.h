@@ -0,0 +1,77 @@
+/**
+ * @file sort.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief External merge sort of lines or fixed size records.
+ **********************************************************************
+ * @details Input is cut in runs that fit the memory given, each run is
+ * sorted in slices on a thread pool and written out to a temporary file
+ * while the slices are merged, then all runs are merged into the output
+ * with large sequential reads. Input that fits in one run never touches
+ * the disk. The sort is stable, equal records keep their input order.
+ **********************************************************************
+ */
+
+#ifndef PRS_SORT_H
+#define PRS_SORT_H
+
+#include <stddef.h>
+#include "export.h"
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Compare two records; less, equal or more than zero.
+ *
+ * Lines come without their newline.
+ */
+typedef int (*sort_cmp_t)(const void *a, size_t alen, const void *b,
+	size_t blen, void *arg);
+
+/** @brief How to sort, record size, key, memory and threads. */
+typedef struct sort sort_t;
+
+/**
+ * @brief Create a sort of records of size bytes, 0 for lines of text.
+ *
+ * Records are compared byte by byte as unsigned, the whole of them
+ * until set_key_sort() or set_compare_sort() say otherwise. 256 MB of
+ * memory, a thread per CPU and TMPDIR (or /tmp) are used by default.
+ */
+PRS_EXPORT sort_t *create_sort(size_t size);
+/** @brief Destroy a sort. */
+PRS_EXPORT void destroy_sort(sort_t **sort);
+/** @brief Compare only len bytes from offset on (len 0 to the end). */
+PRS_EXPORT void set_key_sort(sort_t *sort, size_t offset, size_t len);
+/** @brief Compare with cmp instead of bytes (NULL for bytes again). */
+PRS_EXPORT void set_compare_sort(sort_t *sort, sort_cmp_t cmp, void *arg);
+/**
+ * @brief Bytes of memory to sort in, at least 64 KB.
+ *
+ * The run buffers and later the merge's read buffers stay within it. On
+ * top come the temporary files, a stdio buffer and a file_t each, and a
+ * line or record longer than half of it grows the buffers to fit.
+ */
+PRS_EXPORT int set_memory_sort(sort_t *sort, size_t bytes);
+/** @brief Threads sorting runs (0 or less uses one per CPU). */
+PRS_EXPORT void set_threads_sort(sort_t *sort, int threads);
+/** @brief Directory for temporary files (NULL for the default). */
+PRS_EXPORT int set_temp_sort(sort_t *sort, const char *dir);
+
+/**
+ * @brief Sort in from its current position into out.
+ *
+ * A last line without a newline gets one. Returns the number of
+ * records written, or -1 on error (a part record at the end of in is
+ * one).
+ */
+PRS_EXPORT file_off_t sort_file(file_t *in, file_t *out, sort_t *sort);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file tpool.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Simple worker thread pool.
+ **********************************************************************
+ * @details Run jobs on a fixed set of worker threads. Jobs are taken
+ * in the order they were added, wait_tpool() blocks until every job
+ * added so far has finished.
+ **********************************************************************
+ */
+
+#ifndef PRS_TPOOL_H
+#define PRS_TPOOL_H
+
+#include "export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Simple worker thread pool type. */
+typedef struct tpool tpool_t;
+
+/** @brief Create a pool of threads (0 or less uses one per CPU). */
+PRS_EXPORT tpool_t *create_tpool(int threads);
+/** @brief Add a job to the pool; returns zero on success. */
+PRS_EXPORT int add_tpool(tpool_t *pool, void (*func)(void *arg), void *arg);
+/** @brief Wait for every job added so far to finish. */
+PRS_EXPORT void wait_tpool(tpool_t *pool);
+/** @brief Finish all jobs, stop the threads and free the pool. */
+PRS_EXPORT void destroy_tpool(tpool_t **pool);
+/** @brief Get number of worker threads in the pool. */
+PRS_EXPORT int get_threads_tpool(tpool_t *pool);
+/** @brief Get number of CPUs available to the process. */
+PRS_EXPORT int get_cpus_tpool(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
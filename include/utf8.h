@@ -0,0 +1,60 @@
+/**
+ * @file utf8.h
+ * @author Philip R. Simonson
+ * @date   2026/10/17
+ * @brief Checking UTF-8 text and converting it to UTF-16 and UTF-32.
+ **********************************************************************
+ * @details Well formed means what RFC 3629 allows: no overlong forms,
+ * no surrogates and nothing past U+10FFFF. Checking looks at sixteen or
+ * thirty two bytes at a time where the processor can, so it runs at
+ * memory speed; set_utf8_file() does it on text as it is read.
+ **********************************************************************
+ */
+
+#ifndef PRS_UTF8_H
+#define PRS_UTF8_H
+
+#include <stddef.h>
+#include "export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Check len bytes of UTF-8.
+ *
+ * Returns the offset of the first byte of the first character that is
+ * not well formed, or len when all of it is. A character cut off at the
+ * end is not well formed.
+ */
+PRS_EXPORT size_t check_utf8(const void *buf, size_t len);
+/**
+ * @brief Find where the last whole character of buf ends.
+ *
+ * Returns len less the bytes of a character cut off at the end (at most
+ * three), so text split anywhere can be checked in pieces.
+ */
+PRS_EXPORT size_t split_utf8(const void *buf, size_t len);
+/**
+ * @brief Convert len bytes of UTF-8 to UTF-16.
+ *
+ * Dst needs room for len units. Returns the units written, or
+ * (size_t)-1 if src is not well formed.
+ */
+PRS_EXPORT size_t decode16_utf8(const void *src, size_t len,
+	unsigned short *dst);
+/**
+ * @brief Convert len bytes of UTF-8 to UTF-32.
+ *
+ * Dst needs room for len code points. Returns the code points written,
+ * or (size_t)-1 if src is not well formed.
+ */
+PRS_EXPORT size_t decode32_utf8(const void *src, size_t len,
+	unsigned int *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
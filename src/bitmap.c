@@ -70,11 +70,19 @@ PRS_EXPORT Bitmap *load_bitmap(const char *filename)
 	file = open_file(filename, "rb");
 	if(file == NULL)
 		return NULL;
+	bmp = load_file_bitmap(file);
+	close_file(file);
+	return bmp;
+}
+/* Gets the data of a bitmap object from an open file.
+ */
+PRS_EXPORT Bitmap *load_file_bitmap(file_t *file)
+{
+	Bitmap *bmp;
 
 	bmp = malloc(sizeof(Bitmap));
 	if(bmp == NULL) {
 		_bitmap_errno = BMP_MALLOC_ERROR;
-		close_file(file);
 		return NULL;
 	}
 
@@ -98,7 +106,7 @@ PRS_EXPORT Bitmap *load_bitmap(const char *filename)
 
 	if(bmp->info.type != 0x4D42 && bmp->info.fsize != bmp->info.isize) {
 		_bitmap_errno = BMP_TYPE_ERROR;
-		close_file(file);
+		free(bmp);
 		return NULL;
 	}
 
@@ -107,13 +115,11 @@ PRS_EXPORT Bitmap *load_bitmap(const char *filename)
 	if(bmp->data == NULL) {
 		_bitmap_errno = BMP_MALLOC_ERROR;
 		free(bmp);
-		close_file(file);
 		return NULL;
 	}
 	memset(bmp->data, 0, bmp->info.isize);
 	seek_file(file, bmp->info.offset, SEEK_SET);
 	read_file(file, bmp->data, 1, bmp->info.isize);
-	close_file(file);
 	return bmp;
 }
 /* Writes blank Bitmap image if not data has been given.
@@ -126,20 +132,28 @@ PRS_EXPORT int write_bitmap(Bitmap *bmp, const char *filename)
 	file = open_file(filename, "wb");
 	if(file == NULL)
 		return 1;
-
-	res = write_file(file, &bmp->info, 1, sizeof(BitmapInfo));
-	if(res < (int)sizeof(BitmapInfo)) {
-		_bitmap_errno = BMP_FILE_ERROR;
-		close_file(file);
-		return 1;
-	}
-	res = write_file(file, bmp->data, 1, bmp->info.isize);
-	if(res < bmp->info.isize) {
+	res = write_file_bitmap(bmp, file);
+	close_file(file);
+	return res;
+}
+/* Writes a bitmap object to an open file.
+ */
+PRS_EXPORT int write_file_bitmap(Bitmap *bmp, file_t *file)
+{
+	file_vec_t vec[2];
+	size_t res;
+
+	/* header and pixels in one go, into space set aside for them */
+	reserve_file(file, (file_off_t)sizeof(BitmapInfo)+bmp->info.isize);
+	vec[0].buf = &bmp->info;
+	vec[0].len = sizeof(BitmapInfo);
+	vec[1].buf = bmp->data;
+	vec[1].len = bmp->info.isize;
+	res = writev_file(file, vec, 2);
+	if(res < sizeof(BitmapInfo)+bmp->info.isize) {
 		_bitmap_errno = BMP_FILE_ERROR;
-		close_file(file);
 		return 1;
 	}
-	close_file(file);
 	return 0;
 }
 /* Checks for valid pixels before plotting.
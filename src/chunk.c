@@ -0,0 +1,246 @@
+/**
+ * @file chunk.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Content defined chunking of files, for deduplication.
+ **************************************************************************
+ * @details The gear hash shifts left one bit per byte and adds a random
+ * value for the byte, so its top bits cover the last 64 bytes. A chunk
+ * ends where the top bits under a mask are all zero; nothing is looked
+ * at in the first min bytes, up to avg the mask has two more bits than
+ * log2(avg) and after it two fewer, which keeps most chunks near avg.
+ **************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "file.h"
+#include "hash.h"
+#include "chunk.h"
+
+#define CHUNK_BUFSIZ (1 << 20)  /* bytes read from the file at once */
+#define CHUNK_SEED 0x5EED0C4D0C4DULL  /* of the gear table, never change */
+
+/* Chunk sizes, with where chunking a file left off.
+ */
+struct chunk {
+	size_t min;
+	size_t avg;
+	size_t max;
+	unsigned long long mask_s;  /* harder mask, before avg */
+	unsigned long long mask_l;  /* easier mask, after it */
+	/* where the last call left off, to carry on from */
+	file_t *file;
+	char name[MAX_PATH];
+	file_off_t after;           /* position the file was left at */
+	int mapped;                 /* chunked through the view */
+	file_off_t base;            /* file offset of buf, or of the next chunk */
+	unsigned char *buf;         /* bytes read, for a file not mapped */
+	size_t size;                /* room in buf */
+	size_t len;                 /* bytes in buf */
+	size_t pos;                 /* start of the next chunk in buf */
+};
+
+static unsigned long long _gear_chunk[256];
+static pthread_once_t _once_chunk = PTHREAD_ONCE_INIT;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Fill the gear table from a fixed seed with splitmix64.
+ */
+static void _init_chunk(void)
+{
+	unsigned long long x = CHUNK_SEED, z;
+	int i;
+	for(i = 0; i < 256; i++) {
+		z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		_gear_chunk[i] = z ^ (z >> 31);
+	}
+}
+/* Create a chunker for chunks of min to max bytes, avg on average.
+ */
+PRS_EXPORT chunk_t *create_chunk(size_t min, size_t avg, size_t max)
+{
+	chunk_t *chunk;
+	int bits;
+	if(min == 0)
+		min = CHUNK_MIN_DEFAULT;
+	if(avg == 0)
+		avg = CHUNK_AVG_DEFAULT;
+	if(max == 0)
+		max = CHUNK_MAX_DEFAULT;
+	if(avg < 64 || (avg & (avg - 1)) != 0 || avg > (1UL << 30) ||
+			min >= avg || max <= avg)
+		return NULL;
+	for(bits = 0; ((size_t)1 << bits) < avg; bits++)
+		;
+	if((chunk = (chunk_t*)calloc(1, sizeof(chunk_t))) == NULL)
+		return NULL;
+	pthread_once(&_once_chunk, _init_chunk);
+	chunk->min = min;
+	chunk->avg = avg;
+	chunk->max = max;
+	chunk->mask_s = ~0ULL << (64 - (bits + 2));
+	chunk->mask_l = ~0ULL << (64 - (bits - 2));
+	chunk->after = -1;
+	return chunk;
+}
+/* Destroy a chunker.
+ */
+PRS_EXPORT void destroy_chunk(chunk_t **chunk)
+{
+	if(chunk == NULL || *chunk == NULL)
+		return;
+	free((*chunk)->buf);
+	free(*chunk);
+	*chunk = NULL;
+}
+/* Length of the first chunk of len bytes at buf.
+ */
+PRS_EXPORT size_t cut_chunk(const chunk_t *chunk, const void *buf,
+	size_t len)
+{
+	const unsigned char *p = (const unsigned char*)buf;
+	unsigned long long h = 0;
+	size_t i = chunk->min, n, normal;
+	if(len <= chunk->min)
+		return len;
+	n = (len < chunk->max) ? len : chunk->max;
+	normal = (n < chunk->avg) ? n : chunk->avg;
+	for(; i < normal; i++) {
+		h = (h << 1) + _gear_chunk[p[i]];
+		if((h & chunk->mask_s) == 0)
+			return i + 1;
+	}
+	for(; i < n; i++) {
+		h = (h << 1) + _gear_chunk[p[i]];
+		if((h & chunk->mask_l) == 0)
+			return i + 1;
+	}
+	return n;
+}
+/* Pick up where the last call left file, or start at its position.
+ */
+static int _start_chunk(file_t *file, chunk_t *chunk)
+{
+	size_t len;
+	file_off_t pos;
+	int mapped;
+	if(chunk == NULL || (pos = tell64_file(file)) < 0)
+		return -1;
+	mapped = (get_view_file(file, &len) != NULL);
+	if(chunk->file == file && chunk->after == pos &&
+			chunk->mapped == mapped &&
+			strcmp(chunk->name, get_name_file(file)) == 0)
+		return 0;
+	if(!mapped && chunk->buf == NULL) {
+		chunk->size = chunk->max + CHUNK_BUFSIZ;
+		if((chunk->buf = (unsigned char*)malloc(chunk->size)) == NULL)
+			return -1;
+	}
+	chunk->file = file;
+	strncpy(chunk->name, get_name_file(file), MAX_PATH-1);
+	chunk->name[MAX_PATH-1] = '\0';
+	chunk->after = pos;
+	chunk->mapped = mapped;
+	chunk->base = pos;
+	chunk->len = chunk->pos = 0;
+	return 0;
+}
+/* Cut the next chunk; returns 1, 0 at the end or -1.
+ */
+static int _next_chunk(file_t *file, chunk_t *chunk, chunk_block_t *block)
+{
+	const unsigned char *view;
+	size_t len, n;
+	if(chunk->mapped) {
+		view = (const unsigned char*)get_view_file(file, &len);
+		if(view == NULL || chunk->base >= (file_off_t)len)
+			return 0;
+		block->offset = chunk->base;
+		block->data = view + (size_t)chunk->base;
+		block->length = cut_chunk(chunk, block->data,
+			len - (size_t)chunk->base);
+		chunk->base += (file_off_t)block->length;
+	} else {
+		if(chunk->len - chunk->pos < chunk->max) {
+			/* top the buffer up, the file goes on where it stopped */
+			memmove(chunk->buf, chunk->buf + chunk->pos,
+				chunk->len - chunk->pos);
+			chunk->base += (file_off_t)chunk->pos;
+			chunk->len -= chunk->pos;
+			chunk->pos = 0;
+			if(chunk->after != chunk->base + (file_off_t)chunk->len) {
+				if(seek64_file(file, chunk->base + (file_off_t)chunk->len,
+						SEEK_SET) < 0)
+					return -1;
+			}
+			while(chunk->len < chunk->size && (n = read_file(file,
+					chunk->buf + chunk->len, 1, chunk->size - chunk->len)) > 0)
+				chunk->len += n;
+			chunk->after = chunk->base + (file_off_t)chunk->len;
+		}
+		if(chunk->pos == chunk->len)
+			return 0;
+		block->offset = chunk->base + (file_off_t)chunk->pos;
+		block->data = chunk->buf + chunk->pos;
+		block->length = cut_chunk(chunk, block->data,
+			chunk->len - chunk->pos);
+		chunk->pos += block->length;
+	}
+	digest128_hash(block->data, block->length, 0, block->hash);
+	return 1;
+}
+/* Leave file just past the last chunk cut, for the next call.
+ */
+static void _leave_chunk(file_t *file, chunk_t *chunk)
+{
+	file_off_t end = chunk->base + (file_off_t)chunk->pos;
+	if(end != chunk->after && seek64_file(file, end, SEEK_SET) == 0)
+		chunk->after = end;
+}
+/* Next chunk from the current position of file.
+ */
+PRS_EXPORT int chunk_file(file_t *file, chunk_t *chunk, chunk_block_t *block)
+{
+	int res;
+	if(_start_chunk(file, chunk) < 0)
+		return -1;
+	if((res = _next_chunk(file, chunk, block)) < 0) {
+		chunk->file = NULL;
+		return -1;
+	}
+	_leave_chunk(file, chunk);
+	return res;
+}
+/* Call each for every chunk from the current position of file on.
+ */
+PRS_EXPORT file_off_t chunk_all_file(file_t *file, chunk_t *chunk,
+	chunk_each_t each, void *arg)
+{
+	chunk_block_t block;
+	file_off_t count = 0;
+	int res;
+	if(_start_chunk(file, chunk) < 0)
+		return -1;
+	while((res = _next_chunk(file, chunk, &block)) > 0) {
+		count++;
+		if(each(&block, arg) != 0)
+			break;
+	}
+	if(res < 0) {
+		chunk->file = NULL;
+		return -1;
+	}
+	_leave_chunk(file, chunk);
+	return count;
+}
+#ifdef __cplusplus
+}
+#endif
@@ -9,23 +9,122 @@
  * forward to use.
  */
 
+#if defined(__linux) || defined(__UNIX__)
+#define _GNU_SOURCE 1
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
 
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #include "file.h"
 #include "clogger.h"
 
+#define CLOG_PAD 0xFFFFFFFFu  /* length word of the skipped end of a ring */
+#define CLOG_LINE 512         /* messages up to this are formatted on stack */
+#define CLOG_MAGIC "PRSLOG\001\n"  /* starts each binary log session */
+#define CLOG_FORMATS 4096     /* slots for the formats of a binary log */
+
+/* Length modifiers of a conversion.
+ */
+enum {
+	CLOG_LEN_NONE,
+	CLOG_LEN_HH,
+	CLOG_LEN_H,
+	CLOG_LEN_L,
+	CLOG_LEN_LL,
+	CLOG_LEN_Z,
+	CLOG_LEN_OTHER
+};
+
+/**
+ * @brief One conversion of a format string.
+ */
+struct CLOG_SPEC {
+	const char *start;            /**< The '%'. */
+	const char *width;            /**< Start of the width. */
+	const char *dot;              /**< Start of the precision. */
+	const char *length;           /**< Start of the length modifier. */
+	const char *end;              /**< Just past the conversion. */
+	int star_width;               /**< Width is an argument. */
+	int star_prec;                /**< Precision is an argument. */
+	long prec;                    /**< Precision in digits, or -1. */
+	int size;                     /**< One of CLOG_LEN_*. */
+	int conv;                     /**< Conversion character. */
+};
+
+/**
+ * @brief Formats of a binary log by address, with their ids.
+ *
+ * Looked up without locking; a new format is written to the log before
+ * it is published, so no message can come before its format.
+ */
+struct CLOG_BINARY {
+	const char *keys[CLOG_FORMATS];  /**< Format in each slot, or NULL. */
+	unsigned int ids[CLOG_FORMATS];  /**< Its id, zero to format at once. */
+	unsigned int count;              /**< Ids given out. */
+	unsigned int used;               /**< Slots taken. */
+	pthread_mutex_t lock;            /**< Serializes adding formats. */
+};
+
+/**
+ * @brief Binary record being put together.
+ */
+struct CLOG_REC {
+	unsigned char *data;          /**< The record, stack or heap. */
+	size_t len;                   /**< Bytes in it. */
+	size_t cap;                   /**< Room in data. */
+	int failed;                   /**< Out of memory. */
+	unsigned char stack[CLOG_LINE];  /**< Room for most records. */
+};
+
+/**
+ * @brief Ring of formatted messages on their way to an async log.
+ *
+ * Records are a four byte length word, four unused bytes and the text,
+ * padded to eight bytes. Producers reserve one by moving head on with a
+ * compare and swap and make it ready by storing length plus one; the
+ * flusher writes ready records from tail, zeroes them and moves tail.
+ */
+struct CLOG_ASYNC {
+	unsigned char *ring;          /**< Records, zero where none is ready. */
+	size_t cap;                   /**< Size of ring, a power of two. */
+	unsigned long long head;      /**< Bytes reserved by producers. */
+	unsigned long long tail;      /**< Bytes written out and freed. */
+	unsigned long long synced;    /**< Bytes flushed to the file. */
+	unsigned long dropped;        /**< Messages dropped in all. */
+	unsigned long noted;          /**< Dropped messages written to the log. */
+	int overflow;                 /**< One of CLOG_OVERFLOW. */
+	int sleeping;                 /**< Flusher waits for a record. */
+	int waiting;                  /**< Producers wait for room. */
+	int stop;                     /**< Flusher is to finish and exit. */
+	pthread_t thread;             /**< The flusher. */
+	pthread_mutex_t lock;         /**< Guards the waits below. */
+	pthread_mutex_t io;           /**< File, between flusher and readers. */
+	pthread_cond_t wake;          /**< Work for the flusher. */
+	pthread_cond_t room;          /**< Room in the ring. */
+	pthread_cond_t done;          /**< Synced moved on. */
+};
+
 /**
  * @brief Structure used for handling log files.
  */
 struct CLOG {
 	file_t *file;    /**< File structure for log file storage. */
 	int status;      /**< Current status of log file number. */
-	long read_pos;   /**< Current read position */
-	long write_pos;  /**< Current write position */
+	file_off_t read_pos;   /**< Current read position */
+	file_off_t write_pos;  /**< Current write position */
+	struct CLOG_ASYNC *async;  /**< Ring and flusher, or NULL if sync. */
+	struct CLOG_BINARY *binary;  /**< Formats, or NULL for text. */
 };
 
 struct CLOG _logs[MAX_LOGS];  /**< Global variable for storing log info */
@@ -39,15 +138,703 @@ extern "C" {
  */
 PRS_EXPORT void close_log(int);
 
+/* Store v little endian in n bytes at p.
+ */
+static void _le_log(unsigned char *p, unsigned long long v, int n)
+{
+	int i;
+	for(i = 0; i < n; i++)
+		p[i] = (unsigned char)(v >> (i * 8));
+}
+/* Little endian n byte number at p.
+ */
+static unsigned long long _get_le_log(const unsigned char *p, int n)
+{
+	unsigned long long v = 0;
+	while(n-- > 0)
+		v = (v << 8) | p[n];
+	return v;
+}
+/* Length word of the record at off in the ring.
+ */
+static unsigned int *_word_log(struct CLOG_ASYNC *async, size_t off)
+{
+	return (unsigned int*)(async->ring + off);
+}
+/* Reserve a record of size bytes (a multiple of eight); returns its
+ * offset in the ring, or (size_t)-1 when the ring is full.
+ */
+static size_t _reserve_log(struct CLOG_ASYNC *async, size_t size)
+{
+	unsigned long long head, tail;
+	size_t off, pad;
+	head = __atomic_load_n(&async->head, __ATOMIC_RELAXED);
+	do {
+		off = (size_t)head & (async->cap - 1);
+		pad = (async->cap - off < size) ? async->cap - off : 0;
+		tail = __atomic_load_n(&async->tail, __ATOMIC_SEQ_CST);
+		if(head + pad + size - tail > async->cap)
+			return (size_t)-1;
+	} while(!__atomic_compare_exchange_n(&async->head, &head,
+		head + pad + size, 1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+	if(pad > 0) {
+		/* too little left before the end, the record starts over */
+		__atomic_store_n(_word_log(async, off), CLOG_PAD, __ATOMIC_SEQ_CST);
+		off = 0;
+	}
+	return off;
+}
+/* Write the ready records from tail to the file in one batch, noting
+ * messages dropped since the last one; returns zero if there was
+ * nothing to write.
+ */
+static int _drain_log(struct CLOG *log)
+{
+	struct CLOG_ASYNC *async = log->async;
+	unsigned long long tail = async->tail, end;
+	unsigned long dropped;
+	unsigned int word;
+	size_t off, len, first;
+	int ok = 1, report;
+	pthread_mutex_lock(&async->io);
+	seek64_file(log->file, log->write_pos, SEEK_SET);
+	for(end = tail; end - tail < async->cap / 2;) {
+		off = (size_t)end & (async->cap - 1);
+		word = __atomic_load_n(_word_log(async, off), __ATOMIC_ACQUIRE);
+		if(word == 0)
+			break;
+		if(word == CLOG_PAD) {
+			end += async->cap - off;
+			continue;
+		}
+		len = word - 1;
+		if(write_file(log->file, async->ring + off + 8, 1, len) != len)
+			ok = 0;
+		end += (8 + len + 1 + 7) & ~(size_t)7;
+	}
+	dropped = __atomic_load_n(&async->dropped, __ATOMIC_SEQ_CST);
+	report = (async->overflow == CLOG_COUNT && dropped != async->noted);
+	if(end == tail && !report) {
+		pthread_mutex_unlock(&async->io);
+		return 0;
+	}
+	if(end != tail) {
+		/* free the space, waking producers waiting for it */
+		off = (size_t)tail & (async->cap - 1);
+		first = async->cap - off;
+		if(first > end - tail)
+			first = (size_t)(end - tail);
+		memset(async->ring + off, 0, first);
+		memset(async->ring, 0, (size_t)(end - tail) - first);
+		__atomic_store_n(&async->tail, end, __ATOMIC_SEQ_CST);
+		if(__atomic_load_n(&async->waiting, __ATOMIC_SEQ_CST)) {
+			pthread_mutex_lock(&async->lock);
+			pthread_cond_broadcast(&async->room);
+			pthread_mutex_unlock(&async->lock);
+		}
+	}
+	if(report) {
+		if(__atomic_load_n(&log->binary, __ATOMIC_ACQUIRE) != NULL) {
+			unsigned char note[9];
+			note[0] = 'D';
+			_le_log(note + 1, dropped - async->noted, 8);
+			if(write_file(log->file, note, 1, 9) != 9)
+				ok = 0;
+		} else if(writef_file(log->file, "clogger: %lu messages dropped\n",
+				dropped - async->noted) < 0) {
+			ok = 0;
+		}
+		async->noted = dropped;
+	}
+	if(flush_file(log->file) != 0)
+		ok = 0;
+	log->write_pos = tell64_file(log->file);
+	pthread_mutex_unlock(&async->io);
+	if(!ok)
+		__atomic_store_n(&log->status, CLOGERR_WRITE, __ATOMIC_RELAXED);
+	pthread_mutex_lock(&async->lock);
+	async->synced = end;
+	pthread_cond_broadcast(&async->done);
+	pthread_mutex_unlock(&async->lock);
+	return 1;
+}
+/* Flusher thread of an async log.
+ */
+static void *_flusher_log(void *arg)
+{
+	struct CLOG *log = (struct CLOG*)arg;
+	struct CLOG_ASYNC *async = log->async;
+	size_t off;
+	for(;;) {
+		if(_drain_log(log))
+			continue;
+		pthread_mutex_lock(&async->lock);
+		__atomic_store_n(&async->sleeping, 1, __ATOMIC_SEQ_CST);
+		off = (size_t)async->tail & (async->cap - 1);
+		while(__atomic_load_n(_word_log(async, off), __ATOMIC_SEQ_CST) == 0) {
+			if(__atomic_load_n(&async->head, __ATOMIC_SEQ_CST) !=
+					async->tail) {
+				/* reserved, still being formatted */
+				pthread_mutex_unlock(&async->lock);
+				sched_yield();
+				pthread_mutex_lock(&async->lock);
+				continue;
+			}
+			if(async->stop)
+				break;
+			pthread_cond_wait(&async->wake, &async->lock);
+		}
+		__atomic_store_n(&async->sleeping, 0, __ATOMIC_SEQ_CST);
+		if(async->stop && async->head == async->tail) {
+			pthread_mutex_unlock(&async->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&async->lock);
+	}
+}
+/* Write out everything left and end async mode.
+ */
+static void _stop_async_log(struct CLOG *log)
+{
+	struct CLOG_ASYNC *async = log->async;
+	pthread_mutex_lock(&async->lock);
+	async->stop = 1;
+	pthread_cond_signal(&async->wake);
+	pthread_mutex_unlock(&async->lock);
+	pthread_join(async->thread, NULL);
+	/* drops after the flusher's last batch */
+	_drain_log(log);
+	pthread_mutex_destroy(&async->lock);
+	pthread_mutex_destroy(&async->io);
+	pthread_cond_destroy(&async->wake);
+	pthread_cond_destroy(&async->room);
+	pthread_cond_destroy(&async->done);
+	free(async->ring);
+	free(async);
+	log->async = NULL;
+}
+/* Size a record of len bytes takes in the ring.
+ */
+static size_t _size_log(size_t len)
+{
+	return (8 + len + 1 + 7) & ~(size_t)7;
+}
+/* Reserve a record for len bytes, waiting for room if overflow is
+ * CLOG_BLOCK; returns its offset, or (size_t)-1 if it was dropped.
+ */
+static size_t _claim_log(struct CLOG_ASYNC *async, size_t len, int overflow)
+{
+	size_t off, size = _size_log(len);
+	if((off = _reserve_log(async, size)) != (size_t)-1)
+		return off;
+	if(overflow != CLOG_BLOCK) {
+		__atomic_add_fetch(&async->dropped, 1, __ATOMIC_RELAXED);
+		return (size_t)-1;
+	}
+	pthread_mutex_lock(&async->lock);
+	__atomic_add_fetch(&async->waiting, 1, __ATOMIC_SEQ_CST);
+	while((off = _reserve_log(async, size)) == (size_t)-1)
+		pthread_cond_wait(&async->room, &async->lock);
+	__atomic_sub_fetch(&async->waiting, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&async->lock);
+	return off;
+}
+/* Make the record at off, holding len bytes, ready for the flusher.
+ */
+static void _commit_log(struct CLOG_ASYNC *async, size_t off, size_t len)
+{
+	__atomic_store_n(_word_log(async, off), (unsigned int)len + 1,
+		__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&async->sleeping, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&async->lock);
+		pthread_cond_signal(&async->wake);
+		pthread_mutex_unlock(&async->lock);
+	}
+}
+/* Put one formatted message into the ring of an async log; text holds
+ * it if it was short enough, else it is formatted again from ap.
+ */
+static void _async_text_log(struct CLOG *log, const char *data,
+	va_list ap, const char *text, int len)
+{
+	struct CLOG_ASYNC *async = log->async;
+	size_t off, max = async->cap / 4 - 9;
+	if((size_t)len > max)
+		len = (int)max;
+	if((off = _claim_log(async, (size_t)len, async->overflow)) ==
+			(size_t)-1)
+		return;
+	if(text != NULL)
+		memcpy(async->ring + off + 8, text, (size_t)len);
+	else
+		vsnprintf((char*)async->ring + off + 8, (size_t)len + 1, data, ap);
+	_commit_log(async, off, (size_t)len);
+}
+/* Nanoseconds since 1970.
+ */
+static unsigned long long _now_log(void)
+{
+#ifdef _WIN32
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	return ((((unsigned long long)ft.dwHighDateTime << 32) |
+		ft.dwLowDateTime) - 116444736000000000ULL) * 100;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL +
+		(unsigned long long)ts.tv_nsec;
+#endif
+}
+/* Parse the conversion starting at the '%' at p; returns what follows.
+ */
+static const char *_spec_log(const char *p, struct CLOG_SPEC *spec)
+{
+	spec->start = p++;
+	while(*p != '\0' && strchr("-+ #0'", *p) != NULL)
+		p++;
+	spec->width = p;
+	if((spec->star_width = (*p == '*')))
+		p++;
+	else
+		while(*p >= '0' && *p <= '9')
+			p++;
+	spec->dot = p;
+	spec->star_prec = 0;
+	spec->prec = -1;
+	if(*p == '.') {
+		if((spec->star_prec = (*++p == '*')))
+			p++;
+		else
+			for(spec->prec = 0; *p >= '0' && *p <= '9'; p++)
+				spec->prec = spec->prec * 10 + (*p - '0');
+	}
+	spec->length = p;
+	spec->size = CLOG_LEN_NONE;
+	if(*p == 'h') {
+		spec->size = (*++p == 'h') ? CLOG_LEN_HH : CLOG_LEN_H;
+		if(spec->size == CLOG_LEN_HH)
+			p++;
+	} else if(*p == 'l') {
+		spec->size = (*++p == 'l') ? CLOG_LEN_LL : CLOG_LEN_L;
+		if(spec->size == CLOG_LEN_LL)
+			p++;
+	} else if(*p == 'z') {
+		spec->size = CLOG_LEN_Z;
+		p++;
+	} else if(*p != '\0' && strchr("Ljtq", *p) != NULL) {
+		spec->size = CLOG_LEN_OTHER;
+		p++;
+	}
+	spec->conv = (unsigned char)*p;
+	if(*p != '\0')
+		p++;
+	spec->end = p;
+	return p;
+}
+/* Whether every argument fmt converts can be stored as raw bytes.
+ */
+static int _plain_log(const char *fmt)
+{
+	struct CLOG_SPEC spec;
+	const char *p = fmt;
+	while((p = strchr(p, '%')) != NULL) {
+		p = _spec_log(p, &spec);
+		if(spec.conv == '\0' || spec.size == CLOG_LEN_OTHER ||
+				strchr("diouxXcspeEfFgGaA%", spec.conv) == NULL)
+			return 0;
+		if(spec.conv == '%' && spec.end - spec.start != 2)
+			return 0;
+		/* wide characters and strings */
+		if((spec.conv == 'c' || spec.conv == 's' || spec.conv == 'p') &&
+				spec.size != CLOG_LEN_NONE)
+			return 0;
+		if(strchr("eEfFgGaA", spec.conv) != NULL &&
+				spec.size != CLOG_LEN_NONE && spec.size != CLOG_LEN_L)
+			return 0;
+	}
+	return 1;
+}
+/* Add n bytes to a record.
+ */
+static void _put_log(struct CLOG_REC *rec, const void *p, size_t n)
+{
+	unsigned char *data;
+	size_t cap;
+	if(rec->failed)
+		return;
+	if(rec->len + n > rec->cap) {
+		for(cap = rec->cap * 2; cap < rec->len + n; cap *= 2)
+			;
+		if((data = (unsigned char*)malloc(cap)) == NULL) {
+			rec->failed = 1;
+			return;
+		}
+		memcpy(data, rec->data, rec->len);
+		if(rec->data != rec->stack)
+			free(rec->data);
+		rec->data = data;
+		rec->cap = cap;
+	}
+	memcpy(rec->data + rec->len, p, n);
+	rec->len += n;
+}
+/* Add v to a record as an n byte little endian number.
+ */
+static void _put_num_log(struct CLOG_REC *rec, unsigned long long v, int n)
+{
+	unsigned char buf[8];
+	_le_log(buf, v, n);
+	_put_log(rec, buf, (size_t)n);
+}
+/* Start an empty record with tag.
+ */
+static void _start_log(struct CLOG_REC *rec, int tag)
+{
+	unsigned char c = (unsigned char)tag;
+	rec->data = rec->stack;
+	rec->len = 0;
+	rec->cap = sizeof(rec->stack);
+	rec->failed = 0;
+	_put_log(rec, &c, 1);
+}
+/* Store the arguments fmt converts the way the decoder reads them back.
+ */
+static void _args_log(struct CLOG_REC *rec, const char *fmt, va_list ap)
+{
+	struct CLOG_SPEC spec;
+	const char *p = fmt, *str;
+	unsigned long long v;
+	double d;
+	long prec;
+	size_t n;
+	while((p = strchr(p, '%')) != NULL) {
+		p = _spec_log(p, &spec);
+		if(spec.conv == '%')
+			continue;
+		if(spec.star_width)
+			_put_num_log(rec, (unsigned long long)va_arg(ap, int), 8);
+		prec = spec.prec;
+		if(spec.star_prec) {
+			prec = va_arg(ap, int);
+			_put_num_log(rec, (unsigned long long)prec, 8);
+		}
+		switch(spec.conv) {
+		case 'd': case 'i':
+			if(spec.size == CLOG_LEN_L)
+				v = (unsigned long long)va_arg(ap, long);
+			else if(spec.size == CLOG_LEN_LL)
+				v = (unsigned long long)va_arg(ap, long long);
+			else if(spec.size == CLOG_LEN_Z)
+				v = (unsigned long long)va_arg(ap, size_t);
+			else
+				v = (unsigned long long)va_arg(ap, int);
+			break;
+		case 'o': case 'u': case 'x': case 'X':
+			if(spec.size == CLOG_LEN_L)
+				v = va_arg(ap, unsigned long);
+			else if(spec.size == CLOG_LEN_LL)
+				v = va_arg(ap, unsigned long long);
+			else if(spec.size == CLOG_LEN_Z)
+				v = va_arg(ap, size_t);
+			else
+				v = va_arg(ap, unsigned int);
+			break;
+		case 'c':
+			v = (unsigned long long)va_arg(ap, int);
+			break;
+		case 'p':
+			v = (unsigned long long)(size_t)va_arg(ap, void*);
+			break;
+		case 's':
+			/* strings are copied, only as far as printf would read */
+			if((str = va_arg(ap, const char*)) == NULL)
+				str = "(null)";
+			if(prec < 0)
+				n = strlen(str);
+			else
+				for(n = 0; n < (size_t)prec && str[n] != '\0'; n++)
+					;
+			_put_num_log(rec, n, 4);
+			_put_log(rec, str, n);
+			continue;
+		default:
+			d = va_arg(ap, double);
+			memcpy(&v, &d, sizeof(v));
+			break;
+		}
+		_put_num_log(rec, v, 8);
+	}
+}
+/* Write one binary record, through the ring of an async log.
+ */
+static void _emit_log(struct CLOG *log, const unsigned char *rec,
+	size_t len, int overflow)
+{
+	struct CLOG_ASYNC *async = log->async;
+	size_t off;
+	if(async != NULL) {
+		if((off = _claim_log(async, len, overflow)) == (size_t)-1)
+			return;
+		memcpy(async->ring + off + 8, rec, len);
+		_commit_log(async, off, len);
+		return;
+	}
+	seek64_file(log->file, log->write_pos, SEEK_SET);
+	if(write_file(log->file, rec, 1, len) != len)
+		log->status = CLOGERR_WRITE;
+	log->write_pos = tell64_file(log->file);
+	flush_file(log->file);
+}
+/* Largest record a log takes in one piece.
+ */
+static size_t _max_log(struct CLOG *log)
+{
+	return (log->async != NULL) ? log->async->cap / 4 - 9 : (size_t)-1;
+}
+/* Id of format fmt, giving it one and writing it to the log the first
+ * time; zero if its messages have to be formatted at once.
+ */
+static unsigned int _id_log(struct CLOG *log, const char *fmt)
+{
+	struct CLOG_BINARY *binary = log->binary;
+	struct CLOG_REC rec;
+	unsigned long long hash = (unsigned long long)(size_t)fmt *
+		0x9E3779B97F4A7C15ULL;
+	size_t slot, i, len;
+	const char *key;
+	unsigned int id;
+	int locked = 0;
+	for(;;) {
+		slot = (size_t)(hash >> 52);
+		for(i = 0; i < CLOG_FORMATS; i++) {
+			key = __atomic_load_n(&binary->keys[slot], __ATOMIC_ACQUIRE);
+			if(key == fmt) {
+				id = binary->ids[slot];
+				if(locked)
+					pthread_mutex_unlock(&binary->lock);
+				return id;
+			}
+			if(key == NULL)
+				break;
+			slot = (slot + 1) & (CLOG_FORMATS - 1);
+		}
+		if(locked)
+			break;
+		/* look again, alone, before adding it */
+		pthread_mutex_lock(&binary->lock);
+		locked = 1;
+	}
+	if(binary->used >= CLOG_FORMATS / 4 * 3) {
+		pthread_mutex_unlock(&binary->lock);
+		return 0;
+	}
+	id = 0;
+	len = strlen(fmt);
+	if(_plain_log(fmt) && 9 + len <= _max_log(log)) {
+		id = ++binary->count;
+		_start_log(&rec, 'F');
+		_put_num_log(&rec, id, 4);
+		_put_num_log(&rec, len, 4);
+		_put_log(&rec, fmt, len);
+		if(rec.failed)
+			id = 0;
+		else
+			_emit_log(log, rec.data, rec.len, CLOG_BLOCK);
+		if(rec.data != rec.stack)
+			free(rec.data);
+	}
+	binary->ids[slot] = id;
+	__atomic_store_n(&binary->keys[slot], fmt, __ATOMIC_RELEASE);
+	binary->used++;
+	pthread_mutex_unlock(&binary->lock);
+	return id;
+}
+/* Store a message as the id of its format, the time and the raw
+ * arguments; returns -1 if it has to be formatted instead.
+ */
+static int _binary_write_log(struct CLOG *log, const char *data, va_list ap)
+{
+	struct CLOG_REC rec;
+	unsigned int id;
+	int res = -1;
+	if((id = _id_log(log, data)) == 0)
+		return -1;
+	_start_log(&rec, 'M');
+	_put_num_log(&rec, id, 4);
+	_put_num_log(&rec, _now_log(), 8);
+	_put_num_log(&rec, 0, 4);
+	_args_log(&rec, data, ap);
+	if(!rec.failed && rec.len <= _max_log(log)) {
+		_le_log(rec.data + 13, rec.len - 17, 4);
+		_emit_log(log, rec.data, rec.len, (log->async != NULL) ?
+			log->async->overflow : CLOG_BLOCK);
+		res = 0;
+	}
+	if(rec.data != rec.stack)
+		free(rec.data);
+	return res;
+}
+/* Store a message already formatted, for ones with no raw form.
+ */
+static void _binary_text_log(struct CLOG *log, const char *text, size_t len)
+{
+	struct CLOG_REC rec;
+	if(len > _max_log(log) - 13)
+		len = _max_log(log) - 13;
+	_start_log(&rec, 'T');
+	_put_num_log(&rec, _now_log(), 8);
+	_put_num_log(&rec, len, 4);
+	_put_log(&rec, text, len);
+	if(!rec.failed)
+		_emit_log(log, rec.data, rec.len, (log->async != NULL) ?
+			log->async->overflow : CLOG_BLOCK);
+	if(rec.data != rec.stack)
+		free(rec.data);
+}
+/* Read exactly n bytes of a binary log into *buf, growing it; returns
+ * zero if the log ends first.
+ */
+static int _take_log(file_t *in, unsigned char **buf, size_t *cap, size_t n)
+{
+	unsigned char *p;
+	if(n + 1 > *cap) {
+		if((p = (unsigned char*)realloc(*buf, n + 1)) == NULL)
+			return 0;
+		*buf = p;
+		*cap = n + 1;
+	}
+	return read_file(in, *buf, 1, n) == n;
+}
+/* Write the time ns (since 1970) as UTC.
+ */
+static void _stamp_log(file_t *out, unsigned long long ns)
+{
+	time_t secs = (time_t)(ns / 1000000000ULL);
+	struct tm *tm = gmtime(&secs);
+	char buf[32];
+	if(tm == NULL || strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S",
+			tm) == 0)
+		strcpy(buf, "?");
+	writef_file(out, "%s.%09lu ", buf,
+		(unsigned long)(ns % 1000000000ULL));
+}
+/* Write the message of format fmt with the raw arguments args to out;
+ * returns -1 if they do not fit the format.
+ */
+static int _format_log(file_t *out, const char *fmt,
+	const unsigned char *args, size_t len, char **str, size_t *cap)
+{
+	struct CLOG_SPEC spec;
+	const char *p = fmt, *q;
+	char conv[128], *s;
+	unsigned long long v = 0;
+	size_t at = 0, k, n;
+	double d;
+	while((q = strchr(p, '%')) != NULL) {
+		write_file(out, p, 1, (size_t)(q - p));
+		p = _spec_log(q, &spec);
+		if(spec.conv == '%') {
+			write_file(out, "%", 1, 1);
+			continue;
+		}
+		if(spec.end - spec.start > 64)
+			return -1;
+		/* the conversion again, numbers in place of stars */
+		k = (size_t)(spec.width - spec.start);
+		memcpy(conv, spec.start, k);
+		if(spec.star_width) {
+			if(at + 8 > len)
+				return -1;
+			k += sprintf(conv + k, "%ld",
+				(long)_get_le_log(args + at, 8));
+			at += 8;
+		} else {
+			memcpy(conv + k, spec.width, (size_t)(spec.dot - spec.width));
+			k += (size_t)(spec.dot - spec.width);
+		}
+		if(spec.star_prec) {
+			if(at + 8 > len)
+				return -1;
+			if((long)_get_le_log(args + at, 8) >= 0)
+				k += sprintf(conv + k, ".%ld",
+					(long)_get_le_log(args + at, 8));
+			at += 8;
+		} else {
+			memcpy(conv + k, spec.dot, (size_t)(spec.length - spec.dot));
+			k += (size_t)(spec.length - spec.dot);
+		}
+		memcpy(conv + k, spec.length, (size_t)(spec.end - spec.length));
+		conv[k + (size_t)(spec.end - spec.length)] = '\0';
+		n = (spec.conv == 's') ? 4 : 8;
+		if(at + n > len)
+			return -1;
+		v = _get_le_log(args + at, (int)n);
+		at += n;
+		switch(spec.conv) {
+		case 'd': case 'i':
+			if(spec.size == CLOG_LEN_L)
+				writef_file(out, conv, (long)v);
+			else if(spec.size == CLOG_LEN_LL)
+				writef_file(out, conv, (long long)v);
+			else if(spec.size == CLOG_LEN_Z)
+				writef_file(out, conv, (size_t)v);
+			else
+				writef_file(out, conv, (int)v);
+			break;
+		case 'o': case 'u': case 'x': case 'X':
+			if(spec.size == CLOG_LEN_L)
+				writef_file(out, conv, (unsigned long)v);
+			else if(spec.size == CLOG_LEN_LL)
+				writef_file(out, conv, v);
+			else if(spec.size == CLOG_LEN_Z)
+				writef_file(out, conv, (size_t)v);
+			else
+				writef_file(out, conv, (unsigned int)v);
+			break;
+		case 'c':
+			writef_file(out, conv, (int)v);
+			break;
+		case 'p':
+			writef_file(out, conv, (void*)(size_t)v);
+			break;
+		case 's':
+			if(at + v > len || (v + 1 > *cap &&
+					(s = (char*)realloc(*str, (size_t)v + 1)) == NULL))
+				return -1;
+			if(v + 1 > *cap) {
+				*str = s;
+				*cap = (size_t)v + 1;
+			}
+			memcpy(*str, args + at, (size_t)v);
+			(*str)[v] = '\0';
+			at += (size_t)v;
+			writef_file(out, conv, *str);
+			break;
+		case 'e': case 'E': case 'f': case 'F':
+		case 'g': case 'G': case 'a': case 'A':
+			memcpy(&d, &v, sizeof(d));
+			writef_file(out, conv, d);
+			break;
+		default:
+			return -1;
+		}
+	}
+	write_file(out, p, 1, strlen(p));
+	return (at == len) ? 0 : -1;
+}
 /* Exit function, clean up log files.
  */
 static void _logger_exit_func(void)
 {
 	int i;
 
-	for(i=0; i<MAX_LOGS; i++)
+	for(i=0; i<MAX_LOGS; i++) {
+		if(_logs[i].async != NULL)
+			_stop_async_log(&_logs[i]);
 		if (get_status_log(i))
 			close_log(i);
+	}
 }
 /* Initialize logger system.
  */
@@ -62,6 +849,8 @@ PRS_EXPORT void init_logger(void)
 			_logs[i].status = CLOGERR_CLOSE;
 			_logs[i].write_pos = 0;
 			_logs[i].read_pos = 0;
+			_logs[i].async = NULL;
+			_logs[i].binary = NULL;
 		}
 		atexit(_logger_exit_func);
 	} else {
@@ -86,33 +875,72 @@ PRS_EXPORT void open_log(int logNum, const char *name)
 	}
 	printf("Please use init_logger() first.\n");
 }
+/* Use an already open file as log file; closing the log closes it.
+ */
+PRS_EXPORT void attach_log(int logNum, file_t *file)
+{
+	if(init_var) {
+		if(get_status_log(logNum) == CLOGERR_CLOSE) {
+			_logs[logNum].file = file;
+			_logs[logNum].status = (file == NULL) ?
+				CLOGERR_OPEN : CLOGERR_OKAY;
+			return;
+		}
+		return;
+	}
+	printf("Please use init_logger() first.\n");
+}
+/* Reads the next line of a log into buf of size, without its newline;
+ * returns the byte the read stopped at: '\n' after a whole line, EOF at
+ * the end of the log, or the last byte stored when buf is full.
+ */
+static int _read_log(struct CLOG *log, char *buf, int size)
+{
+	const char *line;
+	size_t len;
+	int err, c;
+	seek64_file(log->file, log->read_pos, SEEK_SET);
+	if((err = get_error_file()) != FILE_ERROR_OKAY) {
+		printf("Error: %s\n", strerror_file(err));
+		return -1;
+	}
+	buf[0] = '\0';
+	line = next_line_file(log->file, &len);
+	if(line == NULL) {
+		if(get_error_file() != FILE_ERROR_OKAY)
+			log->status = CLOGERR_READ;
+		return EOF;
+	}
+	/* a line longer than buf is read over several calls */
+	if(len > (size_t)size-1) {
+		len = size-1;
+		c = (len > 0) ? (unsigned char)line[len-1] : 0;
+	} else {
+		c = (line[len-1] == '\n') ? '\n' : EOF;
+	}
+	log->read_pos += (file_off_t)len;
+	if(c == '\n')
+		len--;
+	memcpy(buf, line, len);
+	buf[len] = '\0';
+	return c;
+}
 /* Reads a log file into buf of size.
  */
 PRS_EXPORT int read_log(int logNum, char *buf, int size)
 {
 	if(init_var) {
 		if(get_status_log(logNum) == CLOGERR_OKAY) {
-			int c, pos, err;
-			seek_file(_logs[logNum].file,
-				_logs[logNum].read_pos, SEEK_SET);
-			if((err = get_error_file()) != FILE_ERROR_OKAY) {
-				printf("Error: %s\n", strerror_file(err));
-				return -1;
-			}
-			c = pos = 0;
-			memset(buf, 0, size);
-			while(pos < size &&
-				(c = getc_file(_logs[logNum].file)
-				!= EOF && c != '\n'))
-				buf[pos++] = c;
-			_logs[logNum].read_pos =
-				tell_file(_logs[logNum].file);
-			buf[pos] = '\0';
-			if(c != EOF && errno != 0) {
-				_logs[logNum].status = CLOGERR_READ;
-				errno = 0;
-			}
-			return c;
+			struct CLOG_ASYNC *async = _logs[logNum].async;
+			int res;
+			if(async == NULL)
+				return _read_log(&_logs[logNum], buf, size);
+			/* see what was written so far, keep the flusher off */
+			flush_log(logNum);
+			pthread_mutex_lock(&async->io);
+			res = _read_log(&_logs[logNum], buf, size);
+			pthread_mutex_unlock(&async->io);
+			return res;
 		}
 		printf("Warning: Could not read, log CLOG%d not open.\n",
 			logNum);
@@ -127,16 +955,55 @@ PRS_EXPORT void write_log(int logNum, const char *data, ...)
 {
 	if(init_var) {
 		if(get_status_log(logNum) == CLOGERR_OKAY) {
+			char line[CLOG_LINE];
 			va_list ap;
+			char *text;
 			int res;
-			seek_file(_logs[logNum].file,
+			if(_logs[logNum].binary != NULL) {
+				va_start(ap, data);
+				res = _binary_write_log(&_logs[logNum], data, ap);
+				va_end(ap);
+				if(res == 0)
+					return;
+				/* no raw form, store the text */
+				va_start(ap, data);
+				res = vsnprintf(line, sizeof(line), data, ap);
+				va_end(ap);
+				if(res < 0)
+					return;
+				text = line;
+				if(res >= (int)sizeof(line)) {
+					if((text = (char*)malloc((size_t)res + 1)) == NULL)
+						return;
+					va_start(ap, data);
+					vsnprintf(text, (size_t)res + 1, data, ap);
+					va_end(ap);
+				}
+				_binary_text_log(&_logs[logNum], text, (size_t)res);
+				if(text != line)
+					free(text);
+				return;
+			}
+			if(_logs[logNum].async != NULL) {
+				va_start(ap, data);
+				res = vsnprintf(line, sizeof(line), data, ap);
+				va_end(ap);
+				if(res < 0)
+					return;
+				va_start(ap, data);
+				_async_text_log(&_logs[logNum], data, ap,
+					(res < (int)sizeof(line)) ? line : NULL, res);
+				va_end(ap);
+				return;
+			}
+			seek64_file(_logs[logNum].file,
 				_logs[logNum].write_pos,
 				SEEK_SET);
 			va_start(ap, data);
 			res = vwritef_file(_logs[logNum].file, data, ap);
 			va_end(ap);
 			_logs[logNum].write_pos =
-				tell_file(_logs[logNum].file);
+				tell64_file(_logs[logNum].file);
 			flush_file(_logs[logNum].file);
 			if(res < 0 && errno != 0) {
 				_logs[logNum].status = CLOGERR_WRITE;
@@ -149,11 +1016,225 @@ PRS_EXPORT void write_log(int logNum, const char *data, ...)
 	}
 	printf("Please use init_logger() first.\n");
 }
+/* Make writes to a log go through a ring and a flusher thread.
+ */
+PRS_EXPORT int set_async_log(int logNum, size_t size, int overflow)
+{
+	struct CLOG_ASYNC *async;
+	size_t cap = 4096;
+	if(!init_var) {
+		printf("Please use init_logger() first.\n");
+		return -1;
+	}
+	if(get_status_log(logNum) != CLOGERR_OKAY ||
+			_logs[logNum].async != NULL)
+		return -1;
+	if(size == 0)
+		size = CLOG_RING;
+	while(cap < size)
+		cap <<= 1;
+	if((async = (struct CLOG_ASYNC*)calloc(1, sizeof(*async))) == NULL)
+		return -1;
+	if((async->ring = (unsigned char*)calloc(cap, 1)) == NULL) {
+		free(async);
+		return -1;
+	}
+	async->cap = cap;
+	async->overflow = overflow;
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_mutex_init(&async->io, NULL);
+	pthread_cond_init(&async->wake, NULL);
+	pthread_cond_init(&async->room, NULL);
+	pthread_cond_init(&async->done, NULL);
+	flush_file(_logs[logNum].file);
+	_logs[logNum].async = async;
+	if(pthread_create(&async->thread, NULL, _flusher_log,
+			&_logs[logNum]) != 0) {
+		pthread_mutex_destroy(&async->lock);
+		pthread_mutex_destroy(&async->io);
+		pthread_cond_destroy(&async->wake);
+		pthread_cond_destroy(&async->room);
+		pthread_cond_destroy(&async->done);
+		free(async->ring);
+		free(async);
+		_logs[logNum].async = NULL;
+		return -1;
+	}
+	return 0;
+}
+/* Wait until the messages written so far are flushed to the file.
+ */
+PRS_EXPORT void flush_log(int logNum)
+{
+	if(init_var) {
+		struct CLOG_ASYNC *async = _logs[logNum].async;
+		unsigned long long head;
+		if(async == NULL) {
+			if(get_status_log(logNum) == CLOGERR_OKAY)
+				flush_file(_logs[logNum].file);
+			return;
+		}
+		head = __atomic_load_n(&async->head, __ATOMIC_SEQ_CST);
+		pthread_mutex_lock(&async->lock);
+		while(async->synced < head) {
+			pthread_cond_signal(&async->wake);
+			pthread_cond_wait(&async->done, &async->lock);
+		}
+		pthread_mutex_unlock(&async->lock);
+		return;
+	}
+	printf("Please use init_logger() first.\n");
+}
+/* Gets the number of messages an async log dropped when full.
+ */
+PRS_EXPORT unsigned long get_dropped_log(int logNum)
+{
+	if(init_var) {
+		if(_logs[logNum].async == NULL)
+			return 0;
+		return __atomic_load_n(&_logs[logNum].async->dropped,
+			__ATOMIC_RELAXED);
+	}
+	printf("Please use init_logger() first.\n");
+	return 0;
+}
+/* Make write_log() store binary records for decode_log().
+ */
+PRS_EXPORT int set_binary_log(int logNum)
+{
+	struct CLOG_BINARY *binary;
+	if(!init_var) {
+		printf("Please use init_logger() first.\n");
+		return -1;
+	}
+	if(get_status_log(logNum) != CLOGERR_OKAY ||
+			_logs[logNum].binary != NULL)
+		return -1;
+	if((binary = (struct CLOG_BINARY*)calloc(1, sizeof(*binary))) == NULL)
+		return -1;
+	pthread_mutex_init(&binary->lock, NULL);
+	/* every session starts over with its own formats */
+	_emit_log(&_logs[logNum], (const unsigned char*)CLOG_MAGIC,
+		sizeof(CLOG_MAGIC) - 1, CLOG_BLOCK);
+	__atomic_store_n(&_logs[logNum].binary, binary, __ATOMIC_RELEASE);
+	return 0;
+}
+/* Turn a binary log into text, a record at a time.
+ */
+PRS_EXPORT long decode_log(file_t *in, file_t *out, int stamp)
+{
+	unsigned char *buf = NULL, head[17];
+	char **formats = NULL, **grown, *str = NULL;
+	size_t cap = 0, nstr = 0, len;
+	unsigned long count = 0, room = 0, i, id;
+	long messages = 0, res = -1;
+	int session = 0;
+	for(;;) {
+		if(read_file(in, head, 1, 1) != 1) {
+			res = messages;
+			break;
+		}
+		if(head[0] == 'P') {
+			/* session header, the formats start over */
+			if(read_file(in, head + 1, 1, 7) != 7) {
+				res = messages;
+				break;
+			}
+			if(memcmp(head, CLOG_MAGIC, 8) != 0)
+				break;
+			for(i = 0; i < count; i++)
+				free(formats[i]);
+			count = 0;
+			session = 1;
+			continue;
+		}
+		if(!session)
+			break;
+		if(head[0] == 'F') {
+			if(read_file(in, head + 1, 1, 8) != 8 ||
+					!_take_log(in, &buf, &cap,
+						(size_t)_get_le_log(head + 5, 4))) {
+				res = messages;
+				break;
+			}
+			if(_get_le_log(head + 1, 4) != count + 1)
+				break;
+			if(count == room) {
+				room = room ? room * 2 : 64;
+				if((grown = (char**)realloc(formats,
+						room * sizeof(char*))) == NULL)
+					break;
+				formats = grown;
+			}
+			len = (size_t)_get_le_log(head + 5, 4);
+			if((formats[count] = (char*)malloc(len + 1)) == NULL)
+				break;
+			memcpy(formats[count], buf, len);
+			formats[count][len] = '\0';
+			/* only what write_log() stores raw, never %n */
+			if(strlen(formats[count]) != len ||
+					!_plain_log(formats[count])) {
+				free(formats[count]);
+				break;
+			}
+			count++;
+		} else if(head[0] == 'M') {
+			if(read_file(in, head + 1, 1, 16) != 16 ||
+					!_take_log(in, &buf, &cap,
+						(size_t)_get_le_log(head + 13, 4))) {
+				res = messages;
+				break;
+			}
+			id = (unsigned long)_get_le_log(head + 1, 4);
+			if(id == 0 || id > count)
+				break;
+			if(stamp)
+				_stamp_log(out, _get_le_log(head + 5, 8));
+			if(_format_log(out, formats[id-1], buf,
+					(size_t)_get_le_log(head + 13, 4), &str, &nstr) != 0)
+				break;
+			messages++;
+		} else if(head[0] == 'T') {
+			if(read_file(in, head + 1, 1, 12) != 12 ||
+					!_take_log(in, &buf, &cap,
+						(size_t)_get_le_log(head + 9, 4))) {
+				res = messages;
+				break;
+			}
+			if(stamp)
+				_stamp_log(out, _get_le_log(head + 1, 8));
+			write_file(out, buf, 1, (size_t)_get_le_log(head + 9, 4));
+			messages++;
+		} else if(head[0] == 'D') {
+			if(read_file(in, head + 1, 1, 8) != 8) {
+				res = messages;
+				break;
+			}
+			writef_file(out, "clogger: %lu messages dropped\n",
+				(unsigned long)_get_le_log(head + 1, 8));
+		} else {
+			break;
+		}
+	}
+	for(i = 0; i < count; i++)
+		free(formats[i]);
+	free(formats);
+	free(buf);
+	free(str);
+	return res;
+}
 /* Close a log file.
  */
 PRS_EXPORT void close_log(int logNum)
 {
 	if(init_var) {
+		if(_logs[logNum].async != NULL)
+			_stop_async_log(&_logs[logNum]);
+		if(_logs[logNum].binary != NULL) {
+			pthread_mutex_destroy(&_logs[logNum].binary->lock);
+			free(_logs[logNum].binary);
+			_logs[logNum].binary = NULL;
+		}
 		if(get_status_log(logNum) == CLOGERR_OKAY) {
 			close_file(_logs[logNum].file);
 			_logs[logNum].status = CLOGERR_CLOSE;
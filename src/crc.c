@@ -0,0 +1,140 @@
+/**
+ * @file crc.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief CRC32C (Castagnoli) checksums.
+ **************************************************************************
+ * @details The tables of the fallback are made on first use. Combining
+ * multiplies the first checksum by x^(8*len) modulo the polynomial,
+ * the same way zlib's crc32_combine() does.
+ **************************************************************************
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define CRC_SSE42 1             /* checked at run time */
+#endif
+
+#include "crc.h"
+
+#define CRC_POLY 0x82F63B78U    /* Castagnoli polynomial, reflected */
+
+static unsigned int _table_crc[8][256];
+static unsigned int _x2n_crc[32];
+static pthread_once_t _once_crc = PTHREAD_ONCE_INIT;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Make the slicing-by-8 tables and the powers of x for combining.
+ */
+static void _init_crc(void)
+{
+	unsigned int c, i, k;
+	for(i = 0; i < 256; i++) {
+		for(c = i, k = 0; k < 8; k++)
+			c = (c & 1) ? (c >> 1) ^ CRC_POLY : c >> 1;
+		_table_crc[0][i] = c;
+	}
+	for(i = 0; i < 256; i++)
+		for(k = 1; k < 8; k++)
+			_table_crc[k][i] = (_table_crc[k-1][i] >> 8) ^
+				_table_crc[0][_table_crc[k-1][i] & 0xFF];
+}
+#ifdef CRC_SSE42
+/* Checksum with the crc32 instruction, eight bytes at a time.
+ */
+__attribute__((target("sse4.2")))
+static unsigned int _sse42_crc(unsigned int crc, const unsigned char *p,
+	size_t len)
+{
+	unsigned long long c = crc, v;
+	for(; len >= 8; p += 8, len -= 8) {
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+	crc = (unsigned int)c;
+	while(len-- > 0)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif
+/* Checksum eight bytes per step through the tables.
+ */
+static unsigned int _slice8_crc(unsigned int crc, const unsigned char *p,
+	size_t len)
+{
+	unsigned int lo, hi;
+	for(; len >= 8; p += 8, len -= 8) {
+		lo = crc ^ ((unsigned int)p[0] | (unsigned int)p[1] << 8 |
+			(unsigned int)p[2] << 16 | (unsigned int)p[3] << 24);
+		hi = (unsigned int)p[4] | (unsigned int)p[5] << 8 |
+			(unsigned int)p[6] << 16 | (unsigned int)p[7] << 24;
+		crc = _table_crc[7][lo & 0xFF] ^ _table_crc[6][(lo >> 8) & 0xFF] ^
+			_table_crc[5][(lo >> 16) & 0xFF] ^ _table_crc[4][lo >> 24] ^
+			_table_crc[3][hi & 0xFF] ^ _table_crc[2][(hi >> 8) & 0xFF] ^
+			_table_crc[1][(hi >> 16) & 0xFF] ^ _table_crc[0][hi >> 24];
+	}
+	while(len-- > 0)
+		crc = (crc >> 8) ^ _table_crc[0][(crc ^ *p++) & 0xFF];
+	return crc;
+}
+/* Add len bytes to a checksum.
+ */
+PRS_EXPORT unsigned int update_crc(unsigned int crc, const void *buf,
+	size_t len)
+{
+	crc = ~crc;
+#ifdef CRC_SSE42
+	if(__builtin_cpu_supports("sse4.2"))
+		return ~_sse42_crc(crc, (const unsigned char*)buf, len);
+#endif
+	pthread_once(&_once_crc, _init_crc);
+	return ~_slice8_crc(crc, (const unsigned char*)buf, len);
+}
+/* Multiply two polynomials modulo the CRC polynomial.
+ */
+static unsigned int _mul_crc(unsigned int a, unsigned int b)
+{
+	unsigned int m = 1U << 31, p = 0;
+	for(;;) {
+		if(a & m) {
+			p ^= b;
+			if((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ CRC_POLY : b >> 1;
+	}
+	return p;
+}
+/* Make the table of x^(2^n) for combining.
+ */
+static void _init_x2n_crc(void)
+{
+	unsigned int p = 1U << 30;  /* x^1 */
+	int n;
+	_x2n_crc[0] = p;
+	for(n = 1; n < 32; n++)
+		_x2n_crc[n] = p = _mul_crc(p, p);
+}
+/* Checksum of two pieces one after the other.
+ */
+PRS_EXPORT unsigned int combine_crc(unsigned int crc_a, unsigned int crc_b,
+	size_t len_b)
+{
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+	unsigned int p = 1U << 31;  /* x^0 */
+	int k = 3;                  /* x^(8*len) is x^(len*2^3) */
+	pthread_once(&once, _init_x2n_crc);
+	for(; len_b != 0; len_b >>= 1, k++)
+		if(len_b & 1)
+			p = _mul_crc(_x2n_crc[k & 31], p);
+	return _mul_crc(p, crc_a) ^ crc_b;
+}
+#ifdef __cplusplus
+}
+#endif
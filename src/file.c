@@ -15,22 +15,208 @@
 #if defined(__linux) || defined(__UNIX__)
 #define _GNU_SOURCE 1
 #endif
+#define _FILE_OFFSET_BITS 64        /* 64-bit off_t on 32-bit systems */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <limits.h>
+
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <malloc.h>
+#endif
+
+#ifdef __linux
+#include <sys/sendfile.h>
+#endif
+
+#ifdef HAVE_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FILE_SIMD 1                 /* SSE2 is always there on x86_64 */
+#endif
 
 #include "file.h"
+#include "tpool.h"
+#include "lz.h"
+#include "crc.h"
+#include "utf8.h"
+
+#define FILE_FLAG_MAP   0x01        /* mode 'm', read through a mapping */
+#define FILE_FLAG_OWNED 0x02        /* mapping is a malloc() copy */
+#define FILE_FLAG_WRITE 0x04        /* stream can have pending writes */
+#define FILE_FLAG_APPEND 0x08       /* every write goes to the end */
+#define FILE_FLAG_STREAM 0x10       /* no descriptor behind the stream */
+#define FILE_FLAG_ANON  0x20        /* no path, cannot be reopened */
+#define FILE_FLAG_ZIP   0x40        /* mode 'z', compressed blocks */
+#define FILE_FLAG_DIRECT 0x80       /* mode 'd', around the page cache */
+#define FILE_FLAG_RESERVE 0x100     /* blocks reserved past the end */
+
+#define FILE_LINE_BUFSIZ 65536      /* starting size of the line buffer */
+#define FILE_AIO_DEPTH 256          /* requests in flight at once */
+#define FILE_IOV_BATCH 64           /* buffers handed to one readv/writev */
+#define FILE_COPY_BUFSIZ (1 << 20)  /* buffer of the user space copy loop */
+#define FILE_WRITE_BUFSIZ 65536     /* buffer of the typed writers */
+#define FILE_NUMBER_LEN 32          /* longest number a typed writer makes */
+#define FILE_ZIP_BLOCK 65536        /* input bytes of a compressed block */
+#define FILE_ZIP_HEADER 8           /* "PRSZ", version, three zero bytes */
+#define FILE_DIRECT_ALIGN 4096      /* alignment of direct buffers/offsets */
+#define FILE_DIRECT_BUFSIZ (1 << 20) /* buffer of a direct file */
+
+#ifdef O_DIRECT
+#define FILE_O_DIRECT O_DIRECT
+#else
+#define FILE_O_DIRECT 0             /* F_NOCACHE or plain I/O instead */
+#endif
+
+/* 64-bit stream positioning */
+#ifdef _WIN32
+#define FILE_SEEK(fp, off, whence) _fseeki64((fp), (off), (whence))
+#define FILE_TELL(fp) ((file_off_t)_ftelli64(fp))
+#else
+#define FILE_SEEK(fp, off, whence) fseeko((fp), (off_t)(off), (whence))
+#define FILE_TELL(fp) ((file_off_t)ftello(fp))
+#endif
 
 static int _errno_file;
 
+/* Asynchronous request, queued by submit_*_file() until reaped.
+ */
+struct file_aio {
+    struct file_aio *next;
+    file_t *file;
+    void *buf;
+    size_t len;
+    file_off_t offset;
+    file_off_t res;                 /* bytes done or -errno */
+    int write;
+    file_done_t done;
+    void *data;
+#ifndef _WIN32
+    struct iovec iov;
+#endif
+};
+
+/* State shared by every asynchronous request.
+ */
+static struct {
+    int init;
+    unsigned int inflight;          /* requests handed to ring or pool */
+    unsigned int unsubmitted;       /* in the ring, kernel not told yet */
+    struct file_aio *pending;       /* waiting for room in the ring */
+    struct file_aio *pending_tail;
+    struct file_aio *done;          /* finished, waiting to be reaped */
+    struct file_aio *done_tail;
+#ifdef HAVE_IO_URING
+    int ring;                       /* io_uring descriptor or -1 */
+    unsigned int ring_depth;
+    unsigned char *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size;
+    unsigned int *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    size_t sqes_size;
+#endif
+#ifndef _WIN32
+    tpool_t *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} _aio_file;
+
+/* The buffers shared with GETC_FILE() and PUTC_FILE() come first, rbuf
+ * is the read-ahead of next_line_file() too and wbuf the output of the
+ * typed writers; at most one of them holds data at any time, unless a
+ * stream that cannot seek back is kept reading from rbuf.
+ */
 struct file {
+    file_buf_t buf;
     FILE *fp;
     char name[MAX_PATH];
-    long size;
-    long lines;
+    int flags;
+    unsigned char *map;             /* mapped view of the file */
+    size_t map_len;                 /* length of the mapped view */
+    size_t map_pos;                 /* read position inside the view */
+    int map_win;                    /* buf.rbuf is lent from the view */
+    file_off_t *index;              /* start offset of every line */
+    size_t index_len;               /* number of line starts indexed */
+    size_t index_cap;               /* capacity of index */
+    file_off_t index_end;           /* bytes of the file scanned so far */
+    size_t rcap;                    /* capacity of buf.rbuf */
+    const file_io_t *io;            /* backend of a stream, or NULL */
+    void *io_ctx;                   /* user pointer of the backend */
+    int crc_on;                     /* checksum data moved through file */
+    unsigned int crc;               /* CRC32C of that data so far */
+    int utf8_on;                    /* check text read is UTF-8 */
+    unsigned char utf8_part[4];     /* character cut off by the last read */
+    size_t utf8_npart;              /* bytes in utf8_part */
+    size_t utf8_skip;               /* read-ahead pushed back, checked */
+    file_off_t utf8_seen;           /* bytes checked so far */
+    file_off_t utf8_bad;            /* offset of the first bad byte or -1 */
+    char *vbuf;                     /* stream buffer of set_buffer_file */
+    size_t vsize;                   /* size of that buffer, zero for none */
+    int vset;                       /* stream buffer was chosen by the user */
+    unsigned int aio;               /* async requests not finished yet */
+    int io_eof;                     /* backend had nothing more to read */
+};
+
+/* Growable in-memory file, the context of _mem_io_file.
+ */
+struct file_mem {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t pos;
+    int append;
+};
+
+/* Compressed file, the context of _zip_io_file. Blocks are found by
+ * walking their headers and kept in an index for seeking.
+ */
+struct file_zip {
+    FILE *fp;                       /* stream of compressed blocks */
+    int write;
+    unsigned char *raw;             /* current block, uncompressed */
+    size_t raw_len;                 /* bytes of raw in use */
+    size_t raw_pos;                 /* read position inside raw */
+    unsigned char *pack;            /* current block, compressed */
+    size_t pack_cap;
+    file_off_t block;               /* uncompressed offset of raw */
+    file_off_t *index;              /* pairs of raw and packed offsets */
+    size_t index_len;               /* blocks in the index */
+    size_t index_cap;
+    file_off_t next_raw;            /* where the next unseen block starts */
+    file_off_t next_packed;
+    int done;                       /* index holds every block */
+};
+
+/* Direct file, the context of _direct_io_file. Data moves through an
+ * aligned buffer that holds the file from base on; base is aligned
+ * except after a read straight into the caller's buffer.
+ */
+struct file_direct {
+    int fd;
+    int write;
+    unsigned char *buf;             /* FILE_DIRECT_BUFSIZ aligned bytes */
+    size_t len;                     /* bytes of buf holding file data */
+    size_t pos;                     /* read position inside buf */
+    file_off_t base;                /* file offset of buf */
 };
 
 static const char *_prs_file_errors[] = {
@@ -41,281 +227,3349 @@ static const char *_prs_file_errors[] = {
     "File was unable to be read.",
     "File was unable to be written to.",
     "File was unable to seek.",
-    "Cannot tell size of file."
+    "Cannot tell size of file.",
+    "Text read is not well formed UTF-8."
 };
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* ------------------------- standard functions ------------------------ */
+/* -------------------------- mapping functions ------------------------ */
 
-/* Open a file by (path, mode).
+/* Copy mode into fmode without the library only flags; returns flags.
  */
-PRS_EXPORT file_t *open_file(const char *filename, const char *mode)
+static int _parse_mode_file(const char *mode, char *fmode)
 {
-    file_t *file;
-    file = (file_t*)malloc(sizeof(file_t));
-    if(file == NULL)
-	return NULL;
-    file->fp = NULL;
-    memset(file->name, 0, MAX_PATH);
-    file->size = -1;
-    file->lines = -1;
-    _errno_file = FILE_ERROR_OKAY;
-    if((file->fp = fopen(filename, mode)) == NULL) {
-        _errno_file = FILE_ERROR_OPEN;
-        return file;
+    int flags = 0;
+    size_t i;
+    for(i = 0; *mode != '\0' && i < 15; mode++) {
+        if(*mode == 'm')
+            flags |= FILE_FLAG_MAP;
+        else if(*mode == 'z')
+            flags |= FILE_FLAG_ZIP;
+        else if(*mode == 'd')
+            flags |= FILE_FLAG_DIRECT;
+        else
+            fmode[i++] = *mode;
+        if(*mode == 'w' || *mode == 'a' || *mode == '+')
+            flags |= FILE_FLAG_WRITE;
+        if(*mode == 'a')
+            flags |= FILE_FLAG_APPEND;
+    }
+    fmode[i] = '\0';
+    /* a mapping is only a read view */
+    if(flags & FILE_FLAG_WRITE)
+        flags &= ~FILE_FLAG_MAP;
+    if(flags & (FILE_FLAG_MAP|FILE_FLAG_ZIP))
+        flags &= ~FILE_FLAG_DIRECT;
+    return flags;
+}
+/* Read up to len bytes from the stream; a file made of a backend is
+ * read straight through it, its stream has no buffer to keep in step.
+ */
+static size_t _get_raw_file(file_t *file, void *buf, size_t len)
+{
+    size_t got = 0;
+    long n;
+    if(file->io == NULL) {
+        if((got = fread(buf, 1, len, file->fp)) < len && ferror(file->fp))
+            _errno_file = FILE_ERROR_READ;
+        return got;
     }
-    strcpy(file->name, filename);
-    if(strchr(mode, 'w') == NULL) {
-        file->size = get_size_file(file);
-        if(file->size < 0) {
-            _errno_file = FILE_ERROR_SIZE;
+    file->io_eof = 0;
+    while(got < len) {
+        if(file->io->read == NULL ||
+                (n = file->io->read(file->io_ctx, (char*)buf + got,
+                    len - got)) < 0) {
+            _errno_file = FILE_ERROR_READ;
+            break;
         }
-        if(strchr(mode, 'b') == NULL) {
-            file->lines = get_lines_file(file);
-            if(file->lines < 0) {
-                _errno_file = FILE_ERROR_LINE;
-            }
-	}
-	return file;
-    } else {
-        file->size = 0;
-        file->lines = 0;
+        if(n == 0) {
+            file->io_eof = 1;
+            break;
+        }
+        got += (size_t)n;
     }
-    _errno_file = FILE_ERROR_OKAY;
-    fseek(file->fp, 0, SEEK_SET);
-    return file;
+    return got;
 }
-/* Reopen file with different mode.
+/* Write len bytes to the stream, or straight to the backend of a file
+ * made of one; sets the error on a short write.
  */
-PRS_EXPORT file_t *reopen_file(file_t *file, const char *mode)
+static size_t _put_raw_file(file_t *file, const void *buf, size_t len)
 {
-    if(file != NULL &&
-             (file->fp = freopen(file->name, mode, file->fp)) == NULL) {
-        _errno_file = FILE_ERROR_OPEN;
-	close_file(file);
-	return NULL;
+    size_t put = 0;
+    long n;
+    if(file->io == NULL) {
+        if((put = fwrite(buf, 1, len, file->fp)) < len)
+            _errno_file = FILE_ERROR_WRITE;
+        return put;
     }
-    file->size = -1;
-    file->lines = -1;
-    _errno_file = FILE_ERROR_OKAY;
-    if(strchr(mode, 'w') == NULL) {
-        file->size = get_size_file(file);
-        if(file->size < 0) {
-            _errno_file = FILE_ERROR_SIZE;
-        }
-        if(strchr(mode, 'b') == NULL) {
-            file->lines = get_lines_file(file);
-            if(file->lines < 0) {
-                _errno_file = FILE_ERROR_LINE;
-            }
+    while(put < len) {
+        if(file->io->write == NULL ||
+                (n = file->io->write(file->io_ctx, (const char*)buf + put,
+                    len - put)) <= 0) {
+            _errno_file = FILE_ERROR_WRITE;
+            break;
         }
-	return file;
-    } else {
-        file->size = 0;
-        file->lines = 0;
+        put += (size_t)n;
     }
-    _errno_file = FILE_ERROR_OKAY;
-    fseek(file->fp, 0, SEEK_SET);
-    return file;
+    return put;
 }
-/* Gets the error string associated with error code.
+/* Map the whole file for reading; falls back to a heap copy.
  */
-PRS_EXPORT const char *strerror_file(int err)
+static int _map_file(file_t *file)
 {
-    return _prs_file_errors[err];
+    file_off_t size;
+#ifndef _WIN32
+    struct stat st;
+    if(fstat(fileno(file->fp), &st) == 0 && S_ISREG(st.st_mode) &&
+            (file_off_t)(size_t)st.st_size == (file_off_t)st.st_size) {
+        file->map_len = (size_t)st.st_size;
+        file->map_pos = 0;
+        if(file->map_len == 0)
+            return 0;
+        file->map = mmap(NULL, file->map_len, PROT_READ, MAP_PRIVATE,
+            fileno(file->fp), 0);
+        if(file->map != MAP_FAILED)
+            return 0;
+        file->map = NULL;
+    }
+#endif
+    if(FILE_SEEK(file->fp, 0, SEEK_END) != 0 ||
+            (size = FILE_TELL(file->fp)) < 0 ||
+            (file_off_t)(size_t)size != size)
+        return -1;
+    rewind(file->fp);
+    file->map_len = (size_t)size;
+    file->map_pos = 0;
+    if(file->map_len == 0)
+        return 0;
+    if((file->map = (unsigned char*)malloc(file->map_len)) == NULL)
+        return -1;
+    if(_get_raw_file(file, file->map, file->map_len) != file->map_len) {
+        free(file->map);
+        file->map = NULL;
+        return -1;
+    }
+    rewind(file->fp);
+    file->flags |= FILE_FLAG_OWNED;
+    return 0;
 }
-/* Gets the error code from file.
+/* Take the part of the view lent to GETC_FILE() back into map_pos; the
+ * bytes not read yet were checked as text already.
  */
-PRS_EXPORT int get_error_file(void)
+static void _fold_map_file(file_t *file)
 {
-    int error = _errno_file;
-    _errno_file = FILE_ERROR_OKAY;
-    return error;
+    if(!file->map_win)
+        return;
+    file->map_pos += file->buf.rpos;
+    if(file->utf8_on)
+        file->utf8_skip += file->buf.rlen - file->buf.rpos;
+    file->buf.rbuf = NULL;
+    file->buf.rpos = 0;
+    file->buf.rlen = 0;
+    file->map_win = 0;
 }
-/* Uninitialize the file structure; closing file.
+/* Release the mapped view of a file.
  */
-PRS_EXPORT void close_file(file_t *file)
+static void _unmap_file(file_t *file)
 {
-    if(file->fp != NULL) fclose(file->fp);
-    memset(file->name, 0, MAX_PATH);
-    file->size = -1;
-    file->lines = -1;
-    _errno_file = FILE_ERROR_OKAY;
-    free(file);
+    _fold_map_file(file);
+    if(file->map != NULL) {
+        if(file->flags & FILE_FLAG_OWNED)
+            free(file->map);
+#ifndef _WIN32
+        else
+            munmap(file->map, file->map_len);
+#endif
+    }
+    file->map = NULL;
+    file->map_len = 0;
+    file->map_pos = 0;
+    file->flags &= ~(FILE_FLAG_MAP|FILE_FLAG_OWNED);
 }
-
-/* ------------------------- handling functions ------------------------ */
-
-/* Read file into buf; of size
+/* Add data moved through the file to its checksum.
  */
-PRS_EXPORT int read_file(file_t *file, void *buf, size_t nmem, size_t size)
+static void _crc_file(file_t *file, const void *buf, size_t len)
 {
-    int bytes;
-    if((bytes = fread(buf, nmem, size, file->fp)) < 0)
-        _errno_file = FILE_ERROR_READ;
-    return bytes;
+    if(file->crc_on)
+        file->crc = update_crc(file->crc, buf, len);
 }
-/* Write into file from buf; of size
+/* Check text read from the file is UTF-8; a character cut off at the end
+ * of buf is kept until the next read finishes it.
  */
-PRS_EXPORT int write_file(file_t *file, const void *buf, size_t nmem,
-	size_t size)
+static void _utf8_file(file_t *file, const void *buf, size_t len)
 {
-    int bytes;
-    if((bytes = fwrite(buf, nmem, size, file->fp)) < 0)
-        _errno_file = FILE_ERROR_WRITE;
-    return bytes;
+    const unsigned char *p = (const unsigned char*)buf;
+    size_t i = 0, k, n;
+    if(!file->utf8_on || file->utf8_bad >= 0)
+        return;
+    if(file->utf8_skip > 0) {
+        /* read again after being pushed back */
+        k = (file->utf8_skip < len) ? file->utf8_skip : len;
+        file->utf8_skip -= k;
+        p += k;
+        len -= k;
+    }
+    if(len == 0)
+        return;
+    if((n = file->utf8_npart) > 0) {
+        do
+            file->utf8_part[n++] = p[i++];
+        while(i < len && split_utf8(file->utf8_part, n) == 0);
+        if((k = split_utf8(file->utf8_part, n)) == 0) {
+            file->utf8_npart = n;
+            file->utf8_seen += (file_off_t)len;
+            return;
+        }
+        /* bytes past the character are checked with the rest */
+        i -= n - k;
+        if(check_utf8(file->utf8_part, k) < k) {
+            file->utf8_bad = file->utf8_seen -
+                (file_off_t)file->utf8_npart;
+            _errno_file = FILE_ERROR_UTF8;
+            return;
+        }
+        file->utf8_npart = 0;
+    }
+    k = i + split_utf8(p + i, len - i);
+    if((n = i + check_utf8(p + i, k - i)) < k) {
+        file->utf8_bad = file->utf8_seen + (file_off_t)n;
+        _errno_file = FILE_ERROR_UTF8;
+        return;
+    }
+    memcpy(file->utf8_part, p + k, len - k);
+    file->utf8_npart = len - k;
+    file->utf8_seen += (file_off_t)len;
 }
-/* Write formatted into file
+/* Hand output of the typed writers to the stdio stream.
  */
-PRS_EXPORT int writef_file(file_t *file, const char *buf, ...)
+static int _flush_write_file(file_t *file)
 {
-    int res;
-    va_list ap;
-    va_start(ap, buf);
-    res = vfprintf(file->fp, buf, ap);
-    va_end(ap);
-    if(res < 0)
-        _errno_file = FILE_ERROR_WRITE;
+    size_t len = file->buf.wlen;
+    file->buf.wlen = 0;
+    file->buf.wcap = 0;
+    _crc_file(file, file->buf.wbuf, len);
+    if(len > 0 && _put_raw_file(file, file->buf.wbuf, len) != len)
+        return -1;
+    return 0;
+}
+/* Hand read-ahead of the line cursor back to the stdio stream, and
+ * buffered output of the typed writers to it; PUTC_FILE() has to ask
+ * for room again afterwards. Returns -1 if the stream cannot seek back
+ * (a pipe); the read-ahead is kept then and has to be read first.
+ */
+static int _sync_file(file_t *file)
+{
+    size_t unread;
+    _fold_map_file(file);
+    file->buf.wcap = 0;
+    if(file->buf.wlen > 0)
+        _flush_write_file(file);
+    if(file->buf.rlen == 0)
+        return 0;
+    if((unread = file->buf.rlen - file->buf.rpos) > 0) {
+        if(FILE_SEEK(file->fp, -(file_off_t)unread, SEEK_CUR) != 0)
+            return -1;
+        if(file->utf8_on)
+            file->utf8_skip += unread;
+    }
+    file->buf.rpos = 0;
+    file->buf.rlen = 0;
+    return 0;
+}
+/* Sync before reading on from where the stream is; typed output handed
+ * to stdio has to be flushed before input, or large reads pass it by.
+ */
+static int _sync_read_file(file_t *file)
+{
+    int out = (file->buf.wlen > 0);
+    int res = _sync_file(file);
+    if(out && file->io == NULL)
+        fflush(file->fp);
     return res;
 }
-/* Write formatted into file; using va_list
+/* Read len bytes, the read-ahead kept by _sync_file() first; returns
+ * how many of them were read ahead in *ahead, already checked as text.
  */
-PRS_EXPORT int vwritef_file(file_t *file, const char *buf, va_list ap)
+static size_t _get_ahead_file(file_t *file, void *buf, size_t len,
+    size_t *ahead)
 {
-    return vfprintf(file->fp, buf, ap);
+    size_t n = file->buf.rlen - file->buf.rpos;
+    if(n > len)
+        n = len;
+    memcpy(buf, file->buf.rbuf + file->buf.rpos, n);
+    file->buf.rpos += n;
+    if(file->buf.rpos == file->buf.rlen)
+        file->buf.rpos = file->buf.rlen = 0;
+    *ahead = n;
+    return (n < len) ? n + _get_raw_file(file, (char*)buf + n, len - n) : n;
 }
-/* Read a line of text from file
+
+/* --------------------------- index functions ------------------------- */
+
+/* Append a line start offset to the index.
  */
-PRS_EXPORT char *gets_file(file_t *file, char *buf, long size)
+static int _push_index_file(file_t *file, file_off_t off)
 {
-	return fgets(buf, size, file->fp);
+    if(file->index_len == file->index_cap) {
+        size_t cap = file->index_cap ? file->index_cap*2 : 1024;
+        file_off_t *index = (file_off_t*)realloc(file->index,
+            cap*sizeof(file_off_t));
+        if(index == NULL)
+            return -1;
+        file->index = index;
+        file->index_cap = cap;
+    }
+    file->index[file->index_len++] = off;
+    return 0;
 }
-/* Put a line of text to file
+/* Throw away the whole line index.
  */
-PRS_EXPORT int puts_file(file_t *file, const char *buf)
+static void _reset_index_file(file_t *file)
 {
-	return fputs(buf, file->fp);
+    free(file->index);
+    file->index = NULL;
+    file->index_len = 0;
+    file->index_cap = 0;
+    file->index_end = 0;
 }
-/* Read formatted from file
+/* Forget every line after the one holding pos; pos is being rewritten.
  */
-PRS_EXPORT int readf_file(file_t *file, const char *buf, ...)
+static void _truncate_index_file(file_t *file, file_off_t pos)
 {
-    int res;
-    va_list ap;
-    va_start(ap, buf);
-    res = vfscanf(file->fp, buf, ap);
-    va_end(ap);
-    if(res < 0)
-        _errno_file = FILE_ERROR_READ;
-    return res;
+    size_t lo = 0, hi = file->index_len;
+    if(pos < 0 || file->index_len == 0) {
+        file->index_len = 0;
+        file->index_end = 0;
+        return;
+    }
+    while(hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(file->index[mid] <= pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    file->index_len = lo + 1;
+    if(file->index_end > file->index[lo])
+        file->index_end = file->index[lo];
 }
-/* Gets one byte from the file
+#ifdef FILE_SIMD
+/* Record newlines 32 bytes at a time; returns bytes consumed.
  */
-PRS_EXPORT int getc_file(file_t *file)
+__attribute__((target("avx2")))
+static size_t _scan_avx2_file(file_t *file, const unsigned char *buf,
+    size_t len, file_off_t base)
 {
-    int c;
-    
-    errno = 0;
-    c = fgetc(file->fp);
-    if(errno != 0)
-        _errno_file = FILE_ERROR_READ;
-    return c;
+    const __m256i nl = _mm256_set1_epi8('\n');
+    unsigned int mask;
+    size_t i;
+    for(i = 0; i + 32 <= len; i += 32) {
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(buf + i)), nl));
+        for(; mask != 0; mask &= mask - 1)
+            if(_push_index_file(file,
+                    base + (file_off_t)(i + __builtin_ctz(mask)) + 1) < 0)
+                return (size_t)-1;
+    }
+    return i;
 }
-/* Puts one byte into the file.
+#endif
+/* Record the start of every line that follows a newline in buf; on
+ * failure none of them is kept, so a retry of buf adds no duplicates.
  */
-PRS_EXPORT void putc_file(file_t *file, int c)
+static int _scan_index_file(file_t *file, const unsigned char *buf,
+    size_t len, file_off_t base)
 {
-    errno = 0;
-    fputc(c, file->fp);
-    if(errno != 0)
-        _errno_file = FILE_ERROR_WRITE;
+    const unsigned char *p, *end = buf + len;
+    size_t i = 0, n = file->index_len;
+#ifdef FILE_SIMD
+    const __m128i nl = _mm_set1_epi8('\n');
+    unsigned int mask;
+    if(__builtin_cpu_supports("avx2") &&
+            (i = _scan_avx2_file(file, buf, len, base)) == (size_t)-1)
+        goto fail;
+    for(; i + 16 <= len; i += 16) {
+        mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(buf + i)), nl));
+        for(; mask != 0; mask &= mask - 1)
+            if(_push_index_file(file,
+                    base + (file_off_t)(i + __builtin_ctz(mask)) + 1) < 0)
+                goto fail;
+    }
+#endif
+    for(p = buf + i; p < end && (p = memchr(p, '\n', end - p)) != NULL; p++)
+        if(_push_index_file(file, base + (file_off_t)(p - buf) + 1) < 0)
+            goto fail;
+    return 0;
+fail:
+    file->index_len = n;
+    return -1;
 }
-/* Puts one byte back onto file stream.
+/* Extend the line index up to the current end of the file; the size
+ * is asked for anew, so lines others append are picked up.
  */
-PRS_EXPORT void ungetc_file(file_t *file, int c)
+static int _index_file(file_t *file)
 {
-    errno = 0;
-    ungetc(c, file->fp);
-    if(errno != 0)
-        _errno_file = FILE_ERROR_WRITE;
+    unsigned char buf[BUFSIZ*4];
+    file_off_t size, cur_pos;
+    size_t len;
+    _sync_file(file);
+    if((size = get_size64_file(file)) < 0)
+        return -1;
+    if(file->index_end > size)
+        _reset_index_file(file);
+    if(file->index_len == 0 && _push_index_file(file, 0) < 0)
+        return -1;
+    if(file->index_end == size)
+        return 0;
+    if(file->flags & FILE_FLAG_MAP) {
+        if(_scan_index_file(file, file->map + file->index_end,
+                file->map_len - (size_t)file->index_end,
+                file->index_end) < 0)
+            return -1;
+        file->index_end = (file_off_t)file->map_len;
+        return 0;
+    }
+    cur_pos = FILE_TELL(file->fp);
+    if(FILE_SEEK(file->fp, file->index_end, SEEK_SET) != 0)
+        return -1;
+    while(file->index_end < size &&
+            (len = _get_raw_file(file, buf, sizeof(buf))) > 0) {
+        if(_scan_index_file(file, buf, len, file->index_end) < 0)
+            break;
+        file->index_end += (file_off_t)len;
+    }
+    FILE_SEEK(file->fp, cur_pos, SEEK_SET);
+    return (file->index_end < size) ? -1 : 0;
 }
-/* Seek through file by bytes.
+/* Drop the line index past the write position after a write.
  */
-PRS_EXPORT int seek_file(file_t *file, long bytes, int seek)
+static void _invalidate_file(file_t *file)
 {
-    int res;
-    errno = 0;
-    res = fseek(file->fp, bytes, seek);
-    if(errno != 0)
-        _errno_file = FILE_ERROR_SEEK;
-    return res;
+    if(file->index_end > 0 && !(file->flags & FILE_FLAG_APPEND))
+        _truncate_index_file(file, FILE_TELL(file->fp));
 }
-/* Rewind file back to start.
+/* Sync the stdio position with the mapped position.
  */
-PRS_EXPORT void rewind_file(file_t *file)
+static void _sync_map_file(file_t *file)
 {
-	rewind(file->fp);
+    _fold_map_file(file);
+    FILE_SEEK(file->fp, (file_off_t)file->map_pos, SEEK_SET);
 }
-/* Tell size of file; returns size in bytes.
+
+/* -------------------------- backend functions ------------------------ */
+
+#ifdef FILE_HAVE_IO
+/* Read callback of a memory file.
  */
-PRS_EXPORT long tell_file(file_t *file)
+static long _read_mem_file(void *ctx, void *buf, size_t len)
 {
-    long size;
-    errno = 0;
-    size = ftell(file->fp);
-    if(errno != 0)
-        _errno_file = FILE_ERROR_TELL;
-    return size;
+    struct file_mem *mem = (struct file_mem*)ctx;
+    if(mem->pos >= mem->len)
+        return 0;
+    if(len > mem->len - mem->pos)
+        len = mem->len - mem->pos;
+    memcpy(buf, mem->data + mem->pos, len);
+    mem->pos += len;
+    return (long)len;
 }
-/* Flush the file stream.
+/* Write callback of a memory file; grows it by doubling.
  */
-PRS_EXPORT int flush_file(file_t *file)
+static long _write_mem_file(void *ctx, const void *buf, size_t len)
 {
-    return fflush(file->fp);
+    struct file_mem *mem = (struct file_mem*)ctx;
+    unsigned char *data;
+    size_t cap;
+    if(mem->append)
+        mem->pos = mem->len;
+    if(mem->pos + len > mem->cap) {
+        for(cap = mem->cap ? mem->cap : 4096; cap < mem->pos + len; cap *= 2)
+            ;
+        if((data = (unsigned char*)realloc(mem->data, cap)) == NULL)
+            return -1;
+        mem->data = data;
+        mem->cap = cap;
+    }
+    /* a write past the end leaves a hole of zeros */
+    if(mem->pos > mem->len)
+        memset(mem->data + mem->len, 0, mem->pos - mem->len);
+    memcpy(mem->data + mem->pos, buf, len);
+    mem->pos += len;
+    if(mem->pos > mem->len)
+        mem->len = mem->pos;
+    return (long)len;
+}
+/* Seek callback of a memory file.
+ */
+static int _seek_mem_file(void *ctx, file_off_t *off, int whence)
+{
+    struct file_mem *mem = (struct file_mem*)ctx;
+    file_off_t base = 0;
+    if(whence == SEEK_CUR)
+        base = (file_off_t)mem->pos;
+    else if(whence == SEEK_END)
+        base = (file_off_t)mem->len;
+    if(base + *off < 0)
+        return -1;
+    mem->pos = (size_t)(base + *off);
+    *off = (file_off_t)mem->pos;
+    return 0;
+}
+/* Close callback of a memory file.
+ */
+static int _close_mem_file(void *ctx)
+{
+    struct file_mem *mem = (struct file_mem*)ctx;
+    free(mem->data);
+    free(mem);
+    return 0;
 }
 
-/* --------------------------- helper funtions ------------------------- */
+static const file_io_t _mem_io_file = {
+    _read_mem_file, _write_mem_file, _seek_mem_file, _close_mem_file
+};
+#endif
 
-/* Gets the handle for a given file; returns FILE pointer.
+/* Store a 32-bit little endian value.
  */
-PRS_EXPORT FILE *get_handle_file(file_t *file)
+static void _put32_file(unsigned char *p, unsigned long v)
 {
-    return (file->fp == NULL) ? NULL : file->fp;
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)((v >> 24) & 0xFF);
 }
-/* Gets the name of the file passed in.
+/* Load a 32-bit little endian value.
  */
-PRS_EXPORT const char *get_name_file(file_t *file)
+static unsigned long _get32_file(const unsigned char *p)
 {
-    return file->name;
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+        ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
 }
-/* Gets the size of the current file.
+/* Compress the buffered block and write it out.
  */
-PRS_EXPORT long get_size_file(file_t *file)
+static int _flush_zip_file(struct file_zip *zip)
 {
-    long size, cur_pos;
-    cur_pos = ftell(file->fp);
-    fseek(file->fp, 0, SEEK_END);
-    errno = 0;
-    size = ftell(file->fp);
-    if(errno != 0)
-        _errno_file = FILE_ERROR_SIZE;
-    fseek(file->fp, cur_pos, SEEK_SET);
-    return size;
+    unsigned char head[8];
+    size_t n;
+    if(zip->raw_len == 0)
+        return 0;
+    n = compress_lz(zip->raw, zip->raw_len, zip->pack, zip->pack_cap);
+    _put32_file(head, (unsigned long)zip->raw_len);
+    if(n == 0 || n >= zip->raw_len) {
+        _put32_file(head + 4, (unsigned long)zip->raw_len | LZ_STORED);
+        if(fwrite(head, 1, 8, zip->fp) != 8 ||
+                fwrite(zip->raw, 1, zip->raw_len, zip->fp) != zip->raw_len)
+            return -1;
+    } else {
+        _put32_file(head + 4, (unsigned long)n);
+        if(fwrite(head, 1, 8, zip->fp) != 8 ||
+                fwrite(zip->pack, 1, n, zip->fp) != n)
+            return -1;
+    }
+    zip->block += (file_off_t)zip->raw_len;
+    zip->raw_len = 0;
+    return 0;
 }
-/* Gets the line count of the current file.
+/* Add the next block header to the index; sets done at end of file.
  */
-PRS_EXPORT int get_lines_file(file_t *file)
+static int _walk_zip_file(struct file_zip *zip)
+{
+    unsigned char head[8];
+    file_off_t *index;
+    unsigned long raw, packed;
+    if(FILE_SEEK(zip->fp, zip->next_packed, SEEK_SET) != 0)
+        return -1;
+    if(fread(head, 1, 8, zip->fp) != 8) {
+        zip->done = 1;
+        return 0;
+    }
+    raw = _get32_file(head);
+    packed = _get32_file(head + 4) & ~LZ_STORED;
+    if(raw == 0 || raw > FILE_ZIP_BLOCK || packed > zip->pack_cap)
+        return -1;
+    if(zip->index_len == zip->index_cap) {
+        size_t cap = zip->index_cap ? zip->index_cap * 2 : 64;
+        index = (file_off_t*)realloc(zip->index, cap * 2 * sizeof(*index));
+        if(index == NULL)
+            return -1;
+        zip->index = index;
+        zip->index_cap = cap;
+    }
+    zip->index[zip->index_len * 2] = zip->next_raw;
+    zip->index[zip->index_len * 2 + 1] = zip->next_packed;
+    zip->index_len++;
+    zip->next_raw += (file_off_t)raw;
+    zip->next_packed += 8 + (file_off_t)packed;
+    return 0;
+}
+/* Make the block holding pos the current one; past the end there is
+ * no current block.
+ */
+static int _locate_zip_file(struct file_zip *zip, file_off_t pos)
+{
+    unsigned char head[8];
+    unsigned long raw, packed;
+    size_t lo, hi, mid, len;
+    if(pos >= zip->block && pos < zip->block + (file_off_t)zip->raw_len) {
+        zip->raw_pos = (size_t)(pos - zip->block);
+        return 0;
+    }
+    while(!zip->done && zip->next_raw <= pos)
+        if(_walk_zip_file(zip) < 0)
+            return -1;
+    if(pos >= zip->next_raw) {
+        zip->block = pos;
+        zip->raw_len = 0;
+        zip->raw_pos = 0;
+        return 0;
+    }
+    /* last block starting at or before pos */
+    for(lo = 0, hi = zip->index_len; hi - lo > 1; ) {
+        mid = (lo + hi) / 2;
+        if(zip->index[mid * 2] <= pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if(FILE_SEEK(zip->fp, zip->index[lo * 2 + 1], SEEK_SET) != 0 ||
+            fread(head, 1, 8, zip->fp) != 8)
+        return -1;
+    raw = _get32_file(head);
+    packed = _get32_file(head + 4);
+    if(fread(zip->pack, 1, packed & ~LZ_STORED, zip->fp) !=
+            (packed & ~LZ_STORED))
+        return -1;
+    len = FILE_ZIP_BLOCK;
+    if(packed & LZ_STORED)
+        memcpy(zip->raw, zip->pack, (len = raw));
+    else if(decompress_lz(zip->pack, packed, zip->raw, &len) < 0 ||
+            len != raw)
+        return -1;
+    zip->block = zip->index[lo * 2];
+    zip->raw_len = len;
+    zip->raw_pos = (size_t)(pos - zip->block);
+    return 0;
+}
+/* Read callback of a compressed file.
+ */
+static long _read_zip_file(void *ctx, void *buf, size_t len)
+{
+    struct file_zip *zip = (struct file_zip*)ctx;
+    if(zip->write)
+        return -1;
+    if(zip->raw_pos >= zip->raw_len && _locate_zip_file(zip,
+            zip->block + (file_off_t)zip->raw_len) < 0)
+        return -1;
+    if(len > zip->raw_len - zip->raw_pos)
+        len = zip->raw_len - zip->raw_pos;
+    memcpy(buf, zip->raw + zip->raw_pos, len);
+    zip->raw_pos += len;
+    return (long)len;
+}
+/* Write callback of a compressed file; output is append only.
+ */
+static long _write_zip_file(void *ctx, const void *buf, size_t len)
+{
+    struct file_zip *zip = (struct file_zip*)ctx;
+    size_t done = 0, n;
+    if(!zip->write)
+        return -1;
+    while(done < len) {
+        n = FILE_ZIP_BLOCK - zip->raw_len;
+        if(n > len - done)
+            n = len - done;
+        memcpy(zip->raw + zip->raw_len, (const char*)buf + done, n);
+        zip->raw_len += n;
+        done += n;
+        if(zip->raw_len == FILE_ZIP_BLOCK && _flush_zip_file(zip) < 0)
+            return done > n ? (long)(done - n) : -1;
+    }
+    return (long)len;
+}
+/* Seek callback of a compressed file; writers can only stay put.
+ */
+static int _seek_zip_file(void *ctx, file_off_t *off, int whence)
+{
+    struct file_zip *zip = (struct file_zip*)ctx;
+    file_off_t pos;
+    pos = zip->block + (file_off_t)(zip->write ? zip->raw_len :
+        zip->raw_pos);
+    if(whence == SEEK_SET) {
+        pos = *off;
+    } else if(whence == SEEK_END && !zip->write) {
+        while(!zip->done)
+            if(_walk_zip_file(zip) < 0)
+                return -1;
+        pos = zip->next_raw + *off;
+    } else {
+        pos += *off;
+    }
+    if(zip->write) {
+        if(pos != zip->block + (file_off_t)zip->raw_len)
+            return -1;
+    } else if(pos < 0 || _locate_zip_file(zip, pos) < 0) {
+        return -1;
+    }
+    *off = pos;
+    return 0;
+}
+/* Close callback of a compressed file.
+ */
+static int _close_zip_file(void *ctx)
+{
+    struct file_zip *zip = (struct file_zip*)ctx;
+    int res = 0;
+    if(zip->write && _flush_zip_file(zip) < 0)
+        res = -1;
+    if(zip->fp != NULL && fclose(zip->fp) != 0)
+        res = -1;
+    free(zip->raw);
+    free(zip->pack);
+    free(zip->index);
+    free(zip);
+    return res;
+}
+
+static const file_io_t _zip_io_file = {
+    _read_zip_file, _write_zip_file, _seek_zip_file, _close_zip_file
+};
+#ifndef _WIN32
+/* Move len bytes at off with one pread() or all of a pwrite(); a file
+ * system turning down direct I/O gets it switched off. Returns bytes
+ * moved or -1.
+ */
+static long _xfer_direct_file(struct file_direct *dir, int write,
+    void *buf, size_t len, file_off_t off)
+{
+    size_t done = 0;
+    ssize_t n;
+    int fl;
+    while(done < len) {
+        if(write)
+            n = pwrite(dir->fd, (char*)buf + done, len - done,
+                (off_t)(off + (file_off_t)done));
+        else
+            n = pread(dir->fd, buf, len, (off_t)off);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && errno == EINVAL && FILE_O_DIRECT != 0 &&
+                ((fl = fcntl(dir->fd, F_GETFL)) & FILE_O_DIRECT) &&
+                fcntl(dir->fd, F_SETFL, fl & ~FILE_O_DIRECT) == 0)
+            continue;
+        if(n < 0)
+            return -1;
+        done += (size_t)n;
+        /* short reads only happen at the end of a file */
+        if(!write || n == 0)
+            break;
+    }
+    return (long)done;
+}
+/* Write out the buffer; a partial last block is padded, then cut off.
+ */
+static int _flush_direct_file(struct file_direct *dir)
+{
+    size_t n;
+    if(dir->len == 0)
+        return 0;
+    n = (dir->len + FILE_DIRECT_ALIGN - 1) &
+        ~(size_t)(FILE_DIRECT_ALIGN - 1);
+    memset(dir->buf + dir->len, 0, n - dir->len);
+    if(_xfer_direct_file(dir, 1, dir->buf, n, dir->base) != (long)n)
+        return -1;
+    if(n != dir->len && ftruncate(dir->fd,
+            (off_t)(dir->base + (file_off_t)dir->len)) < 0)
+        return -1;
+    dir->base += (file_off_t)dir->len;
+    dir->len = 0;
+    return 0;
+}
+/* Read callback of a direct file.
+ */
+static long _read_direct_file(void *ctx, void *buf, size_t len)
+{
+    struct file_direct *dir = (struct file_direct*)ctx;
+    file_off_t at;
+    long n;
+    if(dir->write)
+        return -1;
+    if(dir->pos >= dir->len) {
+        at = dir->base + (file_off_t)dir->pos;
+        dir->base = at & ~(file_off_t)(FILE_DIRECT_ALIGN - 1);
+        dir->pos = (size_t)(at - dir->base);
+        dir->len = 0;
+        /* whole blocks into an aligned caller buffer skip the copy */
+        if(dir->pos == 0 && len >= FILE_DIRECT_ALIGN &&
+                ((size_t)buf & (FILE_DIRECT_ALIGN - 1)) == 0) {
+            n = _xfer_direct_file(dir, 0, buf,
+                len & ~(size_t)(FILE_DIRECT_ALIGN - 1), dir->base);
+            if(n > 0)
+                dir->base += n;
+            return n;
+        }
+        n = _xfer_direct_file(dir, 0, dir->buf, FILE_DIRECT_BUFSIZ,
+            dir->base);
+        if(n < 0)
+            return -1;
+        dir->len = (size_t)n;
+        if(dir->pos >= dir->len)
+            return 0;
+    }
+    if(len > dir->len - dir->pos)
+        len = dir->len - dir->pos;
+    memcpy(buf, dir->buf + dir->pos, len);
+    dir->pos += len;
+    return (long)len;
+}
+/* Write callback of a direct file; output is append only.
+ */
+static long _write_direct_file(void *ctx, const void *buf, size_t len)
+{
+    struct file_direct *dir = (struct file_direct*)ctx;
+    const char *p = (const char*)buf;
+    size_t done = 0, n;
+    if(!dir->write)
+        return -1;
+    while(done < len) {
+        n = len - done;
+        /* whole blocks of an aligned caller buffer skip the copy */
+        if(dir->len == 0 && n >= FILE_DIRECT_ALIGN &&
+                ((size_t)(p + done) & (FILE_DIRECT_ALIGN - 1)) == 0) {
+            n &= ~(size_t)(FILE_DIRECT_ALIGN - 1);
+            if(_xfer_direct_file(dir, 1, (void*)(p + done), n,
+                    dir->base) != (long)n)
+                return done > 0 ? (long)done : -1;
+            dir->base += (file_off_t)n;
+            done += n;
+            continue;
+        }
+        if(n > FILE_DIRECT_BUFSIZ - dir->len)
+            n = FILE_DIRECT_BUFSIZ - dir->len;
+        memcpy(dir->buf + dir->len, p + done, n);
+        dir->len += n;
+        done += n;
+        if(dir->len == FILE_DIRECT_BUFSIZ && _flush_direct_file(dir) < 0)
+            return done > n ? (long)(done - n) : -1;
+    }
+    return (long)len;
+}
+/* Seek callback of a direct file; writers can only stay put.
+ */
+static int _seek_direct_file(void *ctx, file_off_t *off, int whence)
+{
+    struct file_direct *dir = (struct file_direct*)ctx;
+    struct stat st;
+    file_off_t pos;
+    pos = dir->base + (file_off_t)(dir->write ? dir->len : dir->pos);
+    if(whence == SEEK_SET) {
+        pos = *off;
+    } else if(whence == SEEK_END && !dir->write) {
+        if(fstat(dir->fd, &st) < 0)
+            return -1;
+        pos = (file_off_t)st.st_size + *off;
+    } else {
+        pos += *off;
+    }
+    if(dir->write) {
+        if(pos != dir->base + (file_off_t)dir->len)
+            return -1;
+    } else if(pos < 0) {
+        return -1;
+    } else if(pos >= dir->base &&
+            pos <= dir->base + (file_off_t)dir->len) {
+        dir->pos = (size_t)(pos - dir->base);
+    } else {
+        dir->base = pos;
+        dir->len = 0;
+        dir->pos = 0;
+    }
+    *off = pos;
+    return 0;
+}
+/* Close callback of a direct file.
+ */
+static int _close_direct_file(void *ctx)
 {
-    int nl,c;
-    fseek(file->fp, 0, SEEK_SET);
-    for(nl=0; (c = fgetc(file->fp)) != EOF;)
-        if(c == '\n')
-            nl++;
-    fseek(file->fp, 0, SEEK_SET);
-    return nl;
+    struct file_direct *dir = (struct file_direct*)ctx;
+    int res = 0;
+    if(dir->write && _flush_direct_file(dir) < 0)
+        res = -1;
+    if(dir->fd >= 0 && close(dir->fd) < 0)
+        res = -1;
+    free_direct_file(dir->buf);
+    free(dir);
+    return res;
+}
+
+static const file_io_t _direct_io_file = {
+    _read_direct_file, _write_direct_file, _seek_direct_file,
+    _close_direct_file
+};
+#endif
+/* Descriptor the data of file ends up on, -1 when there is none.
+ */
+static int _fd_file(file_t *file)
+{
+    if(file->fp == NULL)
+        return -1;
+#ifndef _WIN32
+    if(file->io == &_direct_io_file)
+        return ((struct file_direct*)file->io_ctx)->fd;
+    if(!(file->flags & FILE_FLAG_STREAM))
+        return fileno(file->fp);
+#endif
+    return -1;
+}
+/* Give back blocks reserve_file() set aside past the end of the file.
+ */
+static void _release_file(file_t *file)
+{
+#ifndef _WIN32
+    struct stat st;
+    int fd;
+    if((fd = _fd_file(file)) < 0)
+        return;
+    _sync_file(file);
+    fflush(file->fp);
+    if(fstat(fd, &st) == 0 && ftruncate(fd, st.st_size) < 0)
+        _errno_file = FILE_ERROR_WRITE;
+#endif
+    file->flags &= ~FILE_FLAG_RESERVE;
+}
+
+#if defined(FILE_HAVE_IO) && defined(__linux)
+#if defined(__GLIBC__)
+typedef off64_t file_cookie_off_t;
+#else
+typedef off_t file_cookie_off_t;
+#endif
+/* Hand stdio requests of a stream to the backend of its file.
+ */
+static ssize_t _read_io_file(void *cookie, char *buf, size_t len)
+{
+    file_t *file = (file_t*)cookie;
+    if(file->io->read == NULL)
+        return -1;
+    return (ssize_t)file->io->read(file->io_ctx, buf, len);
+}
+static ssize_t _write_io_file(void *cookie, const char *buf, size_t len)
+{
+    file_t *file = (file_t*)cookie;
+    long n;
+    if(file->io->write == NULL)
+        return 0;
+    n = file->io->write(file->io_ctx, buf, len);
+    return n < 0 ? 0 : (ssize_t)n;
+}
+static int _seek_io_file(void *cookie, file_cookie_off_t *off, int whence)
+{
+    file_t *file = (file_t*)cookie;
+    file_off_t pos = (file_off_t)*off;
+    if(file->io->seek == NULL || file->io->seek(file->io_ctx, &pos,
+            whence) != 0)
+        return -1;
+    *off = (file_cookie_off_t)pos;
+    return 0;
+}
+#elif defined(FILE_HAVE_IO)
+static int _read_io_file(void *cookie, char *buf, int len)
+{
+    file_t *file = (file_t*)cookie;
+    if(file->io->read == NULL)
+        return -1;
+    return (int)file->io->read(file->io_ctx, buf, (size_t)len);
+}
+static int _write_io_file(void *cookie, const char *buf, int len)
+{
+    file_t *file = (file_t*)cookie;
+    if(file->io->write == NULL)
+        return -1;
+    return (int)file->io->write(file->io_ctx, buf, (size_t)len);
+}
+static fpos_t _seek_io_file(void *cookie, fpos_t off, int whence)
+{
+    file_t *file = (file_t*)cookie;
+    file_off_t pos = (file_off_t)off;
+    if(file->io->seek == NULL || file->io->seek(file->io_ctx, &pos,
+            whence) != 0)
+        return -1;
+    return (fpos_t)pos;
+}
+#endif
+#ifdef FILE_HAVE_IO
+static int _close_io_file(void *cookie)
+{
+    file_t *file = (file_t*)cookie;
+    if(file->io->close == NULL)
+        return 0;
+    return file->io->close(file->io_ctx);
+}
+#endif
+
+/* ------------------------- standard functions ------------------------ */
+
+/* Allocate a file that is not open yet; fmode receives the stdio mode.
+ */
+static file_t *_alloc_file(const char *mode, char *fmode)
+{
+    file_t *file;
+    file = (file_t*)malloc(sizeof(file_t));
+    if(file == NULL)
+	return NULL;
+    file->fp = NULL;
+    memset(file->name, 0, MAX_PATH);
+    file->map = NULL;
+    file->map_len = 0;
+    file->map_pos = 0;
+    file->map_win = 0;
+    file->index = NULL;
+    file->index_len = 0;
+    file->index_cap = 0;
+    file->index_end = 0;
+    file->buf.rbuf = NULL;
+    file->rcap = 0;
+    file->buf.rpos = 0;
+    file->buf.rlen = 0;
+    file->buf.wbuf = NULL;
+    file->buf.wlen = 0;
+    file->buf.wcap = 0;
+    file->io = NULL;
+    file->io_ctx = NULL;
+    file->crc_on = 0;
+    file->crc = 0;
+    file->utf8_on = 0;
+    file->utf8_npart = 0;
+    file->utf8_skip = 0;
+    file->utf8_seen = 0;
+    file->utf8_bad = -1;
+    file->vbuf = NULL;
+    file->vsize = 0;
+    file->vset = 0;
+    file->aio = 0;
+    file->io_eof = 0;
+    file->flags = _parse_mode_file(mode, fmode);
+    _errno_file = FILE_ERROR_OKAY;
+    return file;
+}
+/* Finish opening file over the stream fp.
+ */
+static file_t *_attach_file(file_t *file, FILE *fp, const char *name)
+{
+    if((file->fp = fp) == NULL) {
+        _errno_file = FILE_ERROR_OPEN;
+        return file;
+    }
+    strncpy(file->name, name, MAX_PATH-1);
+    if((file->flags & FILE_FLAG_MAP) && _map_file(file) < 0) {
+        _errno_file = FILE_ERROR_OPEN;
+        return file;
+    }
+    /* size and lines are worked out on first use */
+    return file;
+}
+/* Finish opening file over a stream made of a backend.
+ */
+static file_t *_attach_io_file(file_t *file, const file_io_t *io,
+    void *ctx, const char *name, const char *fmode)
+{
+    FILE *fp = NULL;
+    file->flags |= FILE_FLAG_STREAM|FILE_FLAG_ANON;
+    file->io = io;
+    file->io_ctx = ctx;
+#if defined(FILE_HAVE_IO) && defined(__linux)
+    {
+        cookie_io_functions_t funcs;
+        funcs.read = _read_io_file;
+        funcs.write = _write_io_file;
+        funcs.seek = _seek_io_file;
+        funcs.close = _close_io_file;
+        fp = fopencookie(file, fmode, funcs);
+    }
+#elif defined(FILE_HAVE_IO)
+    fp = funopen(file, _read_io_file, _write_io_file, _seek_io_file,
+        _close_io_file);
+#endif
+    if(fp == NULL && io->close != NULL) {
+        io->close(ctx);
+        file->io = NULL;
+    }
+    /* data moves straight through the backend, see _get_raw_file() */
+    if(fp != NULL)
+        setvbuf(fp, NULL, _IONBF, 0);
+    return _attach_file(file, fp, name);
+}
+/* Open a file of compressed blocks, read only or write only.
+ */
+static file_t *_open_zip_file(file_t *file, const char *filename,
+    const char *fmode)
+{
+    static const unsigned char magic[FILE_ZIP_HEADER] = {
+        'P', 'R', 'S', 'Z', 1, 0, 0, 0
+    };
+    unsigned char head[FILE_ZIP_HEADER];
+    struct file_zip *zip;
+    size_t n;
+    zip = (struct file_zip*)malloc(sizeof(struct file_zip));
+    if(zip == NULL || strchr(fmode, '+') != NULL) {
+        free(zip);
+        return _attach_file(file, NULL, filename);
+    }
+    zip->write = (strchr(fmode, 'w') != NULL || strchr(fmode, 'a') != NULL);
+    zip->raw_len = 0;
+    zip->raw_pos = 0;
+    zip->block = 0;
+    zip->index = NULL;
+    zip->index_len = 0;
+    zip->index_cap = 0;
+    zip->next_raw = 0;
+    zip->next_packed = FILE_ZIP_HEADER;
+    zip->done = 0;
+    zip->pack_cap = bound_lz(FILE_ZIP_BLOCK);
+    zip->raw = (unsigned char*)malloc(FILE_ZIP_BLOCK);
+    zip->pack = (unsigned char*)malloc(zip->pack_cap);
+    zip->fp = fopen(filename, strchr(fmode, 'w') ? "wb" :
+        strchr(fmode, 'a') ? "a+b" : "rb");
+    if(zip->raw == NULL || zip->pack == NULL || zip->fp == NULL) {
+        _close_zip_file(zip);
+        return _attach_file(file, NULL, filename);
+    }
+    /* new files get a header, old ones must have one */
+    n = strchr(fmode, 'w') ? 0 : fread(head, 1, sizeof(head), zip->fp);
+    if(n == 0 && zip->write) {
+        if(fwrite(magic, 1, sizeof(magic), zip->fp) != sizeof(magic))
+            n = 1;
+    } else if(n != sizeof(head) || memcmp(head, magic, sizeof(head)) != 0) {
+        n = 1;
+    } else if(zip->write) {
+        /* appending, carry on after the last block */
+        while(!zip->done && _walk_zip_file(zip) == 0)
+            ;
+        zip->block = zip->next_raw;
+        n = !zip->done;
+    } else {
+        n = 0;
+    }
+    if(n != 0) {
+        _close_zip_file(zip);
+        return _attach_file(file, NULL, filename);
+    }
+    return _attach_io_file(file, &_zip_io_file, zip, filename, fmode);
+}
+/* Open a file read only or write only with direct I/O; anything else
+ * is opened like any other file.
+ */
+static file_t *_open_direct_file(file_t *file, const char *filename,
+    const char *fmode)
+{
+#ifndef _WIN32
+    struct file_direct *dir;
+    file_off_t end;
+    long n = 0;
+    int flags;
+    if(strchr(fmode, '+') != NULL ||
+            (dir = (struct file_direct*)malloc(sizeof(*dir))) == NULL)
+        return _attach_file(file, fopen(filename, fmode), filename);
+    dir->write = (strchr(fmode, 'w') != NULL || strchr(fmode, 'a') != NULL);
+    dir->len = 0;
+    dir->pos = 0;
+    dir->base = 0;
+    dir->buf = (unsigned char*)alloc_direct_file(FILE_DIRECT_BUFSIZ);
+    /* positions are kept here, O_APPEND would get in the way */
+    flags = strchr(fmode, 'w') ? O_WRONLY|O_CREAT|O_TRUNC :
+        strchr(fmode, 'a') ? O_RDWR|O_CREAT : O_RDONLY;
+    dir->fd = open(filename, flags|FILE_O_DIRECT, 0666);
+    if(dir->fd < 0 && errno == EINVAL)
+        dir->fd = open(filename, flags, 0666);
+#ifdef F_NOCACHE
+    if(dir->fd >= 0)
+        fcntl(dir->fd, F_NOCACHE, 1);
+#endif
+    if(dir->fd >= 0 && strchr(fmode, 'a') != NULL) {
+        /* appending, start over the last partial block */
+        end = (file_off_t)lseek(dir->fd, 0, SEEK_END);
+        dir->base = end & ~(file_off_t)(FILE_DIRECT_ALIGN - 1);
+        if(end < 0 || dir->buf == NULL || (n = _xfer_direct_file(dir, 0,
+                dir->buf, FILE_DIRECT_ALIGN, dir->base)) != end - dir->base)
+            n = -1;
+        else
+            dir->len = (size_t)n;
+    }
+    if(dir->buf == NULL || dir->fd < 0 || n < 0) {
+        _close_direct_file(dir);
+        return _attach_file(file, NULL, filename);
+    }
+    return _attach_io_file(file, &_direct_io_file, dir, filename, fmode);
+#else
+    return _attach_file(file, fopen(filename, fmode), filename);
+#endif
+}
+/* Open a file by (path, mode).
+ */
+PRS_EXPORT file_t *open_file(const char *filename, const char *mode)
+{
+    file_t *file;
+    char fmode[16];
+    if((file = _alloc_file(mode, fmode)) == NULL)
+        return NULL;
+    if(file->flags & FILE_FLAG_ZIP)
+        return _open_zip_file(file, filename, fmode);
+    if(file->flags & FILE_FLAG_DIRECT)
+        return _open_direct_file(file, filename, fmode);
+    return _attach_file(file, fopen(filename, fmode), filename);
+}
+/* Open a file over a descriptor; closing the file closes it.
+ */
+PRS_EXPORT file_t *open_fd_file(int fd, const char *mode)
+{
+    file_t *file;
+    char fmode[16], name[32];
+    FILE *fp;
+    if((file = _alloc_file(mode, fmode)) == NULL) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        close(fd);
+#endif
+        return NULL;
+    }
+    file->flags |= FILE_FLAG_ANON;
+    sprintf(name, "fd:%d", fd);
+#ifdef _WIN32
+    if((fp = _fdopen(fd, fmode)) == NULL)
+        _close(fd);
+#else
+    if((fp = fdopen(fd, fmode)) == NULL)
+        close(fd);
+#endif
+    return _attach_file(file, fp, name);
+}
+/* Open an anonymous file that lives in memory but still has a
+ * descriptor, so mapping and the kernel fast paths keep working.
+ */
+PRS_EXPORT file_t *open_memfd_file(const char *name, const char *mode)
+{
+    file_t *file;
+    char fmode[16];
+    FILE *fp = NULL;
+#if defined(__linux) && defined(MFD_CLOEXEC)
+    int fd;
+#endif
+    if((file = _alloc_file(mode, fmode)) == NULL)
+        return NULL;
+    file->flags |= FILE_FLAG_ANON;
+#if defined(__linux) && defined(MFD_CLOEXEC)
+    if((fd = memfd_create(name, MFD_CLOEXEC)) >= 0 &&
+            (fp = fdopen(fd, fmode)) == NULL)
+        close(fd);
+    if(fd < 0)
+#endif
+    fp = tmpfile();
+    return _attach_file(file, fp, name);
+}
+#ifdef FILE_HAVE_IO
+/* Open a growable in-memory file starting with a copy of data.
+ */
+PRS_EXPORT file_t *open_memory_file(const void *data, size_t len,
+    const char *mode)
+{
+    struct file_mem *mem;
+    mem = (struct file_mem*)malloc(sizeof(struct file_mem));
+    if(mem == NULL) {
+        _errno_file = FILE_ERROR_OPEN;
+        return NULL;
+    }
+    mem->len = (strchr(mode, 'w') != NULL || data == NULL) ? 0 : len;
+    mem->cap = mem->len;
+    mem->pos = 0;
+    mem->append = (strchr(mode, 'a') != NULL);
+    mem->data = NULL;
+    if(mem->len > 0) {
+        if((mem->data = (unsigned char*)malloc(mem->len)) == NULL) {
+            free(mem);
+            _errno_file = FILE_ERROR_OPEN;
+            return NULL;
+        }
+        memcpy(mem->data, data, mem->len);
+    }
+    if(mem->append)
+        mem->pos = mem->len;
+    return open_io_file(&_mem_io_file, mem, ":memory:", mode);
+}
+/* Open a file over a user backend, through a stdio stream made of it.
+ */
+PRS_EXPORT file_t *open_io_file(const file_io_t *io, void *ctx,
+    const char *name, const char *mode)
+{
+    file_t *file;
+    char fmode[16];
+    if((file = _alloc_file(mode, fmode)) == NULL) {
+        if(io->close != NULL)
+            io->close(ctx);
+        return NULL;
+    }
+    return _attach_io_file(file, io, ctx, name, fmode);
+}
+#endif
+/* Reopen file with different mode.
+ */
+PRS_EXPORT file_t *reopen_file(file_t *file, const char *mode)
+{
+    char fmode[16];
+    int flags;
+    if(file == NULL)
+        return NULL;
+    if(file->flags & FILE_FLAG_ANON) {
+        /* nothing to open again */
+        _errno_file = FILE_ERROR_OPEN;
+        return file;
+    }
+    if(file->flags & FILE_FLAG_RESERVE)
+        _release_file(file);
+    _flush_write_file(file);
+    _unmap_file(file);
+    file->buf.rpos = 0;
+    file->buf.rlen = 0;
+    flags = _parse_mode_file(mode, fmode);
+    if((file->fp = freopen(file->name, fmode, file->fp)) == NULL) {
+        _errno_file = FILE_ERROR_OPEN;
+	close_file(file);
+	return NULL;
+    }
+    file->flags = flags;
+    _reset_index_file(file);
+    _errno_file = FILE_ERROR_OKAY;
+    /* the new stream starts with a buffer of its own */
+    if(file->vset)
+        setvbuf(file->fp, file->vbuf, file->vbuf ? _IOFBF : _IONBF,
+            file->vsize);
+    if((file->flags & FILE_FLAG_MAP) && _map_file(file) < 0) {
+        _errno_file = FILE_ERROR_OPEN;
+        return file;
+    }
+    /* size and lines are worked out on first use */
+    return file;
+}
+/* Gets the error string associated with error code.
+ */
+PRS_EXPORT const char *strerror_file(int err)
+{
+    return _prs_file_errors[err];
+}
+/* Gets the error code from file.
+ */
+PRS_EXPORT int get_error_file(void)
+{
+    int error = _errno_file;
+    _errno_file = FILE_ERROR_OKAY;
+    return error;
+}
+/* Finishes the async requests of a file, see below.
+ */
+static void _settle_aio_file(file_t *file);
+/* Uninitialize the file structure; closing file.
+ */
+PRS_EXPORT void close_file(file_t *file)
+{
+    if(file->aio > 0)
+        _settle_aio_file(file);
+    _unmap_file(file);
+    _reset_index_file(file);
+    free(file->buf.rbuf);
+    if(file->fp != NULL) {
+        if(file->flags & FILE_FLAG_RESERVE)
+            _release_file(file);
+        _flush_write_file(file);
+        fclose(file->fp);
+    }
+    free(file->buf.wbuf);
+    free(file->vbuf);
+    memset(file->name, 0, MAX_PATH);
+    _errno_file = FILE_ERROR_OKAY;
+    free(file);
+}
+
+/* ------------------------- handling functions ------------------------ */
+
+/* Read file into buf; of size
+ */
+PRS_EXPORT size_t read_file(file_t *file, void *buf, size_t nmem,
+    size_t size)
+{
+    size_t count, ahead;
+    if(file->flags & FILE_FLAG_MAP) {
+        _fold_map_file(file);
+        count = 0;
+        if(nmem > 0 && file->map_pos < file->map_len)
+            count = (file->map_len - file->map_pos) / nmem;
+        if(count > size)
+            count = size;
+        if(count > 0) {
+            memcpy(buf, file->map + file->map_pos, count * nmem);
+            file->map_pos += count * nmem;
+        }
+        _crc_file(file, buf, count * nmem);
+        _utf8_file(file, buf, count * nmem);
+        return count;
+    }
+    if(_sync_read_file(file) < 0 && nmem > 0) {
+        /* the stream could not take the read-ahead back */
+        count = _get_ahead_file(file, buf, nmem*size, &ahead);
+        _crc_file(file, buf, count);
+        _utf8_file(file, (char*)buf + ahead, count - ahead);
+        return count / nmem;
+    }
+    if(file->io != NULL)
+        count = (nmem == 0) ? 0 : _get_raw_file(file, buf, nmem*size)/nmem;
+    else if((count = fread(buf, nmem, size, file->fp)) < size &&
+            ferror(file->fp))
+        _errno_file = FILE_ERROR_READ;
+    _crc_file(file, buf, count * nmem);
+    _utf8_file(file, buf, count * nmem);
+    return count;
+}
+/* Write into file from buf; of size
+ */
+PRS_EXPORT size_t write_file(file_t *file, const void *buf, size_t nmem,
+	size_t size)
+{
+    size_t count;
+    _sync_file(file);
+    _invalidate_file(file);
+    if(file->io != NULL)
+        count = (nmem == 0) ? 0 : _put_raw_file(file, buf, nmem*size)/nmem;
+    else if((count = fwrite(buf, nmem, size, file->fp)) < size)
+        _errno_file = FILE_ERROR_WRITE;
+    _crc_file(file, buf, count * nmem);
+    return count;
+}
+#ifndef _WIN32
+/* Move up to FILE_IOV_BATCH buffers of vec into iov, skipping done bytes
+ * of the first one; returns number of entries used.
+ */
+static int _fill_iov_file(struct iovec *iov, const file_vec_t *vec,
+    int count, size_t skip)
+{
+    int i;
+    for(i = 0; i < count && i < FILE_IOV_BATCH; i++) {
+        iov[i].iov_base = (char*)vec[i].buf + skip;
+        iov[i].iov_len = vec[i].len - skip;
+        skip = 0;
+    }
+    return i;
+}
+/* Do a whole vectored transfer at pos, carrying on after short ones;
+ * append mode writes ignore pos. Returns bytes moved.
+ */
+static size_t _xfer_vec_file(file_t *file, const file_vec_t *vec,
+    int count, file_off_t pos, int write)
+{
+    struct iovec iov[FILE_IOV_BATCH];
+    int fd = fileno(file->fp), n;
+    size_t skip = 0, total = 0;
+    ssize_t res;
+    while(count > 0) {
+        if(vec->len == skip) {
+            vec++;
+            count--;
+            skip = 0;
+            continue;
+        }
+        n = _fill_iov_file(iov, vec, count, skip);
+        if(write && (file->flags & FILE_FLAG_APPEND))
+            res = writev(fd, iov, n);
+        else if(write)
+            res = pwritev(fd, iov, n, (off_t)(pos + total));
+        else
+            res = preadv(fd, iov, n, (off_t)(pos + total));
+        if(res < 0 && errno == EINTR)
+            continue;
+        if(res < 0) {
+            _errno_file = write ? FILE_ERROR_WRITE : FILE_ERROR_READ;
+            break;
+        }
+        if(res == 0)
+            break;
+        total += (size_t)res;
+        /* step over the buffers that were finished */
+        for(skip += (size_t)res; count > 0 && skip >= vec->len; count--) {
+            skip -= vec->len;
+            vec++;
+        }
+    }
+    return total;
+}
+#endif
+/* Add the first len bytes of a vectored transfer to the checksum.
+ */
+static void _crc_vec_file(file_t *file, const file_vec_t *vec, size_t len)
+{
+    for(; file->crc_on && len > 0; vec++) {
+        size_t n = (vec->len < len) ? vec->len : len;
+        _crc_file(file, vec->buf, n);
+        len -= n;
+    }
+}
+/* Write count buffers with as few system calls as possible; returns the
+ * number of bytes written.
+ */
+PRS_EXPORT size_t writev_file(file_t *file, const file_vec_t *vec,
+    int count)
+{
+    file_off_t pos;
+    size_t total = 0;
+    int i;
+    _sync_file(file);
+    _invalidate_file(file);
+#ifndef _WIN32
+    pos = FILE_TELL(file->fp);
+    if(fflush(file->fp) == 0 && pos >= 0 &&
+            !(file->flags & FILE_FLAG_STREAM)) {
+        total = _xfer_vec_file(file, vec, count, pos, 1);
+        if(file->flags & FILE_FLAG_APPEND)
+            FILE_SEEK(file->fp, 0, SEEK_END);
+        else
+            FILE_SEEK(file->fp, pos + (file_off_t)total, SEEK_SET);
+        _crc_vec_file(file, vec, total);
+        return total;
+    }
+#endif
+    (void)pos;
+    for(i = 0; i < count; i++) {
+        size_t n = _put_raw_file(file, vec[i].buf, vec[i].len);
+        total += n;
+        if(n < vec[i].len)
+            break;
+    }
+    _crc_vec_file(file, vec, total);
+    return total;
+}
+/* Read into count buffers with as few system calls as possible; returns
+ * the number of bytes read.
+ */
+PRS_EXPORT size_t readv_file(file_t *file, const file_vec_t *vec,
+    int count)
+{
+    file_off_t pos;
+    size_t n, ahead, total = 0;
+    int i, kept;
+    if(file->flags & FILE_FLAG_MAP) {
+        _fold_map_file(file);
+        for(i = 0; i < count && file->map_pos < file->map_len; i++) {
+            n = file->map_len - file->map_pos;
+            if(n > vec[i].len)
+                n = vec[i].len;
+            memcpy(vec[i].buf, file->map + file->map_pos, n);
+            file->map_pos += n;
+            total += n;
+        }
+        _crc_vec_file(file, vec, total);
+        return total;
+    }
+    kept = (_sync_file(file) < 0);
+#ifndef _WIN32
+    if(file->flags & FILE_FLAG_WRITE)
+        fflush(file->fp);
+    if(!kept && (pos = FILE_TELL(file->fp)) >= 0 &&
+            !(file->flags & FILE_FLAG_STREAM)) {
+        total = _xfer_vec_file(file, vec, count, pos, 0);
+        FILE_SEEK(file->fp, pos + (file_off_t)total, SEEK_SET);
+        _crc_vec_file(file, vec, total);
+        return total;
+    }
+#endif
+    (void)pos;
+    for(i = 0; i < count; i++) {
+        n = _get_ahead_file(file, vec[i].buf, vec[i].len, &ahead);
+        total += n;
+        if(n < vec[i].len)
+            break;
+    }
+    _crc_vec_file(file, vec, total);
+    return total;
+}
+/* Read len bytes at offset without touching the file position; safe to
+ * call from several threads at once.
+ */
+PRS_EXPORT size_t read_at_file(file_t *file, void *buf, size_t len,
+    file_off_t offset)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    size_t total = 0;
+    file_off_t pos;
+#ifndef _WIN32
+    ssize_t n;
+#endif
+    if(offset < 0) {
+        _errno_file = FILE_ERROR_SEEK;
+        return 0;
+    }
+    if(file->flags & FILE_FLAG_MAP) {
+        if((file_off_t)file->map_len > offset) {
+            total = file->map_len - (size_t)offset;
+            if(total > len)
+                total = len;
+            memcpy(buf, file->map + offset, total);
+        }
+        return total;
+    }
+#ifndef _WIN32
+    if(!(file->flags & FILE_FLAG_STREAM)) {
+        while(total < len) {
+            n = pread(fileno(file->fp), (char*)buf + total, len - total,
+                (off_t)(offset + (file_off_t)total));
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n < 0)
+                _errno_file = FILE_ERROR_READ;
+            if(n <= 0)
+                break;
+            total += (size_t)n;
+        }
+        return total;
+    }
+#endif
+    /* no descriptor to read at an offset, go through the stream */
+    pthread_mutex_lock(&lock);
+    _sync_file(file);
+    pos = FILE_TELL(file->fp);
+    if(FILE_SEEK(file->fp, offset, SEEK_SET) == 0)
+        total = _get_raw_file(file, buf, len);
+    FILE_SEEK(file->fp, pos, SEEK_SET);
+    pthread_mutex_unlock(&lock);
+    return total;
+}
+/* Finds room in the write buffer, see the typed writers.
+ */
+static char *_reserve_write_file(file_t *file, size_t len);
+/* Write formatted into file
+ */
+PRS_EXPORT int writef_file(file_t *file, const char *buf, ...)
+{
+    int res;
+    va_list ap;
+    char *p;
+    if(file->io != NULL) {
+        /* into the write buffer, the stream of a backend has none */
+        va_start(ap, buf);
+        res = vsnprintf(NULL, 0, buf, ap);
+        va_end(ap);
+        if(res >= 0 && (size_t)res < FILE_WRITE_BUFSIZ &&
+                (p = _reserve_write_file(file, (size_t)res + 1)) != NULL) {
+            va_start(ap, buf);
+            vsnprintf(p, (size_t)res + 1, buf, ap);
+            va_end(ap);
+            file->buf.wlen += (size_t)res;
+            return res;
+        }
+    }
+    _sync_file(file);
+    _invalidate_file(file);
+    va_start(ap, buf);
+    res = vfprintf(file->fp, buf, ap);
+    va_end(ap);
+    if(res < 0)
+        _errno_file = FILE_ERROR_WRITE;
+    return res;
+}
+/* Write formatted into file; using va_list
+ */
+PRS_EXPORT int vwritef_file(file_t *file, const char *buf, va_list ap)
+{
+    _sync_file(file);
+    _invalidate_file(file);
+    return vfprintf(file->fp, buf, ap);
+}
+/* Read a line of text from file
+ */
+PRS_EXPORT char *gets_file(file_t *file, char *buf, long size)
+{
+    if(file->flags & FILE_FLAG_MAP) {
+        const unsigned char *end;
+        size_t len;
+        _fold_map_file(file);
+        if(size <= 0 || file->map_pos >= file->map_len)
+            return NULL;
+        len = file->map_len - file->map_pos;
+        if(len > (size_t)size - 1)
+            len = (size_t)size - 1;
+        end = memchr(file->map + file->map_pos, '\n', len);
+        if(end != NULL)
+            len = (size_t)(end - (file->map + file->map_pos)) + 1;
+        memcpy(buf, file->map + file->map_pos, len);
+        buf[len] = '\0';
+        file->map_pos += len;
+        _utf8_file(file, buf, len);
+        return buf;
+    }
+    if(file->io != NULL || _sync_file(file) < 0) {
+        /* through the read-ahead, the stream has no buffer or could
+         * not take the read-ahead back */
+        long n = 0;
+        int c = 0;
+        while(n < size - 1 && c != '\n' && (c = GETC_FILE(file)) != EOF)
+            buf[n++] = (char)c;
+        if(n == 0 || size <= 0)
+            return NULL;
+        buf[n] = '\0';
+        return buf;
+    }
+    if(fgets(buf, size, file->fp) == NULL)
+        return NULL;
+    _utf8_file(file, buf, strlen(buf));
+    return buf;
+}
+/* Get the next line, newline included, as a slice of the file's own
+ * buffer; the slice is valid until the next call on the file.
+ */
+PRS_EXPORT const char *next_line_file(file_t *file, size_t *len)
+{
+    const char *line, *end;
+    size_t from, n;
+    char *rbuf;
+    if(file->flags & FILE_FLAG_MAP) {
+        _fold_map_file(file);
+        if(file->map_pos >= file->map_len)
+            return NULL;
+        line = (const char*)file->map + file->map_pos;
+        end = memchr(line, '\n', file->map_len - file->map_pos);
+        *len = (end != NULL) ? (size_t)(end - line) + 1 :
+            file->map_len - file->map_pos;
+        file->map_pos += *len;
+        _utf8_file(file, line, *len);
+        return line;
+    }
+    /* typed output goes out first; it left no read-ahead behind */
+    if(file->buf.wlen > 0)
+        _sync_read_file(file);
+    for(from = file->buf.rpos;;) {
+        line = file->buf.rbuf + file->buf.rpos;
+        end = (from < file->buf.rlen) ?
+            memchr(file->buf.rbuf + from, '\n', file->buf.rlen - from) : NULL;
+        if(end != NULL) {
+            *len = (size_t)(end - line) + 1;
+            file->buf.rpos += *len;
+            return line;
+        }
+        /* keep the partial line, make room and refill */
+        if(file->buf.rpos > 0) {
+            memmove(file->buf.rbuf, line, file->buf.rlen - file->buf.rpos);
+            file->buf.rlen -= file->buf.rpos;
+            file->buf.rpos = 0;
+        }
+        from = file->buf.rlen;
+        if(file->buf.rlen == file->rcap) {
+            n = file->rcap ? file->rcap*2 : FILE_LINE_BUFSIZ;
+            if((rbuf = (char*)realloc(file->buf.rbuf, n)) == NULL) {
+                _errno_file = FILE_ERROR_READ;
+                return NULL;
+            }
+            file->buf.rbuf = rbuf;
+            file->rcap = n;
+        }
+        n = _get_raw_file(file, file->buf.rbuf + file->buf.rlen,
+            file->rcap - file->buf.rlen);
+        if(n == 0) {
+            if(file->buf.rlen == 0)
+                return NULL;
+            /* last line without a newline */
+            *len = file->buf.rlen;
+            file->buf.rpos = file->buf.rlen;
+            return file->buf.rbuf;
+        }
+        _utf8_file(file, file->buf.rbuf + file->buf.rlen, n);
+        file->buf.rlen += n;
+    }
+}
+/* Put a line of text to file
+ */
+PRS_EXPORT int puts_file(file_t *file, const char *buf)
+{
+    _sync_file(file);
+    _invalidate_file(file);
+    return fputs(buf, file->fp);
+}
+/* Read formatted from file
+ */
+PRS_EXPORT int readf_file(file_t *file, const char *buf, ...)
+{
+    int res;
+    va_list ap;
+    if(file->flags & FILE_FLAG_MAP) {
+        _sync_map_file(file);
+    } else if(_sync_file(file) < 0) {
+        /* scanf cannot see the read-ahead, leave it to be read */
+        _errno_file = FILE_ERROR_READ;
+        return EOF;
+    }
+    va_start(ap, buf);
+    res = vfscanf(file->fp, buf, ap);
+    va_end(ap);
+    if(file->flags & FILE_FLAG_MAP)
+        file->map_pos = (size_t)FILE_TELL(file->fp);
+    else if(file->io != NULL)
+        FILE_SEEK(file->fp, 0, SEEK_CUR);  /* give back what it pushed */
+    if(res < 0)
+        _errno_file = FILE_ERROR_READ;
+    return res;
+}
+/* Gets one byte from the file
+ */
+PRS_EXPORT int getc_file(file_t *file)
+{
+    return GETC_FILE(file);
+}
+/* Refill the read-ahead buffer for GETC_FILE(); returns the next byte.
+ */
+PRS_EXPORT int fill_getc_file(file_t *file)
+{
+    size_t n;
+    if(file->flags & FILE_FLAG_MAP) {
+        /* the view is lent as the buffer, checked as text in one go */
+        _fold_map_file(file);
+        if(file->map_pos >= file->map_len)
+            return EOF;
+        free(file->buf.rbuf);
+        file->rcap = 0;
+        n = file->map_len - file->map_pos;
+        if(file->utf8_on && n > FILE_LINE_BUFSIZ)
+            n = FILE_LINE_BUFSIZ;   /* bad text is found near the reader */
+        file->buf.rbuf = (char*)file->map + file->map_pos;
+        file->buf.rlen = n;
+        file->buf.rpos = 1;
+        file->map_win = 1;
+        _utf8_file(file, file->buf.rbuf, n);
+        return (unsigned char)file->buf.rbuf[0];
+    }
+    _sync_read_file(file);
+    if(file->buf.rbuf == NULL) {
+        if((file->buf.rbuf = (char*)malloc(FILE_LINE_BUFSIZ)) == NULL) {
+            _errno_file = FILE_ERROR_READ;
+            return EOF;
+        }
+        file->rcap = FILE_LINE_BUFSIZ;
+    }
+    if((n = _get_raw_file(file, file->buf.rbuf, file->rcap)) == 0)
+        return EOF;
+    _utf8_file(file, file->buf.rbuf, n);
+    file->buf.rlen = n;
+    file->buf.rpos = 1;
+    return (unsigned char)file->buf.rbuf[0];
+}
+/* Puts one byte into the file.
+ */
+PRS_EXPORT void putc_file(file_t *file, int c)
+{
+    PUTC_FILE(file, c);
+}
+/* Put c in front of the read-ahead of file.
+ */
+static int _push_back_file(file_t *file, int c)
+{
+    char *rbuf;
+    size_t n;
+    if(file->buf.wlen > 0)
+        _sync_file(file);
+    if(file->buf.rpos == 0) {
+        if(file->buf.rlen == file->rcap) {
+            n = file->rcap ? file->rcap*2 : FILE_LINE_BUFSIZ;
+            if((rbuf = (char*)realloc(file->buf.rbuf, n)) == NULL)
+                return -1;
+            file->buf.rbuf = rbuf;
+            file->rcap = n;
+        }
+        memmove(file->buf.rbuf + 1, file->buf.rbuf, file->buf.rlen);
+        file->buf.rlen++;
+        file->buf.rpos++;
+    }
+    file->buf.rbuf[--file->buf.rpos] = (char)c;
+    return 0;
+}
+/* Puts one byte back onto file stream.
+ */
+PRS_EXPORT void ungetc_file(file_t *file, int c)
+{
+    if(file->buf.rpos > 0 && c != EOF &&
+            file->buf.rbuf[file->buf.rpos-1] == (char)c) {
+        file->buf.rpos--;
+        return;
+    }
+    if(file->flags & FILE_FLAG_MAP) {
+        _fold_map_file(file);
+        if(c == EOF || file->map_pos == 0 ||
+                file->map[file->map_pos-1] != (unsigned char)c)
+            _errno_file = FILE_ERROR_WRITE;
+        else
+            file->map_pos--;
+        return;
+    }
+    if(file->io != NULL || _sync_file(file) < 0) {
+        /* kept in the read-ahead, the stream never sees it */
+        if(c == EOF || _push_back_file(file, c) < 0)
+            _errno_file = FILE_ERROR_WRITE;
+        return;
+    }
+    errno = 0;
+    ungetc(c, file->fp);
+    if(errno != 0)
+        _errno_file = FILE_ERROR_WRITE;
+}
+/* Seek through file by bytes.
+ */
+PRS_EXPORT int seek_file(file_t *file, long bytes, int seek)
+{
+    return seek64_file(file, (file_off_t)bytes, seek);
+}
+/* Seek through file by bytes; 64-bit offset.
+ */
+PRS_EXPORT int seek64_file(file_t *file, file_off_t bytes, int seek)
+{
+    int res;
+    if(file->flags & FILE_FLAG_MAP) {
+        file_off_t base = 0;
+        _fold_map_file(file);
+        if(seek == SEEK_CUR)
+            base = (file_off_t)file->map_pos;
+        else if(seek == SEEK_END)
+            base = (file_off_t)file->map_len;
+        if(base + bytes < 0) {
+            _errno_file = FILE_ERROR_SEEK;
+            return -1;
+        }
+        file->map_pos = (size_t)(base + bytes);
+        return 0;
+    }
+    if(_sync_file(file) < 0) {
+        _errno_file = FILE_ERROR_SEEK;
+        return -1;
+    }
+    errno = 0;
+    res = FILE_SEEK(file->fp, bytes, seek);
+    if(errno != 0)
+        _errno_file = FILE_ERROR_SEEK;
+    return res;
+}
+/* Rewind file back to start.
+ */
+PRS_EXPORT void rewind_file(file_t *file)
+{
+    if(file->flags & FILE_FLAG_MAP) {
+        _fold_map_file(file);
+        file->map_pos = 0;
+        return;
+    }
+    _flush_write_file(file);
+    file->buf.rpos = 0;
+    file->buf.rlen = 0;
+    rewind(file->fp);
+}
+/* Tell size of file; returns size in bytes.
+ */
+PRS_EXPORT long tell_file(file_t *file)
+{
+    file_off_t pos = tell64_file(file);
+    if(pos > LONG_MAX) {
+        _errno_file = FILE_ERROR_TELL;
+        return -1;
+    }
+    return (long)pos;
+}
+/* Tell position in file; 64-bit offset.
+ */
+PRS_EXPORT file_off_t tell64_file(file_t *file)
+{
+    file_off_t pos;
+    if(file->flags & FILE_FLAG_MAP) {
+        _fold_map_file(file);
+        return (file_off_t)file->map_pos;
+    }
+    if(_sync_file(file) < 0) {
+        /* the read-ahead stays, the stream is past it */
+        errno = 0;
+        pos = FILE_TELL(file->fp);
+        if(errno != 0 || pos < 0) {
+            _errno_file = FILE_ERROR_TELL;
+            return -1;
+        }
+        return pos - (file_off_t)(file->buf.rlen - file->buf.rpos);
+    }
+    errno = 0;
+    pos = FILE_TELL(file->fp);
+    if(errno != 0)
+        _errno_file = FILE_ERROR_TELL;
+    return pos;
+}
+/* Flush the file stream.
+ */
+PRS_EXPORT int flush_file(file_t *file)
+{
+    _sync_file(file);
+    return fflush(file->fp);
+}
+#ifndef _WIN32
+/* Pass a hint about part of the mapped view on to madvise().
+ */
+static int _advise_map_file(file_t *file, file_off_t offset,
+    file_off_t len, int pattern)
+{
+    static const int advice[] = {
+        MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED,
+        MADV_DONTNEED
+    };
+    size_t page = (size_t)sysconf(_SC_PAGESIZE), start, end;
+    if(file->map == NULL || (file->flags & FILE_FLAG_OWNED) ||
+            offset >= (file_off_t)file->map_len)
+        return 0;
+    start = (size_t)offset & ~(page - 1);
+    end = (len == 0 || len > (file_off_t)file->map_len - offset) ?
+        file->map_len : (size_t)(offset + len);
+    return madvise(file->map + start, end - start, advice[pattern]);
+}
+#endif
+/* Tell the kernel how a range of the file is going to be used.
+ */
+PRS_EXPORT int advise_file(file_t *file, file_off_t offset, file_off_t len,
+    int pattern)
+{
+#if !defined(_WIN32) && defined(POSIX_FADV_NORMAL)
+    static const int advice[] = {
+        POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM,
+        POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED
+    };
+    int err;
+#endif
+    if(offset < 0 || len < 0 || pattern < FILE_ADVISE_NORMAL ||
+            pattern > FILE_ADVISE_DONTNEED) {
+        errno = EINVAL;
+        return -1;
+    }
+#ifndef _WIN32
+    if((file->flags & FILE_FLAG_MAP) &&
+            _advise_map_file(file, offset, len, pattern) < 0)
+        return -1;
+    if(file->flags & FILE_FLAG_STREAM)
+        return 0;
+    /* dirty pages stay cached until they are written back */
+    if(pattern == FILE_ADVISE_DONTNEED && (file->flags & FILE_FLAG_WRITE)) {
+        _sync_file(file);
+        if(fflush(file->fp) != 0 || fsync(fileno(file->fp)) < 0)
+            return -1;
+    }
+#ifdef POSIX_FADV_NORMAL
+    err = posix_fadvise(fileno(file->fp), (off_t)offset, (off_t)len,
+        advice[pattern]);
+    /* pipes and the like have no cache to advise */
+    if(err != 0 && err != ESPIPE) {
+        errno = err;
+        return -1;
+    }
+#endif
+#endif
+    return 0;
+}
+/* Give the stream a buffer of its own, before it is first used.
+ */
+PRS_EXPORT int set_buffer_file(file_t *file, size_t size)
+{
+    char *buf = NULL;
+    /* streams made of a backend are only buffered by the file itself */
+    if(file->fp == NULL || file->io != NULL || (size > 0 &&
+            (buf = (char*)malloc(size)) == NULL))
+        return -1;
+    if(setvbuf(file->fp, buf, buf ? _IOFBF : _IONBF, size) != 0) {
+        free(buf);
+        return -1;
+    }
+    free(file->vbuf);
+    file->vbuf = buf;
+    file->vsize = size;
+    file->vset = 1;
+    return 0;
+}
+/* Allocate a buffer fit for direct I/O, size is rounded up to blocks.
+ */
+PRS_EXPORT void *alloc_direct_file(size_t size)
+{
+    void *ptr = NULL;
+    size = (size + FILE_DIRECT_ALIGN - 1) & ~(size_t)(FILE_DIRECT_ALIGN - 1);
+#ifdef _WIN32
+    ptr = _aligned_malloc(size, FILE_DIRECT_ALIGN);
+#else
+    if(posix_memalign(&ptr, FILE_DIRECT_ALIGN, size) != 0)
+        ptr = NULL;
+#endif
+    return ptr;
+}
+/* Free a buffer from alloc_direct_file().
+ */
+PRS_EXPORT void free_direct_file(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+/* ------------------------- formatting functions ---------------------- */
+
+/* Pairs of decimal digits, for two digits per division.
+ */
+static const char _digits_file[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+/* Cached powers of ten 10^k, k = -348 + 8*i, as 64-bit fractions times
+ * a power of two; used by the Grisu2 digit generator.
+ */
+static const unsigned long long _pow10_f_file[] = {
+    0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+    0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+    0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+    0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+    0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+    0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+    0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+    0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+    0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+    0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+    0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+    0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+    0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+    0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+    0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+    0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+    0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+    0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+    0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+    0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+    0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+    0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+    0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+    0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+    0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+    0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+    0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+    0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+    0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL,
+};
+static const short _pow10_e_file[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+static const unsigned long long _pow10_file[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+/* Floating point number as f * 2^e.
+ */
+struct file_fp {
+    unsigned long long f;
+    int e;
+};
+
+/* Format an unsigned integer; returns length.
+ */
+static size_t _format_u64_file(char *out, unsigned long long v)
+{
+    char tmp[20], *p = tmp + sizeof(tmp);
+    size_t len;
+    while(v >= 100) {
+        p -= 2;
+        memcpy(p, _digits_file + (v % 100) * 2, 2);
+        v /= 100;
+    }
+    if(v >= 10) {
+        p -= 2;
+        memcpy(p, _digits_file + v * 2, 2);
+    } else {
+        *--p = (char)('0' + v);
+    }
+    len = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(out, p, len);
+    return len;
+}
+/* Format a signed integer; returns length.
+ */
+static size_t _format_i64_file(char *out, long long v)
+{
+    if(v < 0) {
+        *out = '-';
+        return _format_u64_file(out + 1, 0 - (unsigned long long)v) + 1;
+    }
+    return _format_u64_file(out, (unsigned long long)v);
+}
+/* Multiply two fractions, keeping the rounded upper 64 bits.
+ */
+static struct file_fp _mul_fp_file(struct file_fp x, struct file_fp y)
+{
+    const unsigned long long m32 = 0xFFFFFFFFULL;
+    unsigned long long a = x.f >> 32, b = x.f & m32;
+    unsigned long long c = y.f >> 32, d = y.f & m32;
+    unsigned long long ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    unsigned long long tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    struct file_fp r;
+    tmp += 1ULL << 31;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+/* Move the last digit towards the exact value while it stays inside
+ * the rounding interval.
+ */
+static void _round_grisu_file(char *buf, int len, unsigned long long delta,
+    unsigned long long rest, unsigned long long ten_kappa,
+    unsigned long long wp_w)
+{
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+            (rest + ten_kappa < wp_w ||
+            wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+/* Generate the shortest digits of a positive double into buf; returns
+ * their count and sets *k so that the value is digits * 10^k.
+ */
+static int _grisu_file(double value, char *buf, int *k)
+{
+    static const unsigned long long hidden = 0x0010000000000000ULL;
+    struct file_fp v, w, wp, wm, c, one;
+    unsigned long long bits, p2, delta, wp_w, tmp;
+    unsigned int p1, d;
+    int kappa, len = 0, index;
+    double dk;
+
+    memcpy(&bits, &value, sizeof(bits));
+    v.f = bits & (hidden - 1);
+    v.e = (int)((bits >> 52) & 0x7FF);
+    if(v.e != 0) {
+        v.f += hidden;
+        v.e -= 0x3FF + 52;
+    } else {
+        v.e = 1 - (0x3FF + 52);
+    }
+    /* boundaries halfway to the neighbouring doubles */
+    wp.f = (v.f << 1) + 1;
+    wp.e = v.e - 1;
+    while(!(wp.f & (hidden << 1))) {
+        wp.f <<= 1;
+        wp.e--;
+    }
+    wp.f <<= 10;
+    wp.e -= 10;
+    if(v.f == hidden) {
+        wm.f = (v.f << 2) - 1;
+        wm.e = v.e - 2;
+    } else {
+        wm.f = (v.f << 1) - 1;
+        wm.e = v.e - 1;
+    }
+    wm.f <<= wm.e - wp.e;
+    wm.e = wp.e;
+    w = v;
+    while(!(w.f & 0x8000000000000000ULL)) {
+        w.f <<= 1;
+        w.e--;
+    }
+    /* scale by a cached power of ten into the range of 64-bit digits */
+    dk = (-61 - wp.e) * 0.30102999566398114 + 347;
+    index = (int)dk;
+    if(dk - index > 0.0)
+        index++;
+    index = (index >> 3) + 1;
+    *k = -(-348 + index * 8);
+    c.f = _pow10_f_file[index];
+    c.e = _pow10_e_file[index];
+    w = _mul_fp_file(w, c);
+    wp = _mul_fp_file(wp, c);
+    wm = _mul_fp_file(wm, c);
+    wm.f++;
+    wp.f--;
+    delta = wp.f - wm.f;
+    /* integral digits first, then fractional ones */
+    one.f = 1ULL << -wp.e;
+    one.e = wp.e;
+    wp_w = wp.f - w.f;
+    p1 = (unsigned int)(wp.f >> -one.e);
+    p2 = wp.f & (one.f - 1);
+    for(kappa = 1; kappa < 10 && p1 >= _pow10_file[kappa]; kappa++)
+        ;
+    while(kappa > 0) {
+        d = (unsigned int)(p1 / _pow10_file[kappa - 1]);
+        p1 %= (unsigned int)_pow10_file[kappa - 1];
+        if(d || len)
+            buf[len++] = (char)('0' + d);
+        kappa--;
+        tmp = ((unsigned long long)p1 << -one.e) + p2;
+        if(tmp <= delta) {
+            *k += kappa;
+            _round_grisu_file(buf, len, delta, tmp,
+                _pow10_file[kappa] << -one.e, wp_w);
+            return len;
+        }
+    }
+    for(;;) {
+        p2 *= 10;
+        delta *= 10;
+        d = (unsigned int)(p2 >> -one.e);
+        if(d || len)
+            buf[len++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if(p2 < delta) {
+            *k += kappa;
+            _round_grisu_file(buf, len, delta, p2, one.f,
+                wp_w * (-kappa < 20 ? _pow10_file[-kappa] : 0));
+            return len;
+        }
+    }
+}
+/* Format a double with the fewest digits that read back the same;
+ * returns length.
+ */
+static size_t _format_f64_file(char *out, double value)
+{
+    unsigned long long bits;
+    char *p = out;
+    int len, k, kk, i;
+
+    memcpy(&bits, &value, sizeof(bits));
+    if(bits >> 63) {
+        *p++ = '-';
+        bits &= ~(1ULL << 63);
+    }
+    if((bits >> 52) == 0x7FF) {
+        if(bits << 12) {
+            memcpy(out, "nan", 3);
+            return 3;
+        }
+        memcpy(p, "inf", 3);
+        return (size_t)(p - out) + 3;
+    }
+    if(bits == 0) {
+        *p = '0';
+        return (size_t)(p - out) + 1;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    len = _grisu_file(value, p, &k);
+    kk = len + k;                   /* 10^(kk-1) <= value < 10^kk */
+    if(k >= 0 && kk <= 17) {
+        /* 1234e3 -> 1234000 */
+        for(i = len; i < kk; i++)
+            p[i] = '0';
+        return (size_t)(p - out + kk);
+    } else if(kk > 0 && kk <= 17) {
+        /* 1234e-2 -> 12.34 */
+        memmove(p + kk + 1, p + kk, (size_t)(len - kk));
+        p[kk] = '.';
+        return (size_t)(p - out + len + 1);
+    } else if(kk > -4 && kk <= 0) {
+        /* 1234e-6 -> 0.001234 */
+        memmove(p + 2 - kk, p, (size_t)len);
+        p[0] = '0';
+        p[1] = '.';
+        for(i = 2; i < 2 - kk; i++)
+            p[i] = '0';
+        return (size_t)(p - out + len + 2 - kk);
+    }
+    /* 1234e30 -> 1.234e33 */
+    if(len > 1) {
+        memmove(p + 2, p + 1, (size_t)(len - 1));
+        p[1] = '.';
+        len++;
+    }
+    p += len;
+    *p++ = 'e';
+    if(--kk < 0) {
+        *p++ = '-';
+        kk = -kk;
+    }
+    return (size_t)(p - out) + _format_u64_file(p, (unsigned long long)kk);
+}
+/* Make room for len bytes of typed output; returns where they go.
+ */
+static char *_reserve_write_file(file_t *file, size_t len)
+{
+    if(file->buf.wlen == 0) {
+        _sync_file(file);
+        _invalidate_file(file);
+        if(file->buf.wbuf == NULL &&
+                (file->buf.wbuf = (char*)malloc(FILE_WRITE_BUFSIZ)) == NULL) {
+            _errno_file = FILE_ERROR_WRITE;
+            return NULL;
+        }
+    } else if(FILE_WRITE_BUFSIZ - file->buf.wlen < len &&
+            _flush_write_file(file) < 0) {
+        return NULL;
+    }
+    file->buf.wcap = FILE_WRITE_BUFSIZ;
+    return file->buf.wbuf + file->buf.wlen;
+}
+/* Make room in the write buffer for PUTC_FILE(); returns c or EOF.
+ */
+PRS_EXPORT int flush_putc_file(file_t *file, int c)
+{
+    char *p;
+    if((p = _reserve_write_file(file, 1)) == NULL)
+        return EOF;
+    *p = (char)c;
+    file->buf.wlen++;
+    return (unsigned char)c;
+}
+/* Write an integer as decimal text.
+ */
+PRS_EXPORT int write_i64_file(file_t *file, long long value)
+{
+    char *p;
+    size_t len;
+    if((p = _reserve_write_file(file, FILE_NUMBER_LEN)) == NULL)
+        return -1;
+    len = _format_i64_file(p, value);
+    file->buf.wlen += len;
+    return (int)len;
+}
+/* Write a double as the shortest text that reads back the same value.
+ */
+PRS_EXPORT int write_f64_file(file_t *file, double value)
+{
+    char *p;
+    size_t len;
+    if((p = _reserve_write_file(file, FILE_NUMBER_LEN)) == NULL)
+        return -1;
+    len = _format_f64_file(p, value);
+    file->buf.wlen += len;
+    return (int)len;
+}
+/* Write a string; long strings bypass the buffer.
+ */
+PRS_EXPORT int write_str_file(file_t *file, const char *str)
+{
+    size_t len = strlen(str);
+    char *p;
+    if(len > FILE_WRITE_BUFSIZ) {
+        _sync_file(file);
+        _invalidate_file(file);
+        _crc_file(file, str, len);
+        if(_put_raw_file(file, str, len) != len)
+            return -1;
+        return (int)len;
+    }
+    if((p = _reserve_write_file(file, len)) == NULL)
+        return -1;
+    memcpy(p, str, len);
+    file->buf.wlen += len;
+    return (int)len;
+}
+
+/* ---------------------------- async functions ------------------------ */
+
+/* Queue a finished request for reap_file().
+ */
+static void _done_aio_file(struct file_aio *req)
+{
+    req->next = NULL;
+    if(_aio_file.done_tail != NULL)
+        _aio_file.done_tail->next = req;
+    else
+        _aio_file.done = req;
+    _aio_file.done_tail = req;
+}
+/* Take the whole done list.
+ */
+static struct file_aio *_take_aio_file(void)
+{
+    struct file_aio *list = _aio_file.done;
+    _aio_file.done = NULL;
+    _aio_file.done_tail = NULL;
+    return list;
+}
+#ifdef HAVE_IO_URING
+/* Set up an io_uring instance; returns -1 when the kernel says no.
+ */
+static int _setup_ring_aio_file(void)
+{
+    struct io_uring_params p;
+    int fd;
+    memset(&p, 0, sizeof(p));
+    fd = (int)syscall(__NR_io_uring_setup, FILE_AIO_DEPTH, &p);
+    if(fd < 0)
+        return -1;
+    _aio_file.sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+    _aio_file.cq_size = p.cq_off.cqes +
+        p.cq_entries*sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        if(_aio_file.cq_size > _aio_file.sq_size)
+            _aio_file.sq_size = _aio_file.cq_size;
+        _aio_file.cq_size = 0;
+    }
+    _aio_file.sq_ptr = mmap(NULL, _aio_file.sq_size, PROT_READ|PROT_WRITE,
+        MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(_aio_file.sq_ptr == MAP_FAILED)
+        goto error;
+    _aio_file.cq_ptr = _aio_file.sq_ptr;
+    if(_aio_file.cq_size > 0) {
+        _aio_file.cq_ptr = mmap(NULL, _aio_file.cq_size,
+            PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd,
+            IORING_OFF_CQ_RING);
+        if(_aio_file.cq_ptr == MAP_FAILED)
+            goto error_sq;
+    }
+    _aio_file.sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+    _aio_file.sqes = mmap(NULL, _aio_file.sqes_size, PROT_READ|PROT_WRITE,
+        MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(_aio_file.sqes == MAP_FAILED)
+        goto error_cq;
+    _aio_file.sq_tail = (unsigned int*)(_aio_file.sq_ptr + p.sq_off.tail);
+    _aio_file.sq_mask = (unsigned int*)(_aio_file.sq_ptr +
+        p.sq_off.ring_mask);
+    _aio_file.sq_array = (unsigned int*)(_aio_file.sq_ptr + p.sq_off.array);
+    _aio_file.cq_head = (unsigned int*)(_aio_file.cq_ptr + p.cq_off.head);
+    _aio_file.cq_tail = (unsigned int*)(_aio_file.cq_ptr + p.cq_off.tail);
+    _aio_file.cq_mask = (unsigned int*)(_aio_file.cq_ptr +
+        p.cq_off.ring_mask);
+    _aio_file.cqes = (struct io_uring_cqe*)(_aio_file.cq_ptr +
+        p.cq_off.cqes);
+    /* never more in flight than the completion ring can hold */
+    _aio_file.ring_depth = p.sq_entries < p.cq_entries ?
+        p.sq_entries : p.cq_entries;
+    _aio_file.ring = fd;
+    return 0;
+
+error_cq:
+    if(_aio_file.cq_size > 0)
+        munmap(_aio_file.cq_ptr, _aio_file.cq_size);
+error_sq:
+    munmap(_aio_file.sq_ptr, _aio_file.sq_size);
+error:
+    close(fd);
+    return -1;
+}
+/* Tell the kernel about requests put in the ring, waiting for one to
+ * finish if asked; returns -1 if it refused for now.
+ */
+static int _kick_ring_aio_file(int wait)
+{
+    long n;
+    if(!wait && _aio_file.unsubmitted == 0)
+        return 0;
+    for(;;) {
+        n = syscall(__NR_io_uring_enter, _aio_file.ring,
+            _aio_file.unsubmitted, wait ? 1 : 0,
+            wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if(n >= 0) {
+            _aio_file.unsubmitted -= (unsigned int)n;
+            return 0;
+        }
+        if(errno != EINTR)
+            return -1;
+    }
+}
+/* Hand one request to the kernel. Once in the ring it belongs to the
+ * kernel until its completion is reaped, even if telling it failed;
+ * the next call tells it again.
+ */
+static void _enter_ring_aio_file(struct file_aio *req)
+{
+    struct io_uring_sqe *sqe;
+    unsigned int tail, idx;
+    tail = *_aio_file.sq_tail;
+    idx = tail & *_aio_file.sq_mask;
+    sqe = &_aio_file.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fileno(req->file->fp);
+    sqe->addr = (unsigned long)&req->iov;
+    sqe->len = 1;
+    sqe->off = (unsigned long long)req->offset;
+    sqe->user_data = (unsigned long)req;
+    _aio_file.sq_array[idx] = idx;
+    __atomic_store_n(_aio_file.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    _aio_file.inflight++;
+    _aio_file.unsubmitted++;
+    _kick_ring_aio_file(0);
+}
+/* Move finished requests from the completion ring to the done list.
+ */
+static void _drain_ring_aio_file(int wait)
+{
+    struct file_aio *req;
+    unsigned int head, tail;
+    head = *_aio_file.cq_head;
+    tail = __atomic_load_n(_aio_file.cq_tail, __ATOMIC_ACQUIRE);
+    if(head == tail && wait && _aio_file.inflight > 0) {
+        _kick_ring_aio_file(1);
+        tail = __atomic_load_n(_aio_file.cq_tail, __ATOMIC_ACQUIRE);
+    } else {
+        _kick_ring_aio_file(0);
+    }
+    for(; head != tail; head++) {
+        struct io_uring_cqe *cqe = &_aio_file.cqes[head & *_aio_file.cq_mask];
+        req = (struct file_aio*)(unsigned long)cqe->user_data;
+        req->res = cqe->res;
+        _aio_file.inflight--;
+        _done_aio_file(req);
+    }
+    __atomic_store_n(_aio_file.cq_head, head, __ATOMIC_RELEASE);
+    /* room was made, start requests that were waiting */
+    while(_aio_file.pending != NULL &&
+            _aio_file.inflight < _aio_file.ring_depth) {
+        req = _aio_file.pending;
+        if((_aio_file.pending = req->next) == NULL)
+            _aio_file.pending_tail = NULL;
+        _enter_ring_aio_file(req);
+    }
+}
+#endif
+#ifndef _WIN32
+/* Worker side of the thread pool fallback, one positional transfer.
+ */
+static void _work_aio_file(void *arg)
+{
+    struct file_aio *req = (struct file_aio*)arg;
+    int fd = fileno(req->file->fp);
+    ssize_t n = 0;
+    size_t got = 0;
+    while(got < req->len) {
+        if(req->write)
+            n = pwrite(fd, (char*)req->buf + got, req->len - got,
+                (off_t)req->offset + (off_t)got);
+        else
+            n = pread(fd, (char*)req->buf + got, req->len - got,
+                (off_t)req->offset + (off_t)got);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    req->res = (n < 0 && got == 0) ? -errno : (file_off_t)got;
+    pthread_mutex_lock(&_aio_file.lock);
+    _aio_file.inflight--;
+    _done_aio_file(req);
+    pthread_cond_signal(&_aio_file.cond);
+    pthread_mutex_unlock(&_aio_file.lock);
+}
+#endif
+/* Tear down the asynchronous state at exit.
+ */
+static void _exit_aio_file(void)
+{
+    struct file_aio *req;
+#ifndef _WIN32
+    destroy_tpool(&_aio_file.pool);
+#endif
+#ifdef HAVE_IO_URING
+    if(_aio_file.ring >= 0) {
+        munmap(_aio_file.sqes, _aio_file.sqes_size);
+        if(_aio_file.cq_size > 0)
+            munmap(_aio_file.cq_ptr, _aio_file.cq_size);
+        munmap(_aio_file.sq_ptr, _aio_file.sq_size);
+        close(_aio_file.ring);
+    }
+#endif
+    while((req = _aio_file.pending) != NULL) {
+        _aio_file.pending = req->next;
+        free(req);
+    }
+    while((req = _aio_file.done) != NULL) {
+        _aio_file.done = req->next;
+        free(req);
+    }
+}
+/* Lock the done list against pool workers, if there are any.
+ */
+static void _lock_aio_file(void)
+{
+#ifndef _WIN32
+    if(_aio_file.pool != NULL)
+        pthread_mutex_lock(&_aio_file.lock);
+#endif
+}
+/* Unlock the done list.
+ */
+static void _unlock_aio_file(void)
+{
+#ifndef _WIN32
+    if(_aio_file.pool != NULL)
+        pthread_mutex_unlock(&_aio_file.lock);
+#endif
+}
+/* Pick io_uring or the thread pool on first use.
+ */
+static int _init_aio_file(void)
+{
+    if(_aio_file.init)
+        return 0;
+#ifdef HAVE_IO_URING
+    _aio_file.ring = -1;
+    if(_setup_ring_aio_file() < 0)
+#endif
+#ifndef _WIN32
+    {
+        if((_aio_file.pool = create_tpool(0)) == NULL)
+            return -1;
+        pthread_mutex_init(&_aio_file.lock, NULL);
+        pthread_cond_init(&_aio_file.cond, NULL);
+    }
+#endif
+    _aio_file.init = 1;
+    atexit(_exit_aio_file);
+    return 0;
+}
+/* Start a request on the ring or the pool; runs it in place on windows.
+ */
+static int _submit_aio_file(file_t *file, void *buf, size_t len,
+    file_off_t offset, int write, file_done_t done, void *data)
+{
+    struct file_aio *req;
+    if(file->fp == NULL || offset < 0 || _init_aio_file() < 0) {
+        _errno_file = write ? FILE_ERROR_WRITE : FILE_ERROR_READ;
+        return -1;
+    }
+    req = (struct file_aio*)malloc(sizeof(struct file_aio));
+    if(req == NULL) {
+        _errno_file = write ? FILE_ERROR_WRITE : FILE_ERROR_READ;
+        return -1;
+    }
+    req->next = NULL;
+    req->file = file;
+    req->buf = buf;
+    req->len = len;
+    req->offset = offset;
+    req->res = 0;
+    req->write = write;
+    req->done = done;
+    req->data = data;
+    file->aio++;
+    /* requests go straight to the descriptor, so push out stdio first */
+    _sync_file(file);
+    if(file->flags & FILE_FLAG_WRITE)
+        fflush(file->fp);
+    if(write)
+        _truncate_index_file(file, offset);
+#ifndef _WIN32
+    if(file->flags & FILE_FLAG_STREAM)
+#endif
+    {
+        /* no descriptor, done right away through the stream */
+        if(FILE_SEEK(file->fp, offset, SEEK_SET) != 0)
+            req->res = -1;
+        else if(write)
+            req->res = (file_off_t)_put_raw_file(file, buf, len);
+        else
+            req->res = (file_off_t)_get_raw_file(file, buf, len);
+        _lock_aio_file();
+        _done_aio_file(req);
+        _unlock_aio_file();
+        return 0;
+    }
+#ifndef _WIN32
+    req->iov.iov_base = buf;
+    req->iov.iov_len = len;
+#ifdef HAVE_IO_URING
+    if(_aio_file.ring >= 0) {
+        if(_aio_file.inflight >= _aio_file.ring_depth) {
+            if(_aio_file.pending_tail != NULL)
+                _aio_file.pending_tail->next = req;
+            else
+                _aio_file.pending = req;
+            _aio_file.pending_tail = req;
+        } else {
+            _enter_ring_aio_file(req);
+        }
+        return 0;
+    }
+#endif
+    pthread_mutex_lock(&_aio_file.lock);
+    _aio_file.inflight++;
+    pthread_mutex_unlock(&_aio_file.lock);
+    if(add_tpool(_aio_file.pool, _work_aio_file, req) < 0) {
+        pthread_mutex_lock(&_aio_file.lock);
+        _aio_file.inflight--;
+        pthread_mutex_unlock(&_aio_file.lock);
+        file->aio--;
+        free(req);
+        _errno_file = write ? FILE_ERROR_WRITE : FILE_ERROR_READ;
+        return -1;
+    }
+#endif
+    return 0;
+}
+/* Start reading len bytes at offset into buf.
+ */
+PRS_EXPORT int submit_read_file(file_t *file, void *buf, size_t len,
+    file_off_t offset, file_done_t done, void *data)
+{
+    return _submit_aio_file(file, buf, len, offset, 0, done, data);
+}
+/* Start writing len bytes from buf at offset.
+ */
+PRS_EXPORT int submit_write_file(file_t *file, const void *buf, size_t len,
+    file_off_t offset, file_done_t done, void *data)
+{
+    return _submit_aio_file(file, (void*)buf, len, offset, 1, done, data);
+}
+/* Run the callback of a finished request and free it.
+ */
+static void _finish_aio_file(struct file_aio *req)
+{
+    int err = FILE_ERROR_OKAY;
+    if(req->res < 0)
+        err = req->write ? FILE_ERROR_WRITE : FILE_ERROR_READ;
+    req->file->aio--;
+    if(req->done != NULL)
+        req->done(req->file, req->buf, req->res < 0 ? -1 : req->res,
+            err, req->data);
+    free(req);
+}
+/* Wait for every request on file and run their callbacks now, before
+ * close_file() frees it; requests of other files stay for reap_file().
+ */
+static void _settle_aio_file(file_t *file)
+{
+    struct file_aio *req, **link, **tail, *mine;
+    while(file->aio > 0) {
+#ifdef HAVE_IO_URING
+        if(_aio_file.ring >= 0)
+            _drain_ring_aio_file(0);
+#endif
+        _lock_aio_file();
+        mine = NULL;
+        tail = &mine;
+        link = &_aio_file.done;
+        _aio_file.done_tail = NULL;
+        while((req = *link) != NULL) {
+            if(req->file == file) {
+                *link = req->next;
+                req->next = NULL;
+                *tail = req;
+                tail = &req->next;
+            } else {
+                _aio_file.done_tail = req;
+                link = &req->next;
+            }
+        }
+        if(mine == NULL) {
+            /* none finished yet; this can wake for another file */
+#ifndef _WIN32
+            if(_aio_file.pool != NULL)
+                pthread_cond_wait(&_aio_file.cond, &_aio_file.lock);
+#endif
+            _unlock_aio_file();
+#ifdef HAVE_IO_URING
+            if(_aio_file.ring >= 0)
+                _drain_ring_aio_file(1);
+#endif
+            continue;
+        }
+        _unlock_aio_file();
+        /* callbacks may submit more on file, so go round again */
+        while((req = mine) != NULL) {
+            mine = req->next;
+            _finish_aio_file(req);
+        }
+    }
+}
+/* Run callbacks of finished requests; returns how many were reaped.
+ */
+PRS_EXPORT int reap_file(int wait)
+{
+    struct file_aio *req, *list;
+    int count = 0;
+    if(!_aio_file.init)
+        return 0;
+#ifdef HAVE_IO_URING
+    if(_aio_file.ring >= 0) {
+        _drain_ring_aio_file(wait && _aio_file.done == NULL);
+        list = _take_aio_file();
+    } else
+#endif
+    {
+#ifndef _WIN32
+        pthread_mutex_lock(&_aio_file.lock);
+        while(wait && _aio_file.done == NULL && _aio_file.inflight > 0)
+            pthread_cond_wait(&_aio_file.cond, &_aio_file.lock);
+        list = _take_aio_file();
+        pthread_mutex_unlock(&_aio_file.lock);
+#else
+        list = _take_aio_file();
+#endif
+    }
+    while((req = list) != NULL) {
+        list = req->next;
+        _finish_aio_file(req);
+        count++;
+    }
+    return count;
+}
+
+/* ---------------------------- copy functions ------------------------- */
+
+/* Reserve disk blocks for the next bytes written, keeping the size.
+ */
+PRS_EXPORT int reserve_file(file_t *file, file_off_t bytes)
+{
+    file_off_t pos;
+    int fd;
+#ifndef _WIN32
+    struct stat st;
+#endif
+    if(bytes < 0 || (fd = _fd_file(file)) < 0 ||
+            (pos = tell64_file(file)) < 0)
+        return -1;
+    if(bytes == 0)
+        return 0;
+#ifndef _WIN32
+    if((file->flags & FILE_FLAG_APPEND) && fstat(fd, &st) == 0)
+        pos = (file_off_t)st.st_size;
+#endif
+#if defined(__linux) && defined(FALLOC_FL_KEEP_SIZE)
+    if(fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t)pos, (off_t)bytes) == 0) {
+        file->flags |= FILE_FLAG_RESERVE;
+        return 0;
+    }
+#elif defined(F_PREALLOCATE)
+    {
+        fstore_t store;
+        /* contiguous if possible, in pieces otherwise */
+        store.fst_flags = F_ALLOCATECONTIG;
+        store.fst_posmode = F_PEOFPOSMODE;
+        store.fst_offset = 0;
+        store.fst_length = (off_t)bytes;
+        store.fst_bytesalloc = 0;
+        if(fcntl(fd, F_PREALLOCATE, &store) < 0) {
+            store.fst_flags = F_ALLOCATEALL;
+            if(fcntl(fd, F_PREALLOCATE, &store) < 0)
+                return -1;
+        }
+        file->flags |= FILE_FLAG_RESERVE;
+        return 0;
+    }
+#else
+    (void)pos;
+#endif
+    return -1;
+}
+
+/* Get both streams ready for copying with their descriptors.
+ */
+static void _prepare_copy_file(file_t *src, file_t *dst, file_off_t dst_off)
+{
+    _sync_file(src);
+    _sync_file(dst);
+    if(src->flags & FILE_FLAG_WRITE)
+        fflush(src->fp);
+    fflush(dst->fp);
+    if(!(dst->flags & FILE_FLAG_APPEND))
+        _truncate_index_file(dst, dst_off);
+}
+#ifdef __linux
+/* Copy inside the kernel, copy_file_range() first, sendfile() next;
+ * returns bytes copied, *done is set when nothing is left to try.
+ */
+static file_off_t _kernel_copy_file(int in, file_off_t src_off, int out,
+    file_off_t dst_off, file_off_t len, int *done)
+{
+    file_off_t total = 0;
+    loff_t off_in = (loff_t)src_off, off_out = (loff_t)dst_off;
+    off_t off;
+    ssize_t n = 0;
+    size_t chunk;
+    *done = 0;
+    /* copy_file_range() shares extents where the file system can */
+    while(total < len) {
+        chunk = (len - total > (file_off_t)(1 << 30)) ?
+            (size_t)1 << 30 : (size_t)(len - total);
+        if((n = copy_file_range(in, &off_in, out, &off_out, chunk, 0)) <= 0)
+            break;
+        total += n;
+    }
+    if(total == len || n == 0) {
+        *done = 1;
+        return total;
+    }
+    /* sendfile() writes at the descriptor position */
+    off = (off_t)(src_off + total);
+    if(lseek(out, (off_t)(dst_off + total), SEEK_SET) < 0)
+        return total;
+    while(total < len) {
+        chunk = (len - total > (file_off_t)(1 << 30)) ?
+            (size_t)1 << 30 : (size_t)(len - total);
+        if((n = sendfile(out, in, &off, chunk)) <= 0)
+            break;
+        total += n;
+    }
+    *done = (total == len || n == 0);
+    return total;
+}
+#endif
+/* Copy len bytes of data from src_off to dst_off, in the kernel where
+ * it can be done and through *buf (allocated on first use) otherwise;
+ * returns bytes copied.
+ */
+static file_off_t _copy_data_file(file_t *src, file_off_t src_off,
+    file_t *dst, file_off_t dst_off, file_off_t len, char **buf)
+{
+    file_off_t total = 0;
+    size_t chunk, n;
+#ifdef __linux
+    if(!(dst->flags & FILE_FLAG_APPEND) &&
+            !((src->flags | dst->flags) & FILE_FLAG_STREAM)) {
+        int done;
+        total = _kernel_copy_file(fileno(src->fp), src_off, fileno(dst->fp),
+            dst_off, len, &done);
+        if(done)
+            return total;
+    }
+#endif
+    /* plain loop through one large buffer */
+    if(*buf == NULL && (*buf = (char*)malloc(FILE_COPY_BUFSIZ)) == NULL) {
+        _errno_file = FILE_ERROR_WRITE;
+        return total;
+    }
+    while(total < len) {
+        chunk = (len - total > FILE_COPY_BUFSIZ) ?
+            FILE_COPY_BUFSIZ : (size_t)(len - total);
+#ifndef _WIN32
+        if(!((src->flags | dst->flags) & FILE_FLAG_STREAM)) {
+            ssize_t res = pread(fileno(src->fp), *buf, chunk,
+                (off_t)(src_off + total));
+            if(res < 0 && errno == EINTR)
+                continue;
+            if(res <= 0) {
+                if(res < 0)
+                    _errno_file = FILE_ERROR_READ;
+                break;
+            }
+            n = (size_t)res;
+            if(dst->flags & FILE_FLAG_APPEND)
+                res = write(fileno(dst->fp), *buf, n);
+            else
+                res = pwrite(fileno(dst->fp), *buf, n,
+                    (off_t)(dst_off + total));
+            if(res < (ssize_t)n) {
+                _errno_file = FILE_ERROR_WRITE;
+                if(res > 0)
+                    total += res;
+                break;
+            }
+            total += (file_off_t)n;
+            continue;
+        }
+#endif
+        if(FILE_SEEK(src->fp, src_off + total, SEEK_SET) != 0 ||
+                (n = _get_raw_file(src, *buf, chunk)) == 0)
+            break;
+        if(!(dst->flags & FILE_FLAG_APPEND))
+            FILE_SEEK(dst->fp, dst_off + total, SEEK_SET);
+        if(_put_raw_file(dst, *buf, n) < n)
+            break;
+        fflush(dst->fp);
+        total += (file_off_t)n;
+    }
+    return total;
+}
+#if !defined(_WIN32) && defined(SEEK_DATA)
+/* Leave len bytes at off in out as a hole: nothing to do past the old
+ * end, punched before it where the system can; zero when not left.
+ */
+static int _hole_file(int out, file_off_t off, file_off_t len,
+    file_off_t size)
+{
+    if(off >= size)
+        return 1;
+#if defined(__linux) && defined(FALLOC_FL_PUNCH_HOLE)
+    if(off + len <= size && fallocate(out,
+            FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, (off_t)off,
+            (off_t)len) == 0)
+        return 1;
+#else
+    (void)out;
+    (void)len;
+#endif
+    return 0;
+}
+/* Copy a range of src only reading its data, holes stay holes in dst;
+ * returns bytes copied (holes included).
+ */
+static file_off_t _copy_sparse_file(file_t *src, file_off_t src_off,
+    file_t *dst, file_off_t dst_off, file_off_t len, char **buf)
+{
+    int in = fileno(src->fp), out = fileno(dst->fp);
+    file_off_t total = 0, pos, data, hole, n;
+    struct stat st_in, st_out;
+    if(fstat(in, &st_in) < 0 || fstat(out, &st_out) < 0)
+        return _copy_data_file(src, src_off, dst, dst_off, len, buf);
+    /* holes past the end of src do not exist */
+    if(src_off >= (file_off_t)st_in.st_size)
+        return 0;
+    if(len > (file_off_t)st_in.st_size - src_off)
+        len = (file_off_t)st_in.st_size - src_off;
+    while(total < len) {
+        pos = src_off + total;
+        if((data = (file_off_t)lseek(in, (off_t)pos, SEEK_DATA)) < 0)
+            data = (errno == ENXIO) ? src_off + len : pos;
+        if(data > src_off + len)
+            data = src_off + len;
+        if(data > pos) {
+            n = data - pos;
+            if(!_hole_file(out, dst_off + total, n,
+                    (file_off_t)st_out.st_size) &&
+                    _copy_data_file(src, pos, dst, dst_off + total, n,
+                    buf) != n)
+                break;
+            total += n;
+            continue;
+        }
+        if((hole = (file_off_t)lseek(in, (off_t)data, SEEK_HOLE)) < 0 ||
+                hole > src_off + len)
+            hole = src_off + len;
+        n = _copy_data_file(src, data, dst, dst_off + total, hole - data,
+            buf);
+        total += n;
+        if(n != hole - data)
+            break;
+    }
+    /* a hole at the end still has to make dst long enough */
+    if(total == len && dst_off + len > (file_off_t)st_out.st_size &&
+            ftruncate(out, (off_t)(dst_off + len)) < 0)
+        _errno_file = FILE_ERROR_WRITE;
+    return total;
+}
+#endif
+/* Copy len bytes from src at src_off to dst at dst_off without bouncing
+ * through user space where the system allows; positions are unchanged.
+ */
+PRS_EXPORT file_off_t copy_range_file(file_t *src, file_off_t src_off,
+    file_t *dst, file_off_t dst_off, file_off_t len)
+{
+    file_off_t total, src_pos, dst_pos;
+    char *buf = NULL;
+    if(src->fp == NULL || dst->fp == NULL || src_off < 0 || dst_off < 0) {
+        _errno_file = FILE_ERROR_WRITE;
+        return -1;
+    }
+    _prepare_copy_file(src, dst, dst_off);
+    src_pos = FILE_TELL(src->fp);
+    dst_pos = FILE_TELL(dst->fp);
+#if !defined(_WIN32) && defined(SEEK_DATA)
+    if(!(dst->flags & FILE_FLAG_APPEND) &&
+            !((src->flags | dst->flags) & FILE_FLAG_STREAM))
+        total = _copy_sparse_file(src, src_off, dst, dst_off, len, &buf);
+    else
+#endif
+    total = _copy_data_file(src, src_off, dst, dst_off, len, &buf);
+    free(buf);
+    /* streams may have cached positions, put both back */
+    FILE_SEEK(src->fp, src_pos, SEEK_SET);
+    FILE_SEEK(dst->fp, dst_pos, (dst->flags & FILE_FLAG_APPEND) ?
+        SEEK_END : SEEK_SET);
+    return total;
+}
+/* Copy the rest of src to dst from both current positions; both files
+ * end up just past the copied data.
+ */
+PRS_EXPORT file_off_t copy_file(file_t *src, file_t *dst)
+{
+    file_off_t src_pos, dst_pos, size, total;
+    if((src_pos = tell64_file(src)) < 0 || (dst_pos = tell64_file(dst)) < 0
+            || (size = get_size64_file(src)) < 0)
+        return -1;
+    if(size <= src_pos)
+        return 0;
+    if((total = copy_range_file(src, src_pos, dst, dst_pos,
+            size - src_pos)) < 0)
+        return -1;
+    seek64_file(src, src_pos + total, SEEK_SET);
+    if(dst->flags & FILE_FLAG_APPEND)
+        seek64_file(dst, 0, SEEK_END);
+    else
+        seek64_file(dst, dst_pos + total, SEEK_SET);
+    return total;
+}
+
+/* --------------------------- helper funtions ------------------------- */
+
+/* Gets the handle for a given file; returns FILE pointer.
+ */
+PRS_EXPORT FILE *get_handle_file(file_t *file)
+{
+    if(file->fp != NULL)
+        _sync_file(file);
+    return (file->fp == NULL) ? NULL : file->fp;
+}
+/* Gets the mapped view of the file; len receives its length.
+ */
+PRS_EXPORT const void *get_view_file(file_t *file, size_t *len)
+{
+    if(!(file->flags & FILE_FLAG_MAP)) {
+        if(len != NULL)
+            *len = 0;
+        return NULL;
+    }
+    if(len != NULL)
+        *len = file->map_len;
+    return file->map;
+}
+/* Start or stop checksumming the data moved through file.
+ */
+PRS_EXPORT void set_checksum_file(file_t *file, int on)
+{
+    _sync_file(file);
+    file->crc_on = on;
+    file->crc = 0;
+}
+/* Gets the checksum of data moved since set_checksum_file().
+ */
+PRS_EXPORT unsigned int get_checksum_file(file_t *file)
+{
+    if(file->buf.wlen > 0)
+        _flush_write_file(file);
+    return file->crc;
+}
+/* Start or stop checking that text read from file is UTF-8.
+ */
+PRS_EXPORT void set_utf8_file(file_t *file, int on)
+{
+    _sync_file(file);
+    file->utf8_on = on;
+    file->utf8_npart = 0;
+    file->utf8_skip = 0;
+    file->utf8_seen = 0;
+    file->utf8_bad = -1;
+}
+/* Gets the offset of the first byte read that was not well formed UTF-8.
+ */
+PRS_EXPORT file_off_t check_utf8_file(file_t *file)
+{
+    int end;
+    if(file->utf8_bad < 0 && file->utf8_npart > 0) {
+        /* a character cut off is only bad when nothing more can come */
+        if(file->flags & FILE_FLAG_MAP)
+            end = file->map_pos + file->buf.rlen >= file->map_len;
+        else if(file->io != NULL)
+            end = file->io_eof;
+        else
+            end = file->fp != NULL && feof(file->fp);
+        if(end) {
+            file->utf8_bad = file->utf8_seen - (file_off_t)file->utf8_npart;
+            _errno_file = FILE_ERROR_UTF8;
+        }
+    }
+    return file->utf8_bad;
+}
+#ifdef FILE_HAVE_IO
+/* Gets the contents of a memory file; len receives their length.
+ */
+PRS_EXPORT const void *get_memory_file(file_t *file, size_t *len)
+{
+    struct file_mem *mem;
+    if(file->io != &_mem_io_file || file->fp == NULL) {
+        if(len != NULL)
+            *len = 0;
+        return NULL;
+    }
+    _sync_file(file);
+    fflush(file->fp);
+    mem = (struct file_mem*)file->io_ctx;
+    if(len != NULL)
+        *len = mem->len;
+    return mem->data;
+}
+#endif
+/* Gets the name of the file passed in.
+ */
+PRS_EXPORT const char *get_name_file(file_t *file)
+{
+    return file->name;
+}
+/* Gets the size of the current file.
+ */
+PRS_EXPORT long get_size_file(file_t *file)
+{
+    file_off_t size = get_size64_file(file);
+    if(size > LONG_MAX) {
+        _errno_file = FILE_ERROR_SIZE;
+        return -1;
+    }
+    return (long)size;
+}
+/* Gets the size of the current file.
+ */
+PRS_EXPORT file_off_t get_size64_file(file_t *file)
+{
+    file_off_t size, cur_pos;
+#ifndef _WIN32
+    struct stat st;
+#endif
+    if(file->flags & FILE_FLAG_MAP)
+        return (file_off_t)file->map_len;
+    _sync_file(file);
+#ifndef _WIN32
+    if(file->flags & FILE_FLAG_WRITE)
+        fflush(file->fp);
+    if(fstat(fileno(file->fp), &st) == 0 && S_ISREG(st.st_mode))
+        return (file_off_t)st.st_size;
+#endif
+    cur_pos = FILE_TELL(file->fp);
+    FILE_SEEK(file->fp, 0, SEEK_END);
+    errno = 0;
+    size = FILE_TELL(file->fp);
+    if(errno != 0)
+        _errno_file = FILE_ERROR_SIZE;
+    FILE_SEEK(file->fp, cur_pos, SEEK_SET);
+    return size;
+}
+/* Gets the line count of the current file.
+ */
+PRS_EXPORT int get_lines_file(file_t *file)
+{
+    file_off_t lines = get_lines64_file(file);
+    if(lines > INT_MAX) {
+        _errno_file = FILE_ERROR_LINE;
+        return -1;
+    }
+    return (int)lines;
+}
+/* Gets the line count of the current file; read from the line index.
+ */
+PRS_EXPORT file_off_t get_lines64_file(file_t *file)
+{
+    if(_index_file(file) < 0) {
+        _errno_file = FILE_ERROR_LINE;
+        return -1;
+    }
+    return (file_off_t)(file->index_len - 1);
+}
+/* Seek to the start of line (counting from zero).
+ */
+PRS_EXPORT int get_line_at_file(file_t *file, file_off_t line)
+{
+    if(_index_file(file) < 0 || line < 0 ||
+            (file_off_t)(size_t)line != line ||
+            (size_t)line >= file->index_len ||
+            file->index[line] >= file->index_end) {
+        _errno_file = FILE_ERROR_LINE;
+        return -1;
+    }
+    return seek64_file(file, file->index[line], SEEK_SET);
 }
 #ifdef __cplusplus
 }
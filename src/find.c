@@ -0,0 +1,579 @@
+/**
+ * @file find.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Fast search for literal patterns in files.
+ **************************************************************************
+ * @details A single pattern is found by comparing a block of bytes with
+ * its first byte and the block m - 1 bytes further on with its last,
+ * only places where both agree are compared in full. Several patterns
+ * share one Aho-Corasick automaton, stored as a full table over classes
+ * of the bytes they use; while no pattern is under way the bytes that
+ * cannot start one are skipped with SIMD compares when there are few.
+ **************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "file.h"
+#include "find.h"
+
+#define FIND_BUFSIZ (1 << 18)   /* bytes read from the file at once */
+#define FIND_SKIP_MAX 4         /* most starting bytes skipped with SIMD */
+#define FIND_NONE UINT_MAX      /* no transition yet, while building */
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FIND_SIMD 1             /* SSE2 is always there on x86_64 */
+#endif
+
+/* Set of patterns, with the automaton when there is more than one.
+ */
+struct find {
+	size_t count;
+	char **pats;              /* copies of the patterns */
+	size_t *lens;
+	size_t maxlen;
+	unsigned char cls[256];   /* class of every byte, 0 for unused ones */
+	unsigned int nclass;
+	unsigned int *next;       /* transition of state * nclass + class */
+	int *out;                 /* pattern ending in a state, or -1 */
+	int *same;                /* another pattern equal to a pattern, or -1 */
+	unsigned int *dict;       /* nearest suffix state with output, or 0 */
+	unsigned char first[FIND_SKIP_MAX];  /* bytes leaving the root */
+	int nfirst;               /* how many of them, -1 for too many */
+	/* where the last search left off, to carry on from */
+	file_t *file;
+	char name[MAX_PATH];
+	file_off_t after;         /* position the file was left at */
+	unsigned char *buf;       /* window of a file that is not mapped */
+	size_t len;               /* bytes in buf */
+	file_off_t base;          /* file offset of buf */
+	size_t resume;            /* where searching the window goes on */
+	unsigned int state;       /* automaton state at resume */
+	int skip;                 /* matches ending just before it reported */
+	int mapped;               /* searched through the view */
+	file_off_t lpos;          /* offset lines are counted up to */
+	file_off_t lline;         /* line at lpos */
+};
+
+/* One search over a window of the file.
+ */
+struct find_run {
+	find_t *find;
+	const unsigned char *buf; /* the window */
+	file_off_t base;          /* file offset of buf */
+	size_t cur;               /* how far lines are counted inside buf */
+	file_off_t line;          /* line at cur */
+	unsigned int state;       /* automaton state after the last byte */
+	int skip;                 /* matches reported at the last byte */
+	find_each_t each;
+	void *arg;
+	file_off_t count;         /* matches reported */
+	file_off_t end;           /* offset just past the last one */
+	int stop;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Count the newlines in n bytes.
+ */
+static file_off_t _lines_find(const unsigned char *p, size_t n)
+{
+	const unsigned char *end = p + n;
+	file_off_t count = 0;
+#ifdef FIND_SIMD
+	const __m128i nl = _mm_set1_epi8('\n');
+	for(; end - p >= 16; p += 16)
+		count += __builtin_popcount((unsigned int)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), nl)));
+#endif
+	for(; p < end && (p = memchr(p, '\n', end - p)) != NULL; p++)
+		count++;
+	return count;
+}
+/* Report a match starting at buf[j].
+ */
+static void _emit_find(struct find_run *run, size_t j, size_t k)
+{
+	find_match_t match;
+	match.offset = run->base + (file_off_t)j;
+	match.pattern = k;
+	if(j >= run->cur) {
+		run->line += _lines_find(run->buf + run->cur, j - run->cur);
+		run->cur = j;
+		match.line = run->line;
+	} else {
+		/* matches come by their end, this one starts further back */
+		match.line = run->line - _lines_find(run->buf + j, run->cur - j);
+	}
+	run->count++;
+	run->end = match.offset + (file_off_t)run->find->lens[k];
+	if(run->each(&match, run->arg) != 0)
+		run->stop = 1;
+}
+#ifdef FIND_SIMD
+/* Check 32 starting places at a time; returns where it stopped.
+ */
+__attribute__((target("avx2")))
+static size_t _one_avx2_find(struct find_run *run, size_t i, size_t end)
+{
+	const unsigned char *buf = run->buf;
+	const unsigned char *pat = (const unsigned char*)run->find->pats[0];
+	size_t m = run->find->lens[0], j;
+	const __m256i first = _mm256_set1_epi8((char)pat[0]);
+	const __m256i last = _mm256_set1_epi8((char)pat[m-1]);
+	unsigned int mask;
+	for(; !run->stop && i + 32 <= end; i += 32) {
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(first,
+			_mm256_loadu_si256((const __m256i*)(buf + i))),
+			_mm256_cmpeq_epi8(last,
+			_mm256_loadu_si256((const __m256i*)(buf + i + m - 1)))));
+		for(; mask != 0 && !run->stop; mask &= mask - 1) {
+			j = i + (size_t)__builtin_ctz(mask);
+			if(memcmp(buf + j + 1, pat + 1, m - 2) == 0)
+				_emit_find(run, j, 0);
+		}
+	}
+	return i;
+}
+#endif
+/* Search for the one pattern starting anywhere in [i, len - m].
+ */
+static void _one_find(struct find_run *run, size_t i, size_t len)
+{
+	const unsigned char *buf = run->buf, *p;
+	const unsigned char *pat = (const unsigned char*)run->find->pats[0];
+	size_t m = run->find->lens[0], end;
+#ifdef FIND_SIMD
+	__m128i first, last;
+	unsigned int mask;
+	size_t j;
+#endif
+	if(len < m)
+		return;
+	end = len - m + 1;
+	if(m > 1) {
+#ifdef FIND_SIMD
+		if(__builtin_cpu_supports("avx2"))
+			i = _one_avx2_find(run, i, end);
+		first = _mm_set1_epi8((char)pat[0]);
+		last = _mm_set1_epi8((char)pat[m-1]);
+		for(; !run->stop && i + 16 <= end; i += 16) {
+			mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(first,
+				_mm_loadu_si128((const __m128i*)(buf + i))),
+				_mm_cmpeq_epi8(last,
+				_mm_loadu_si128((const __m128i*)(buf + i + m - 1)))));
+			for(; mask != 0 && !run->stop; mask &= mask - 1) {
+				j = i + (size_t)__builtin_ctz(mask);
+				if(memcmp(buf + j + 1, pat + 1, m - 2) == 0)
+					_emit_find(run, j, 0);
+			}
+		}
+#endif
+	}
+	/* the rest, or everything without SIMD */
+	while(!run->stop && i < end &&
+			(p = memchr(buf + i, pat[0], end - i)) != NULL) {
+		i = (size_t)(p - buf);
+		if(p[m-1] == pat[m-1] && memcmp(p + 1, pat + 1, m - 1) == 0)
+			_emit_find(run, i, 0);
+		i++;
+	}
+}
+/* Skip to the next byte that can start a pattern.
+ */
+static size_t _skip_find(const find_t *find, const unsigned char *buf,
+	size_t i, size_t len)
+{
+#ifdef FIND_SIMD
+	__m128i a, hit;
+	unsigned int mask;
+	int k;
+	for(; i + 16 <= len; i += 16) {
+		a = _mm_loadu_si128((const __m128i*)(buf + i));
+		hit = _mm_cmpeq_epi8(a, _mm_set1_epi8((char)find->first[0]));
+		for(k = 1; k < find->nfirst; k++)
+			hit = _mm_or_si128(hit, _mm_cmpeq_epi8(a,
+				_mm_set1_epi8((char)find->first[k])));
+		if((mask = (unsigned int)_mm_movemask_epi8(hit)) != 0)
+			return i + (size_t)__builtin_ctz(mask);
+	}
+#endif
+	for(; i < len; i++)
+		if(find->next[find->cls[buf[i]]] != 0)
+			break;
+	return i;
+}
+/* Report the matches state s holds, ending at buf[i], but for the
+ * first skip of them; returns how many it got through before a stop.
+ */
+static int _out_find(struct find_run *run, unsigned int s, size_t i, int skip)
+{
+	const find_t *find = run->find;
+	unsigned int t;
+	int k, n = 0;
+	for(t = s; t != 0; t = find->dict[t])
+		for(k = find->out[t]; k >= 0; k = find->same[k]) {
+			if(n++ < skip)
+				continue;
+			_emit_find(run, i + 1 - find->lens[k], (size_t)k);
+			if(run->stop)
+				return n;
+		}
+	return n;
+}
+/* Run the automaton over [i, len), carrying on from the last state;
+ * returns the next byte to feed it.
+ */
+static size_t _many_find(struct find_run *run, size_t i, size_t len)
+{
+	const find_t *find = run->find;
+	const unsigned char *buf = run->buf;
+	unsigned int s = run->state;
+	int n;
+	if(run->skip > 0) {
+		/* the rest of what ended on the byte before */
+		n = _out_find(run, s, i - 1, run->skip);
+		if(run->stop) {
+			run->skip = n;
+			return i;
+		}
+		run->skip = 0;
+	}
+	for(; i < len; i++) {
+		if(s == 0 && find->nfirst > 0 &&
+				(i = _skip_find(find, buf, i, len)) == len)
+			break;
+		s = find->next[s * find->nclass + find->cls[buf[i]]];
+		if(find->out[s] < 0 && find->dict[s] == 0)
+			continue;
+		n = _out_find(run, s, i, 0);
+		if(run->stop) {
+			run->skip = n;
+			i++;
+			break;
+		}
+	}
+	run->state = s;
+	return i;
+}
+/* Build the automaton of a set of patterns with total bytes in all.
+ */
+static int _build_find(find_t *find, size_t total)
+{
+	unsigned int *fail, *queue, *row, nstates = 1, s, t, r, c;
+	size_t cap = total + 1, head = 0, tail = 0, i;
+	const unsigned char *p;
+	int k, res = -1;
+	/* a class for every byte in use, class 0 for the rest */
+	for(i = 0; i < find->count; i++)
+		for(p = (const unsigned char*)find->pats[i]; *p != '\0'; p++)
+			if(find->cls[*p] == 0)
+				find->cls[*p] = (unsigned char)++find->nclass;
+	find->nclass++;
+	if(cap > UINT_MAX / find->nclass)
+		return -1;
+	find->next = (unsigned int*)malloc(cap * find->nclass *
+		sizeof(unsigned int));
+	find->out = (int*)malloc(cap * sizeof(int));
+	find->dict = (unsigned int*)calloc(cap, sizeof(unsigned int));
+	find->same = (int*)malloc(find->count * sizeof(int));
+	fail = (unsigned int*)malloc(cap * sizeof(unsigned int));
+	queue = (unsigned int*)malloc(cap * sizeof(unsigned int));
+	if(find->next == NULL || find->out == NULL || find->dict == NULL ||
+			find->same == NULL || fail == NULL || queue == NULL)
+		goto done;
+	for(i = 0; i < cap * find->nclass; i++)
+		find->next[i] = FIND_NONE;
+	for(i = 0; i < cap; i++)
+		find->out[i] = -1;
+	/* the trie */
+	for(k = 0; k < (int)find->count; k++) {
+		s = 0;
+		for(p = (const unsigned char*)find->pats[k]; *p != '\0'; p++) {
+			row = find->next + s * find->nclass;
+			if(row[find->cls[*p]] == FIND_NONE)
+				row[find->cls[*p]] = nstates++;
+			s = row[find->cls[*p]];
+		}
+		find->same[k] = find->out[s];
+		find->out[s] = k;
+	}
+	/* breadth first, missing edges take the failure link's */
+	for(c = 0; c < find->nclass; c++) {
+		if((t = find->next[c]) == FIND_NONE) {
+			find->next[c] = 0;
+		} else {
+			fail[t] = 0;
+			queue[tail++] = t;
+		}
+	}
+	while(head < tail) {
+		s = queue[head++];
+		row = find->next + s * find->nclass;
+		for(c = 0; c < find->nclass; c++) {
+			r = find->next[fail[s] * find->nclass + c];
+			if((t = row[c]) == FIND_NONE) {
+				row[c] = r;
+				continue;
+			}
+			fail[t] = r;
+			find->dict[t] = (find->out[r] >= 0) ? r : find->dict[r];
+			queue[tail++] = t;
+		}
+	}
+	/* few bytes leave the root, skip to them quickly */
+	find->nfirst = 0;
+	for(c = 1; c < 256 && find->nfirst >= 0; c++) {
+		if(find->next[find->cls[c]] == 0)
+			continue;
+		if(find->nfirst == FIND_SKIP_MAX)
+			find->nfirst = -1;
+		else
+			find->first[find->nfirst++] = (unsigned char)c;
+	}
+	res = 0;
+
+done:
+	free(fail);
+	free(queue);
+	return res;
+}
+/* Create a set of patterns to search for.
+ */
+PRS_EXPORT find_t *create_find(const char **patterns, size_t count)
+{
+	find_t *find;
+	size_t i, total = 0;
+	if(patterns == NULL || count == 0 || count > (size_t)INT_MAX)
+		return NULL;
+	if((find = (find_t*)calloc(1, sizeof(find_t))) == NULL)
+		return NULL;
+	find->count = count;
+	find->pats = (char**)calloc(count, sizeof(char*));
+	find->lens = (size_t*)malloc(count * sizeof(size_t));
+	if(find->pats == NULL || find->lens == NULL)
+		goto fail;
+	for(i = 0; i < count; i++) {
+		if(patterns[i] == NULL || (find->lens[i] = strlen(patterns[i])) == 0)
+			goto fail;
+		if((find->pats[i] = (char*)malloc(find->lens[i] + 1)) == NULL)
+			goto fail;
+		memcpy(find->pats[i], patterns[i], find->lens[i] + 1);
+		if(find->lens[i] > find->maxlen)
+			find->maxlen = find->lens[i];
+		total += find->lens[i];
+	}
+	if(count > 1 && _build_find(find, total) < 0)
+		goto fail;
+	return find;
+
+fail:
+	destroy_find(&find);
+	return NULL;
+}
+/* Destroy a set of patterns.
+ */
+PRS_EXPORT void destroy_find(find_t **find)
+{
+	size_t i;
+	if(find == NULL || *find == NULL)
+		return;
+	if((*find)->pats != NULL)
+		for(i = 0; i < (*find)->count; i++)
+			free((*find)->pats[i]);
+	free((*find)->pats);
+	free((*find)->lens);
+	free((*find)->next);
+	free((*find)->out);
+	free((*find)->same);
+	free((*find)->dict);
+	free((*find)->buf);
+	free(*find);
+	*find = NULL;
+}
+/* Line number of pos, counted on from where the last search with find
+ * left off when it was in the same file, from the start otherwise.
+ */
+static int _line_find(find_t *find, file_t *file, file_off_t pos,
+	file_off_t *line)
+{
+	const unsigned char *view;
+	unsigned char *buf;
+	file_off_t from = 0, to = pos, count = 0;
+	size_t len, n;
+	int back = 0;
+	*line = 0;
+	if(find->file == file && strcmp(find->name, get_name_file(file)) == 0) {
+		if(find->lpos <= pos) {
+			from = find->lpos;
+			*line = find->lline;
+		} else if(find->lpos - pos < pos) {
+			/* nearer to count back from there */
+			from = pos;
+			to = find->lpos;
+			*line = find->lline;
+			back = 1;
+		}
+	}
+	if((view = (const unsigned char*)get_view_file(file, &len)) != NULL) {
+		if(to > (file_off_t)len)
+			to = (file_off_t)len;
+		if(from < to)
+			count = _lines_find(view + from, (size_t)(to - from));
+	} else if(from < to) {
+		if((buf = (unsigned char*)malloc(FIND_BUFSIZ)) == NULL)
+			return -1;
+		while(from < to) {
+			n = (to - from > FIND_BUFSIZ) ? FIND_BUFSIZ : (size_t)(to - from);
+			if((n = read_at_file(file, buf, n, from)) == 0)
+				break;
+			count += _lines_find(buf, n);
+			from += (file_off_t)n;
+		}
+		free(buf);
+	}
+	*line += back ? -count : count;
+	return 0;
+}
+/* Search [i, len) of the window; returns where the next search of it
+ * goes on, the next byte for the automaton or the next place a single
+ * pattern can start.
+ */
+static size_t _search_find(struct find_run *run, size_t i, size_t len)
+{
+	size_t m = run->find->lens[0];
+	if(run->find->count > 1)
+		return _many_find(run, i, len);
+	_one_find(run, i, len);
+	if(run->stop)
+		return (size_t)(run->end - run->base) - m + 1;
+	return (len >= m && len - m + 1 > i) ? len - m + 1 : i;
+}
+/* Search from the current position of file on, until each says stop;
+ * when the file is where the last search with find left it, that one
+ * is carried on with, so no match is lost or found twice.
+ */
+static file_off_t _run_find(file_t *file, find_t *find, find_each_t each,
+	void *arg)
+{
+	struct find_run run;
+	const unsigned char *view;
+	size_t len = 0, resume, keep, shift, n;
+	file_off_t pos;
+	int again;
+	if(find == NULL || (pos = tell64_file(file)) < 0)
+		return -1;
+	view = (const unsigned char*)get_view_file(file, &len);
+	memset(&run, 0, sizeof(run));
+	run.find = find;
+	run.each = each;
+	run.arg = arg;
+	again = (find->file == file && find->after == pos &&
+		find->mapped == (view != NULL) &&
+		strcmp(find->name, get_name_file(file)) == 0);
+	if(again) {
+		resume = find->resume;
+		run.state = find->state;
+		run.skip = find->skip;
+		run.line = find->lline;
+	} else {
+		if(_line_find(find, file, pos, &run.line) < 0)
+			return -1;
+		find->len = 0;
+		find->base = pos;
+		resume = 0;
+	}
+	if(view != NULL) {
+		/* a mapped file is one window */
+		run.buf = view;
+		if(again) {
+			run.cur = (size_t)find->lpos;
+		} else {
+			resume = (pos < (file_off_t)len) ? (size_t)pos : len;
+			run.cur = resume;
+		}
+		resume = _search_find(&run, resume, len);
+		if(!run.stop)
+			seek64_file(file, (file_off_t)len, SEEK_SET);
+	} else {
+		if(find->buf == NULL && (find->buf = (unsigned char*)malloc(
+				FIND_BUFSIZ + find->maxlen)) == NULL)
+			return -1;
+		run.buf = find->buf;
+		run.base = find->base;
+		run.cur = (size_t)(again ? find->lpos - find->base : 0);
+		len = find->len;
+		if(again && (resume < len || run.skip > 0))
+			resume = _search_find(&run, resume, len);
+		if(!run.stop && len > 0)
+			seek64_file(file, run.base + (file_off_t)len, SEEK_SET);
+		while(!run.stop) {
+			/* keep the bytes a match may still start in */
+			keep = (len < find->maxlen - 1) ? len : find->maxlen - 1;
+			shift = (len - keep < resume) ? len - keep : resume;
+			if(run.cur < shift) {
+				run.line += _lines_find(run.buf + run.cur, shift - run.cur);
+				run.cur = 0;
+			} else {
+				run.cur -= shift;
+			}
+			memmove(find->buf, find->buf + shift, len - shift);
+			run.base += (file_off_t)shift;
+			len -= shift;
+			resume -= shift;
+			if((n = read_file(file, find->buf + len, 1,
+					FIND_BUFSIZ + find->maxlen - len)) == 0)
+				break;
+			len += n;
+			resume = _search_find(&run, resume, len);
+		}
+		find->len = len;
+		find->base = run.base;
+	}
+	if(run.stop)
+		seek64_file(file, run.end, SEEK_SET);
+	/* the next search carries on from here */
+	find->file = file;
+	strncpy(find->name, get_name_file(file), MAX_PATH-1);
+	find->name[MAX_PATH-1] = '\0';
+	find->after = tell64_file(file);
+	find->mapped = (view != NULL);
+	find->resume = resume;
+	find->state = run.state;
+	find->skip = run.skip;
+	find->lpos = run.base + (file_off_t)run.cur;
+	find->lline = run.line;
+	return run.count;
+}
+/* Keep the first match and stop.
+ */
+static int _first_find(const find_match_t *match, void *arg)
+{
+	*(find_match_t*)arg = *match;
+	return 1;
+}
+/* Find the next match from the current position of file.
+ */
+PRS_EXPORT int find_file(file_t *file, find_t *find, find_match_t *match)
+{
+	file_off_t n = _run_find(file, find, _first_find, match);
+	return (n < 0) ? -1 : (int)n;
+}
+/* Call each for every match from the current position of file on.
+ */
+PRS_EXPORT file_off_t find_all_file(file_t *file, find_t *find,
+	find_each_t each, void *arg)
+{
+	return _run_find(file, find, each, arg);
+}
+#ifdef __cplusplus
+}
+#endif
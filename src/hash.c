@@ -0,0 +1,181 @@
+/**
+ * @file hash.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Fast non-cryptographic hashes of blocks of memory.
+ **************************************************************************
+ * @details Both read their input as little endian words at any
+ * alignment, so the results are the same on every host.
+ **************************************************************************
+ */
+
+#include <string.h>
+
+#include "hash.h"
+
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+
+#define MUR_C1 0x87C37B91114253D5ULL
+#define MUR_C2 0x4CF5AD432745937FULL
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Little endian 64 bit word at p.
+ */
+static unsigned long long _read64_hash(const unsigned char *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	unsigned long long v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#else
+	return (unsigned long long)p[0] | (unsigned long long)p[1] << 8 |
+		(unsigned long long)p[2] << 16 | (unsigned long long)p[3] << 24 |
+		(unsigned long long)p[4] << 32 | (unsigned long long)p[5] << 40 |
+		(unsigned long long)p[6] << 48 | (unsigned long long)p[7] << 56;
+#endif
+}
+/* Little endian 32 bit word at p.
+ */
+static unsigned long long _read32_hash(const unsigned char *p)
+{
+	return (unsigned long long)p[0] | (unsigned long long)p[1] << 8 |
+		(unsigned long long)p[2] << 16 | (unsigned long long)p[3] << 24;
+}
+/* One XXH64 lane step.
+ */
+static unsigned long long _round_hash(unsigned long long acc,
+	unsigned long long v)
+{
+	acc += v * XXH_P2;
+	acc = ROTL64(acc, 31);
+	return acc * XXH_P1;
+}
+/* Fold a lane into the XXH64 sum.
+ */
+static unsigned long long _merge_hash(unsigned long long h,
+	unsigned long long v)
+{
+	h ^= _round_hash(0, v);
+	return h * XXH_P1 + XXH_P4;
+}
+/* XXH64 of len bytes with seed.
+ */
+PRS_EXPORT unsigned long long digest64_hash(const void *buf, size_t len,
+	unsigned long long seed)
+{
+	const unsigned char *p = (const unsigned char*)buf;
+	const unsigned char *end = p + len;
+	unsigned long long h, v1, v2, v3, v4;
+	if(len >= 32) {
+		v1 = seed + XXH_P1 + XXH_P2;
+		v2 = seed + XXH_P2;
+		v3 = seed;
+		v4 = seed - XXH_P1;
+		/* four lanes of 8 bytes, independent of each other */
+		for(; end - p >= 32; p += 32) {
+			v1 = _round_hash(v1, _read64_hash(p));
+			v2 = _round_hash(v2, _read64_hash(p + 8));
+			v3 = _round_hash(v3, _read64_hash(p + 16));
+			v4 = _round_hash(v4, _read64_hash(p + 24));
+		}
+		h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+		h = _merge_hash(h, v1);
+		h = _merge_hash(h, v2);
+		h = _merge_hash(h, v3);
+		h = _merge_hash(h, v4);
+	} else {
+		h = seed + XXH_P5;
+	}
+	h += (unsigned long long)len;
+	for(; end - p >= 8; p += 8) {
+		h ^= _round_hash(0, _read64_hash(p));
+		h = ROTL64(h, 27) * XXH_P1 + XXH_P4;
+	}
+	if(end - p >= 4) {
+		h ^= _read32_hash(p) * XXH_P1;
+		h = ROTL64(h, 23) * XXH_P2 + XXH_P3;
+		p += 4;
+	}
+	for(; p < end; p++) {
+		h ^= *p * XXH_P5;
+		h = ROTL64(h, 11) * XXH_P1;
+	}
+	/* avalanche */
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+	return h;
+}
+/* Final mix of a MurmurHash3 half.
+ */
+static unsigned long long _fmix_hash(unsigned long long k)
+{
+	k ^= k >> 33;
+	k *= 0xFF51AFD7ED558CCDULL;
+	k ^= k >> 33;
+	k *= 0xC4CEB9FE1A85EC53ULL;
+	k ^= k >> 33;
+	return k;
+}
+/* MurmurHash3 x64_128 of len bytes with seed, into out.
+ */
+PRS_EXPORT void digest128_hash(const void *buf, size_t len, unsigned int seed,
+	unsigned long long out[2])
+{
+	const unsigned char *p = (const unsigned char*)buf;
+	const unsigned char *tail;
+	unsigned long long h1 = seed, h2 = seed, k1, k2;
+	size_t i, nblocks = len / 16;
+	for(i = 0; i < nblocks; i++, p += 16) {
+		k1 = _read64_hash(p) * MUR_C1;
+		k1 = ROTL64(k1, 31) * MUR_C2;
+		h1 ^= k1;
+		h1 = ROTL64(h1, 27) + h2;
+		h1 = h1 * 5 + 0x52DCE729;
+		k2 = _read64_hash(p + 8) * MUR_C2;
+		k2 = ROTL64(k2, 33) * MUR_C1;
+		h2 ^= k2;
+		h2 = ROTL64(h2, 31) + h1;
+		h2 = h2 * 5 + 0x38495AB5;
+	}
+	/* the last 0 to 15 bytes, bytes 8 on into k2 */
+	tail = p;
+	k1 = k2 = 0;
+	for(i = len & 15; i > 8; i--)
+		k2 ^= (unsigned long long)tail[i-1] << ((i - 9) * 8);
+	if((len & 15) > 8) {
+		k2 *= MUR_C2;
+		k2 = ROTL64(k2, 33) * MUR_C1;
+		h2 ^= k2;
+	}
+	for(i = ((len & 15) > 8) ? 8 : (len & 15); i > 0; i--)
+		k1 ^= (unsigned long long)tail[i-1] << ((i - 1) * 8);
+	if((len & 15) > 0) {
+		k1 *= MUR_C1;
+		k1 = ROTL64(k1, 31) * MUR_C2;
+		h1 ^= k1;
+	}
+	h1 ^= (unsigned long long)len;
+	h2 ^= (unsigned long long)len;
+	h1 += h2;
+	h2 += h1;
+	h1 = _fmix_hash(h1);
+	h2 = _fmix_hash(h2);
+	h1 += h2;
+	h2 += h1;
+	out[0] = h1;
+	out[1] = h2;
+}
+#ifdef __cplusplus
+}
+#endif
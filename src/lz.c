@@ -0,0 +1,202 @@
+/**
+ * @file lz.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Small and fast LZ77 block codec.
+ **************************************************************************
+ * @details Matches are found through a hash table of the last position
+ * every four byte sequence was seen at; no chains, no lazy matching.
+ * Runs of input without matches are skipped over faster and faster.
+ **************************************************************************
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4          /* shortest match worth a sequence */
+#define LZ_HASH_LOG 12          /* hash table has 1 << LZ_HASH_LOG slots */
+#define LZ_MAX_OFFSET 65535     /* farthest a match can look back */
+#define LZ_LAST_LITERALS 5      /* bytes at the end always kept literal */
+#define LZ_MF_LIMIT 12          /* no match starts this close to the end */
+#define LZ_SKIP_TRIGGER 6       /* misses before the step size grows */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Read four bytes from anywhere.
+ */
+static unsigned int _read32_lz(const unsigned char *p)
+{
+	unsigned int v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+/* Hash of four bytes into the table.
+ */
+static unsigned int _hash_lz(unsigned int v)
+{
+	return (v * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+/* Write a length of 15 or more as extra bytes.
+ */
+static unsigned char *_length_lz(unsigned char *op, size_t len)
+{
+	for(; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)len;
+	return op;
+}
+/* Write one sequence; returns NULL when it does not fit.
+ */
+static unsigned char *_emit_lz(unsigned char *op, unsigned char *oend,
+	const unsigned char *lit, size_t llen, size_t off, size_t mlen)
+{
+	unsigned char *token;
+	if((size_t)(oend - op) < llen + llen / 255 + mlen / 255 + 6)
+		return NULL;
+	token = op++;
+	if(llen >= 15) {
+		*token = 15 << 4;
+		op = _length_lz(op, llen - 15);
+	} else {
+		*token = (unsigned char)(llen << 4);
+	}
+	memcpy(op, lit, llen);
+	op += llen;
+	if(mlen == 0)
+		return op;
+	*op++ = (unsigned char)(off & 0xFF);
+	*op++ = (unsigned char)(off >> 8);
+	mlen -= LZ_MIN_MATCH;
+	if(mlen >= 15) {
+		*token |= 15;
+		op = _length_lz(op, mlen - 15);
+	} else {
+		*token |= (unsigned char)mlen;
+	}
+	return op;
+}
+/* Largest compressed size of len bytes.
+ */
+PRS_EXPORT size_t bound_lz(size_t len)
+{
+	return len + len / 255 + 16;
+}
+/* Compress a block; returns its size, zero if it is over cap.
+ */
+PRS_EXPORT size_t compress_lz(const void *src, size_t len, void *dst,
+	size_t cap)
+{
+	const unsigned char *base = (const unsigned char*)src;
+	const unsigned char *ip = base, *anchor = base, *ref;
+	const unsigned char *end = base + len, *mflimit, *matchlimit;
+	unsigned char *op = (unsigned char*)dst, *oend = op + cap;
+	unsigned int table[1 << LZ_HASH_LOG];
+	unsigned int seq, h, misses = 0;
+	size_t mlen;
+
+	if(len > LZ_MF_LIMIT) {
+		mflimit = end - LZ_MF_LIMIT;
+		matchlimit = end - LZ_LAST_LITERALS;
+		memset(table, 0, sizeof(table));
+		for(ip++; ip <= mflimit; ) {
+			seq = _read32_lz(ip);
+			h = _hash_lz(seq);
+			ref = base + table[h];
+			table[h] = (unsigned int)(ip - base);
+			if(ref >= ip || ip - ref > LZ_MAX_OFFSET ||
+					_read32_lz(ref) != seq) {
+				ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+				continue;
+			}
+			misses = 0;
+			/* grow the match both ways */
+			while(ip > anchor && ref > base && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+			for(mlen = LZ_MIN_MATCH; ip + mlen < matchlimit &&
+					ip[mlen] == ref[mlen]; mlen++)
+				;
+			op = _emit_lz(op, oend, anchor, (size_t)(ip - anchor),
+				(size_t)(ip - ref), mlen);
+			if(op == NULL)
+				return 0;
+			ip += mlen;
+			anchor = ip;
+			/* the end of a match often starts the next one */
+			if(ip <= mflimit)
+				table[_hash_lz(_read32_lz(ip - 2))] =
+					(unsigned int)(ip - 2 - base);
+		}
+	}
+	op = _emit_lz(op, oend, anchor, (size_t)(end - anchor), 0, 0);
+	return (op == NULL) ? 0 : (size_t)(op - (unsigned char*)dst);
+}
+/* Read a length of 15 or more; returns -1 past the end of input.
+ */
+static int _read_length_lz(const unsigned char **ip,
+	const unsigned char *iend, size_t *len)
+{
+	unsigned char b;
+	do {
+		if(*ip >= iend)
+			return -1;
+		b = *(*ip)++;
+		*len += b;
+	} while(b == 255);
+	return 0;
+}
+/* Decompress a whole block; zero on success, -1 when it is corrupt.
+ */
+PRS_EXPORT int decompress_lz(const void *src, size_t len, void *dst,
+	size_t *dlen)
+{
+	const unsigned char *ip = (const unsigned char*)src, *iend = ip + len;
+	unsigned char *op = (unsigned char*)dst, *oend = op + *dlen;
+	const unsigned char *ref;
+	size_t llen, mlen, off;
+	unsigned char token;
+
+	while(ip < iend) {
+		token = *ip++;
+		llen = token >> 4;
+		if(llen == 15 && _read_length_lz(&ip, iend, &llen) < 0)
+			return -1;
+		if(llen > (size_t)(iend - ip) || llen > (size_t)(oend - op))
+			return -1;
+		memcpy(op, ip, llen);
+		op += llen;
+		ip += llen;
+		if(ip == iend)
+			break;
+		if(iend - ip < 2)
+			return -1;
+		off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if(off == 0 || off > (size_t)(op - (unsigned char*)dst))
+			return -1;
+		mlen = token & 15;
+		if(mlen == 15 && _read_length_lz(&ip, iend, &mlen) < 0)
+			return -1;
+		mlen += LZ_MIN_MATCH;
+		if(mlen > (size_t)(oend - op))
+			return -1;
+		ref = op - off;
+		if(off >= mlen) {
+			memcpy(op, ref, mlen);
+			op += mlen;
+		} else {
+			/* overlapping copy repeats the last off bytes */
+			while(mlen-- > 0)
+				*op++ = *ref++;
+		}
+	}
+	*dlen = (size_t)(op - (unsigned char*)dst);
+	return 0;
+}
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @file pfile.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Parallel processing of text files by whole lines.
+ **************************************************************************
+ * @details Chunks of mapped files point into the view, other files are
+ * read with read_at_file() so every worker reads its own range without
+ * sharing the stream position.
+ **************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "tpool.h"
+#include "pfile.h"
+
+#define PFILE_CHUNK_SIZE (16L << 20)  /* bytes per chunk read into memory */
+#define PFILE_MAP_CHUNKS 4            /* chunks per thread on mapped files */
+
+/* One chunk of work for the pool.
+ */
+struct pfile_work {
+	file_t *file;
+	int mapped;
+	pfile_chunk_t chunk;
+	pfile_map_t map;
+	void *arg;
+	void *result;
+	int err;
+};
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Move off forward to the start of a line.
+ */
+static file_off_t _align_pfile(file_t *file, const char *view,
+	file_off_t size, file_off_t off)
+{
+	char buf[4096];
+	const char *p;
+	size_t n;
+
+	/* off already starts a line if the byte before it is a newline */
+	off--;
+	if(view != NULL) {
+		p = memchr(view + off, '\n', (size_t)(size - off));
+		return (p != NULL) ? (file_off_t)(p - view) + 1 : size;
+	}
+	while(off < size && (n = read_at_file(file, buf, sizeof(buf), off)) > 0) {
+		if((p = memchr(buf, '\n', n)) != NULL)
+			return off + (file_off_t)(p - buf) + 1;
+		off += (file_off_t)n;
+	}
+	return size;
+}
+/* Split file in chunks on line boundaries.
+ */
+PRS_EXPORT int split_pfile(file_t *file, int chunks, file_off_t *bounds)
+{
+	const char *view;
+	file_off_t size, off;
+	size_t len;
+	int i, n;
+
+	if((size = get_size64_file(file)) < 0)
+		return -1;
+	if(chunks < 1)
+		chunks = 1;
+	view = (const char*)get_view_file(file, &len);
+	bounds[0] = 0;
+	if(size == 0)
+		return 0;
+	for(i = 1, n = 0; i < chunks; i++) {
+		off = size / chunks * i;
+		if(off <= bounds[n])
+			continue;
+		off = _align_pfile(file, view, size, off);
+		if(off > bounds[n] && off < size)
+			bounds[++n] = off;
+	}
+	bounds[++n] = size;
+	return n;
+}
+/* Worker side, load the chunk if needed and map it.
+ */
+static void _work_pfile(void *arg)
+{
+	struct pfile_work *work = (struct pfile_work*)arg;
+	char *buf = NULL;
+
+	if(!work->mapped && work->chunk.len > 0) {
+		if((buf = (char*)malloc(work->chunk.len)) == NULL) {
+			work->err = 1;
+			return;
+		}
+		if(read_at_file(work->file, buf, work->chunk.len,
+				work->chunk.offset) != work->chunk.len) {
+			free(buf);
+			work->err = 1;
+			return;
+		}
+		work->chunk.data = buf;
+	}
+	work->result = work->map(&work->chunk, work->arg);
+	if(buf != NULL) {
+		free(buf);
+		work->chunk.data = NULL;
+	}
+}
+/* Run map over all chunks on a thread pool and reduce in order.
+ */
+PRS_EXPORT int run_pfile(file_t *file, int chunks, int threads,
+	pfile_map_t map, pfile_reduce_t reduce, void *arg)
+{
+	struct pfile_work *work;
+	file_off_t *bounds, size;
+	const char *view;
+	tpool_t *pool;
+	size_t len;
+	int i, n, err = 0;
+
+	if(map == NULL || (size = get_size64_file(file)) < 0)
+		return -1;
+	if(threads <= 0)
+		threads = get_cpus_tpool();
+	view = (const char*)get_view_file(file, &len);
+	if(chunks <= 0) {
+		if(view != NULL)
+			chunks = threads*PFILE_MAP_CHUNKS;
+		else if(size / PFILE_CHUNK_SIZE < 1 << 20)
+			chunks = (int)(size / PFILE_CHUNK_SIZE) + 1;
+		else
+			chunks = 1 << 20;
+		if(chunks < threads)
+			chunks = threads;
+	}
+	/* workers read through the descriptor, push out buffered data */
+	flush_file(file);
+	bounds = (file_off_t*)malloc(sizeof(file_off_t)*(chunks+1));
+	if(bounds == NULL)
+		return -1;
+	if((n = split_pfile(file, chunks, bounds)) <= 0) {
+		free(bounds);
+		return n;
+	}
+	work = (struct pfile_work*)malloc(sizeof(struct pfile_work)*n);
+	if(work == NULL) {
+		free(bounds);
+		return -1;
+	}
+	if((pool = create_tpool(threads < n ? threads : n)) == NULL) {
+		free(work);
+		free(bounds);
+		return -1;
+	}
+	for(i = 0; i < n; i++) {
+		work[i].file = file;
+		work[i].mapped = (view != NULL);
+		work[i].chunk.data = (view != NULL) ? view + bounds[i] : NULL;
+		work[i].chunk.len = (size_t)(bounds[i+1] - bounds[i]);
+		work[i].chunk.offset = bounds[i];
+		work[i].chunk.index = i;
+		work[i].map = map;
+		work[i].arg = arg;
+		work[i].result = NULL;
+		work[i].err = 0;
+		if(add_tpool(pool, _work_pfile, &work[i]) != 0)
+			_work_pfile(&work[i]);
+	}
+	wait_tpool(pool);
+	destroy_tpool(&pool);
+	for(i = 0; i < n; i++) {
+		if(work[i].err)
+			err = -1;
+		else if(reduce != NULL)
+			reduce(work[i].result, arg);
+	}
+	free(work);
+	free(bounds);
+	return err;
+}
+#ifdef __cplusplus
+}
+#endif
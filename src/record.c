@@ -0,0 +1,262 @@
+/**
+ * @file record.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Files of fixed size binary records with random access.
+ **************************************************************************
+ * @details Files opened read only are mapped and records are copied out
+ * of the view. Others go through the stream; the position is kept here
+ * so records read or written one after another never seek, and appends
+ * stay in the write buffer.
+ **************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "record.h"
+
+#define RECORD_VERSION 1
+
+/* Open record file.
+ */
+struct record {
+	file_t *file;
+	size_t size;                /* bytes per record */
+	file_off_t count;
+	file_off_t pos;             /* where the stream is, -1 for unknown */
+	int writing;                /* last moved data out */
+	int write;
+	const unsigned char *view;  /* records of a mapped file */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Store v little endian in 8 bytes at p.
+ */
+static void _put64_record(unsigned char *p, unsigned long long v)
+{
+	int i;
+	for(i = 0; i < 8; i++)
+		p[i] = (unsigned char)(v >> (i * 8));
+}
+/* Little endian 8 byte value at p.
+ */
+static unsigned long long _get64_record(const unsigned char *p)
+{
+	unsigned long long v = 0;
+	int i;
+	for(i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+/* Move the stream to off unless it is there already; switching between
+ * reads and writes always seeks, as stdio wants.
+ */
+static int _seek_record(record_t *rec, file_off_t off, int writing)
+{
+	if(rec->pos == off && rec->writing == writing)
+		return 0;
+	rec->writing = writing;
+	if(seek64_file(rec->file, off, SEEK_SET) < 0) {
+		rec->pos = -1;
+		return -1;
+	}
+	rec->pos = off;
+	return 0;
+}
+/* Write the header with the current count.
+ */
+static int _header_record(record_t *rec)
+{
+	unsigned char head[RECORD_HEADER];
+	memset(head, 0, sizeof(head));
+	memcpy(head, "PRSR", 4);
+	head[4] = RECORD_VERSION;
+	_put64_record(head + 8, (unsigned long long)rec->size);
+	_put64_record(head + 16, (unsigned long long)rec->count);
+	if(_seek_record(rec, 0, 1) < 0 ||
+			write_file(rec->file, head, 1, sizeof(head)) != sizeof(head)) {
+		rec->pos = -1;
+		return -1;
+	}
+	rec->pos = RECORD_HEADER;
+	return 0;
+}
+/* Check the header of an existing file and count its records.
+ */
+static int _load_record(record_t *rec, size_t size)
+{
+	unsigned char head[RECORD_HEADER];
+	unsigned long long hsize;
+	const unsigned char *view;
+	file_off_t len;
+	size_t vlen;
+	if((view = (const unsigned char*)get_view_file(rec->file, &vlen)) !=
+			NULL) {
+		if(vlen < RECORD_HEADER)
+			return -1;
+		memcpy(head, view, RECORD_HEADER);
+		rec->view = view + RECORD_HEADER;
+		len = (file_off_t)vlen;
+	} else {
+		if(read_file(rec->file, head, 1, RECORD_HEADER) != RECORD_HEADER ||
+				(len = get_size64_file(rec->file)) < 0)
+			return -1;
+		rec->pos = RECORD_HEADER;
+	}
+	hsize = _get64_record(head + 8);
+	if(memcmp(head, "PRSR", 4) != 0 || head[4] != RECORD_VERSION ||
+			hsize == 0 || hsize != (size_t)hsize ||
+			(size != 0 && size != hsize))
+		return -1;
+	rec->size = (size_t)hsize;
+	rec->count = (len - RECORD_HEADER) / (file_off_t)rec->size;
+	return 0;
+}
+/* Open a record file.
+ */
+PRS_EXPORT record_t *open_record(const char *filename, const char *mode,
+	size_t size)
+{
+	record_t *rec;
+	const char *fmode;
+	if(strcmp(mode, "r") == 0)
+		fmode = "rbm";
+	else if(strcmp(mode, "r+") == 0)
+		fmode = "r+b";
+	else if(strcmp(mode, "w") == 0 && size != 0)
+		fmode = "w+b";
+	else
+		return NULL;
+	if((rec = (record_t*)calloc(1, sizeof(record_t))) == NULL)
+		return NULL;
+	rec->write = (mode[0] == 'w' || mode[1] == '+');
+	rec->file = open_file(filename, fmode);
+	if(rec->file == NULL || get_error_file() != FILE_ERROR_OKAY) {
+		if(rec->file != NULL)
+			close_file(rec->file);
+		free(rec);
+		return NULL;
+	}
+	if(mode[0] == 'w') {
+		rec->size = size;
+		if(_header_record(rec) < 0)
+			goto fail;
+	} else if(_load_record(rec, size) < 0) {
+		goto fail;
+	}
+	return rec;
+
+fail:
+	close_file(rec->file);
+	free(rec);
+	return NULL;
+}
+/* Write the count into the header and flush.
+ */
+PRS_EXPORT int sync_record(record_t *rec)
+{
+	if(!rec->write)
+		return 0;
+	if(_header_record(rec) < 0)
+		return -1;
+	return flush_file(rec->file);
+}
+/* Write the count into the header and close the file.
+ */
+PRS_EXPORT void close_record(record_t *rec)
+{
+	if(rec == NULL)
+		return;
+	sync_record(rec);
+	close_file(rec->file);
+	free(rec);
+}
+/* Copy record index into out.
+ */
+PRS_EXPORT int get_record(record_t *rec, file_off_t index, void *out)
+{
+	file_off_t off;
+	if(index < 0 || index >= rec->count)
+		return -1;
+	if(rec->view != NULL) {
+		memcpy(out, rec->view + (size_t)index * rec->size, rec->size);
+		return 0;
+	}
+	off = RECORD_HEADER + index * (file_off_t)rec->size;
+	if(_seek_record(rec, off, 0) < 0)
+		return -1;
+	if(read_file(rec->file, out, rec->size, 1) != 1) {
+		rec->pos = -1;
+		return -1;
+	}
+	rec->pos += (file_off_t)rec->size;
+	return 0;
+}
+/* Write record index, or add it when index is the count.
+ */
+PRS_EXPORT int put_record(record_t *rec, file_off_t index, const void *data)
+{
+	if(index == rec->count)
+		return (append_record(rec, data, 1) < 0) ? -1 : 0;
+	if(!rec->write || index < 0 || index > rec->count)
+		return -1;
+	if(_seek_record(rec, RECORD_HEADER + index * (file_off_t)rec->size,
+			1) < 0)
+		return -1;
+	if(write_file(rec->file, data, rec->size, 1) != 1) {
+		rec->pos = -1;
+		return -1;
+	}
+	rec->pos += (file_off_t)rec->size;
+	return 0;
+}
+/* Add n records at the end.
+ */
+PRS_EXPORT file_off_t append_record(record_t *rec, const void *data,
+	size_t n)
+{
+	file_off_t first = rec->count;
+	size_t done;
+	if(!rec->write)
+		return -1;
+	if(_seek_record(rec, RECORD_HEADER + first * (file_off_t)rec->size,
+			1) < 0)
+		return -1;
+	if((done = write_file(rec->file, data, rec->size, n)) != n) {
+		/* whole records that made it still count */
+		rec->count += (file_off_t)done;
+		rec->pos = -1;
+		return -1;
+	}
+	rec->count += (file_off_t)n;
+	rec->pos += (file_off_t)n * (file_off_t)rec->size;
+	return first;
+}
+/* Get the records of a file opened with "r" in place.
+ */
+PRS_EXPORT const void *get_view_record(record_t *rec, file_off_t *count)
+{
+	if(count != NULL)
+		*count = rec->count;
+	return rec->view;
+}
+/* Get the number of records.
+ */
+PRS_EXPORT file_off_t get_count_record(record_t *rec)
+{
+	return rec->count;
+}
+/* Get the size of a record in bytes.
+ */
+PRS_EXPORT size_t get_size_record(record_t *rec)
+{
+	return rec->size;
+}
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,450 @@
+/**
+ * @file scan.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Fast scanner for numbers and tokens in text files.
+ **************************************************************************
+ * @details Integers are parsed eight digits at a time when the bytes
+ * allow it. Doubles with up to 19 significant digits and a small power
+ * of ten are converted exactly with one multiply or divide, anything
+ * else is handed to strtod().
+ **************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "scan.h"
+
+#define SCAN_BUFSIZ (1 << 18)   /* bytes read from the file at once */
+#define SCAN_NUMBER 128         /* longest number looked at */
+#define SCAN_I64_MAX 0x7FFFFFFFFFFFFFFFULL
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SCAN_SWAR 1             /* eight digits per step */
+#endif
+
+/* Scanner structure.
+ */
+struct scan {
+	file_t *file;
+	const char *start;        /* first byte of the window */
+	const char *p;            /* next unread byte */
+	const char *end;          /* end of the window */
+	char *buf;                /* own buffer, NULL for a mapped view */
+	size_t cap;
+	file_off_t base;          /* file offset of start */
+	int eof;
+	int err;
+	unsigned char delim[256];
+};
+
+static const char *_scan_errors[] = {
+	"Scanner is okay (no error).",
+	"No more fields to scan.",
+	"Field is not a number.",
+	"Number is out of range.",
+	"File was unable to be read.",
+	"Cannot allocate memory."
+};
+
+/* Exact powers of ten for the fast double path.
+ */
+static const double _pow10_scan[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Create a new scanner.
+ */
+PRS_EXPORT scan_t *create_scan(file_t *file)
+{
+	const char *view;
+	scan_t *scan;
+	size_t len;
+
+	scan = (scan_t*)malloc(sizeof(scan_t));
+	if(scan == NULL) return NULL;
+	scan->file = file;
+	scan->base = tell64_file(file);
+	scan->eof = 0;
+	scan->err = SCAN_ERROR_OKAY;
+	scan->buf = NULL;
+	scan->cap = 0;
+	if((view = (const char*)get_view_file(file, &len)) != NULL) {
+		/* a mapped file is scanned in place */
+		scan->start = view;
+		scan->p = view + scan->base;
+		scan->end = view + len;
+		scan->base = 0;
+		scan->eof = 1;
+	} else {
+		scan->buf = (char*)malloc(SCAN_BUFSIZ);
+		if(scan->buf == NULL) {
+			free(scan);
+			return NULL;
+		}
+		scan->cap = SCAN_BUFSIZ;
+		scan->start = scan->p = scan->end = scan->buf;
+	}
+	set_delims_scan(scan, " \t\r\n");
+	return scan;
+}
+/* Destroy a scanner, giving unread bytes back to the file.
+ */
+PRS_EXPORT void destroy_scan(scan_t **scan)
+{
+	if(*scan == NULL) return;
+	seek64_file((*scan)->file, get_offset_scan(*scan), SEEK_SET);
+	free((*scan)->buf);
+	free(*scan);
+	*scan = NULL;
+}
+/* Set the field delimiters.
+ */
+PRS_EXPORT void set_delims_scan(scan_t *scan, const char *delims)
+{
+	memset(scan->delim, 0, sizeof(scan->delim));
+	for(; *delims != '\0'; delims++)
+		scan->delim[(unsigned char)*delims] = 1;
+}
+/* Keep unread bytes and read more; returns zero at end of file.
+ */
+static int _fill_scan(scan_t *scan)
+{
+	size_t keep, n;
+	char *buf;
+
+	if(scan->eof)
+		return 0;
+	keep = (size_t)(scan->end - scan->p);
+	scan->base += (file_off_t)(scan->p - scan->start);
+	if(keep == scan->cap) {
+		buf = (char*)realloc(scan->buf, scan->cap*2);
+		if(buf == NULL) {
+			scan->err = SCAN_ERROR_ALLOC;
+			return 0;
+		}
+		scan->p = buf + (scan->p - scan->buf);
+		scan->buf = buf;
+		scan->cap *= 2;
+	}
+	memmove(scan->buf, scan->p, keep);
+	scan->start = scan->p = scan->buf;
+	n = read_file(scan->file, scan->buf + keep, 1, scan->cap - keep);
+	scan->end = scan->buf + keep + n;
+	if(n == 0) {
+		scan->eof = 1;
+		if(get_error_file() != FILE_ERROR_OKAY)
+			scan->err = SCAN_ERROR_READ;
+	}
+	return n > 0;
+}
+/* Skip delimiters; returns -1 when no field is left.
+ */
+static int _skip_scan(scan_t *scan)
+{
+	const unsigned char *delim = scan->delim;
+	const char *p, *end;
+
+	for(;;) {
+		for(p = scan->p, end = scan->end;
+				p < end && delim[(unsigned char)*p]; p++)
+			;
+		scan->p = p;
+		if(p < end)
+			break;
+		if(!_fill_scan(scan)) {
+			if(scan->err == SCAN_ERROR_OKAY)
+				scan->err = SCAN_ERROR_END;
+			return -1;
+		}
+	}
+	/* most numbers fit, longer fields are read on when they hit the end */
+	while(scan->end - scan->p < SCAN_NUMBER && _fill_scan(scan))
+		;
+	return 0;
+}
+/* The field at p reaches the end of the window; read on until all of
+ * it is in. Returns -1 if reading failed.
+ */
+static int _whole_scan(scan_t *scan)
+{
+	const unsigned char *delim = scan->delim;
+	const char *q, *end;
+	size_t off = 0;
+
+	for(;;) {
+		for(q = scan->p + off, end = scan->end;
+				q < end && !delim[(unsigned char)*q]; q++)
+			;
+		if(q < end || scan->eof)
+			return 0;
+		off = (size_t)(q - scan->p);
+		if(!_fill_scan(scan) && scan->err != SCAN_ERROR_OKAY)
+			return -1;
+	}
+}
+/* Is this the end of the field.
+ */
+#define _end_scan(scan, q) ((q) == (scan)->end || \
+	(scan)->delim[(unsigned char)*(q)])
+#ifdef SCAN_SWAR
+/* Powers of ten for a run of digits.
+ */
+static const unsigned long long _pow10_run_scan[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL
+};
+/* Parse the run of up to eight ASCII digits at p at once; returns how
+ * many there were. A borrow or carry only moves to later bytes, so the
+ * lowest flagged byte is the first one that is not a digit.
+ */
+static int _run_scan(const char *p, unsigned long long *value)
+{
+	unsigned long long v, bad;
+	int k = 8;
+	memcpy(&v, p, 8);
+	bad = ((v + 0x4646464646464646ULL) | (v - 0x3030303030303030ULL)) &
+		0x8080808080808080ULL;
+	if(bad != 0) {
+		k = __builtin_ctzll(bad) >> 3;
+		if(k == 0) {
+			*value = 0;
+			return 0;
+		}
+		/* move the digits up, padding with leading zeros */
+		v = (v << (64 - 8*k)) | (0x3030303030303030ULL >> 8*k);
+	}
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+		(((v >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL))
+		>> 32;
+	*value = v;
+	return k;
+}
+#endif
+/* Read digits into an unsigned value, counting them; digits past the
+ * 19th are counted but not added.
+ */
+static const char *_digits_scan(const char *p, const char *end,
+	unsigned long long *value, int *count)
+{
+	unsigned long long v = *value;
+	int n = *count;
+#ifdef SCAN_SWAR
+	unsigned long long run;
+	int k = 8;
+	while(k == 8 && end - p >= 8 && n <= 11) {
+		k = _run_scan(p, &run);
+		v = v * _pow10_run_scan[k] + run;
+		p += k;
+		n += k;
+	}
+#endif
+	for(; p < end && (unsigned char)(*p - '0') < 10; p++, n++)
+		if(n < 19)
+			v = v * 10 + (unsigned long long)(*p - '0');
+	*value = v;
+	*count = n;
+	return p;
+}
+/* Get the next integer.
+ */
+PRS_EXPORT int get_i64_scan(scan_t *scan, long long *value)
+{
+	unsigned long long v = 0;
+	const char *p;
+	int neg = 0, n = 0;
+
+	scan->err = SCAN_ERROR_OKAY;
+	if(_skip_scan(scan) < 0)
+		return -1;
+	for(;;) {
+		p = scan->p;
+		if(*p == '-' || *p == '+')
+			neg = (*p++ == '-');
+		while(p < scan->end - 1 && *p == '0' &&
+				(unsigned char)(p[1] - '0') < 10)
+			p++;
+		p = _digits_scan(p, scan->end, &v, &n);
+		/* longer than the window, start over with all of it */
+		if(p < scan->end || scan->eof)
+			break;
+		if(_whole_scan(scan) < 0)
+			return -1;
+		v = 0;
+		n = 0;
+	}
+	if(n == 0 || !_end_scan(scan, p)) {
+		scan->err = SCAN_ERROR_NUMBER;
+		return -1;
+	}
+	if(n > 19 || v > SCAN_I64_MAX + neg) {
+		scan->err = SCAN_ERROR_RANGE;
+		return -1;
+	}
+	*value = neg ? (long long)(0 - v) : (long long)v;
+	scan->p = p;
+	return 0;
+}
+/* Convert the field with strtod(), for the cases the fast path skips.
+ */
+static int _strtod_scan(scan_t *scan, double *value)
+{
+	char tmp[SCAN_NUMBER+1], *str = tmp, *endp;
+	size_t len;
+	const char *q;
+	int res = 0;
+
+	for(q = scan->p; !_end_scan(scan, q); q++)
+		;
+	if(q == scan->end && !scan->eof) {
+		if(_whole_scan(scan) < 0)
+			return -1;
+		for(q = scan->p; !_end_scan(scan, q); q++)
+			;
+	}
+	len = (size_t)(q - scan->p);
+	if(len == 0) {
+		scan->err = SCAN_ERROR_NUMBER;
+		return -1;
+	}
+	if(len > SCAN_NUMBER && (str = (char*)malloc(len + 1)) == NULL) {
+		scan->err = SCAN_ERROR_ALLOC;
+		return -1;
+	}
+	memcpy(str, scan->p, len);
+	str[len] = '\0';
+	*value = strtod(str, &endp);
+	if(endp != str + len) {
+		scan->err = SCAN_ERROR_NUMBER;
+		res = -1;
+	} else {
+		scan->p = q;
+	}
+	if(str != tmp)
+		free(str);
+	return res;
+}
+/* Get the next double.
+ */
+PRS_EXPORT int get_f64_scan(scan_t *scan, double *value)
+{
+	unsigned long long m = 0;
+	const char *p, *q;
+	int neg = 0, any = 0, n = 0, exp = 0, e = 0, eneg = 0;
+	double d;
+
+	scan->err = SCAN_ERROR_OKAY;
+	if(_skip_scan(scan) < 0)
+		return -1;
+	p = scan->p;
+	if(*p == '-' || *p == '+')
+		neg = (*p++ == '-');
+	for(; p < scan->end && *p == '0'; p++)
+		any = 1;
+	p = _digits_scan(p, scan->end, &m, &n);
+	if(p < scan->end && *p == '.') {
+		q = ++p;
+		if(n == 0)
+			while(p < scan->end && *p == '0')
+				p++;
+		exp = -(int)(p - q);
+		q = p;
+		p = _digits_scan(p, scan->end, &m, &n);
+		exp -= (int)(p - q);
+		any = any || exp != 0;
+	}
+	if(!any && n == 0)
+		return _strtod_scan(scan, value);
+	if(p < scan->end && (*p == 'e' || *p == 'E')) {
+		q = p + 1;
+		if(q < scan->end && (*q == '-' || *q == '+'))
+			eneg = (*q++ == '-');
+		if(q == scan->end || (unsigned char)(*q - '0') >= 10)
+			return _strtod_scan(scan, value);
+		for(; q < scan->end && (unsigned char)(*q - '0') < 10; q++)
+			if(e < 100000)
+				e = e * 10 + (*q - '0');
+		exp += eneg ? -e : e;
+		p = q;
+	}
+	/* longer than the window, strtod() reads all of it */
+	if(p == scan->end && !scan->eof)
+		return _strtod_scan(scan, value);
+	/* exact only when the mantissa and the power of ten both are */
+	if(!_end_scan(scan, p) || n > 19 || m > (1ULL << 53) ||
+			exp < -22 || exp > 22)
+		return _strtod_scan(scan, value);
+	d = (double)m;
+	if(exp < 0)
+		d /= _pow10_scan[-exp];
+	else
+		d *= _pow10_scan[exp];
+	*value = neg ? -d : d;
+	scan->p = p;
+	return 0;
+}
+/* Get the next field as text.
+ */
+PRS_EXPORT const char *get_token_scan(scan_t *scan, size_t *len)
+{
+	const char *q;
+
+	scan->err = SCAN_ERROR_OKAY;
+	if(_skip_scan(scan) < 0 || _whole_scan(scan) < 0)
+		return NULL;
+	for(q = scan->p; !_end_scan(scan, q); q++)
+		;
+	*len = (size_t)(q - scan->p);
+	q = scan->p;
+	scan->p += *len;
+	return q;
+}
+/* Get many integers.
+ */
+PRS_EXPORT size_t get_i64s_scan(scan_t *scan, long long *values,
+	size_t count)
+{
+	size_t i;
+	for(i = 0; i < count && get_i64_scan(scan, &values[i]) == 0; i++)
+		;
+	return i;
+}
+/* Get many doubles.
+ */
+PRS_EXPORT size_t get_f64s_scan(scan_t *scan, double *values, size_t count)
+{
+	size_t i;
+	for(i = 0; i < count && get_f64_scan(scan, &values[i]) == 0; i++)
+		;
+	return i;
+}
+/* Get offset in the file of the next byte to scan.
+ */
+PRS_EXPORT file_off_t get_offset_scan(scan_t *scan)
+{
+	return scan->base + (file_off_t)(scan->p - scan->start);
+}
+/* Get error code of the last call.
+ */
+PRS_EXPORT int get_error_scan(scan_t *scan)
+{
+	return scan->err;
+}
+/* Gets the error string associated with error code.
+ */
+PRS_EXPORT const char *strerror_scan(int err)
+{
+	return _scan_errors[err];
+}
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,569 @@
+/**
+ * @file sort.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief External merge sort of lines or fixed size records.
+ **************************************************************************
+ * @details Half the memory holds the bytes of a run, the other half the
+ * items pointing at its records and the room to merge sort them; both
+ * are freed before the runs are merged, which then share all of it for
+ * read buffers, fanning in only as many as get SORT_READ_MIN each. Items
+ * carry the first eight key bytes as a big endian number, so most byte
+ * wise compares never look at the records. Runs and slices are merged
+ * through the same binary heap, ties going to the earlier source.
+ **************************************************************************
+ */
+
+#if defined(__linux) || defined(__UNIX__)
+#define _GNU_SOURCE 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "file.h"
+#include "tpool.h"
+#include "sort.h"
+
+#define SORT_MEMORY (256L << 20)    /* default bytes to sort in */
+#define SORT_MEMORY_MIN (1L << 16)  /* least bytes to sort in */
+#define SORT_FANIN 64               /* most runs merged at once */
+#define SORT_READ_MIN (1L << 14)    /* least bytes read from a run at once */
+#define SORT_READ_MAX (4L << 20)    /* most bytes read from a run at once */
+#define SORT_SLICE_MIN 16384        /* fewest items worth a thread */
+#define SORT_INSERT 16              /* slices this small use insertion */
+
+/* How to sort.
+ */
+struct sort {
+	size_t size;                /* record size, 0 for lines */
+	size_t koff;                /* key offset */
+	size_t klen;                /* key length, 0 to the end */
+	sort_cmp_t cmp;
+	void *arg;
+	size_t memory;
+	int threads;
+	char dir[MAX_PATH];
+};
+
+/* One record in memory.
+ */
+struct sort_item {
+	unsigned long long prefix;  /* first 8 key bytes, big endian */
+	const unsigned char *data;  /* the record, lines end in a newline */
+	size_t len;                 /* without the newline */
+};
+
+/* Where a merge takes records from, a sorted slice or a run file.
+ */
+struct sort_src {
+	struct sort_item item;      /* the next record */
+	struct sort_item *items;    /* slice */
+	size_t n;
+	size_t i;
+	file_t *file;               /* run */
+	unsigned char *buf;
+	size_t size;                /* room in buf */
+	size_t len;                 /* bytes in buf */
+	size_t pos;                 /* next record in buf */
+	int eof;
+};
+
+/* A slice to sort on the pool.
+ */
+struct sort_work {
+	const sort_t *sort;
+	struct sort_item *items;
+	struct sort_item *tmp;
+	size_t n;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Create a sort of records of size bytes, 0 for lines of text.
+ */
+PRS_EXPORT sort_t *create_sort(size_t size)
+{
+	sort_t *sort;
+	if((sort = (sort_t*)calloc(1, sizeof(sort_t))) == NULL)
+		return NULL;
+	sort->size = size;
+	sort->memory = SORT_MEMORY;
+	return sort;
+}
+/* Destroy a sort.
+ */
+PRS_EXPORT void destroy_sort(sort_t **sort)
+{
+	if(sort == NULL || *sort == NULL)
+		return;
+	free(*sort);
+	*sort = NULL;
+}
+/* Compare only len bytes from offset on.
+ */
+PRS_EXPORT void set_key_sort(sort_t *sort, size_t offset, size_t len)
+{
+	sort->koff = offset;
+	sort->klen = len;
+}
+/* Compare with cmp instead of bytes.
+ */
+PRS_EXPORT void set_compare_sort(sort_t *sort, sort_cmp_t cmp, void *arg)
+{
+	sort->cmp = cmp;
+	sort->arg = arg;
+}
+/* Bytes of memory to sort in.
+ */
+PRS_EXPORT int set_memory_sort(sort_t *sort, size_t bytes)
+{
+	if(bytes < (size_t)SORT_MEMORY_MIN)
+		return -1;
+	sort->memory = bytes;
+	return 0;
+}
+/* Threads sorting runs.
+ */
+PRS_EXPORT void set_threads_sort(sort_t *sort, int threads)
+{
+	sort->threads = threads;
+}
+/* Directory for temporary files.
+ */
+PRS_EXPORT int set_temp_sort(sort_t *sort, const char *dir)
+{
+	if(dir == NULL) {
+		sort->dir[0] = '\0';
+		return 0;
+	}
+	if(strlen(dir) + 16 >= MAX_PATH)
+		return -1;
+	strcpy(sort->dir, dir);
+	return 0;
+}
+/* Key bytes of an item and their count.
+ */
+static const unsigned char *_key_sort(const sort_t *sort,
+	const struct sort_item *item, size_t *len)
+{
+	size_t off = (sort->koff < item->len) ? sort->koff : item->len;
+	*len = item->len - off;
+	if(sort->klen != 0 && *len > sort->klen)
+		*len = sort->klen;
+	return item->data + off;
+}
+/* Fill in the key prefix of an item.
+ */
+static void _prefix_sort(const sort_t *sort, struct sort_item *item)
+{
+	const unsigned char *key;
+	size_t len, i;
+	item->prefix = 0;
+	if(sort->cmp != NULL)
+		return;
+	key = _key_sort(sort, item, &len);
+	for(i = 0; i < 8; i++)
+		item->prefix = (item->prefix << 8) | (i < len ? key[i] : 0);
+}
+/* Compare two items.
+ */
+static int _cmp_sort(const sort_t *sort, const struct sort_item *a,
+	const struct sort_item *b)
+{
+	const unsigned char *ka, *kb;
+	size_t na, nb;
+	int res;
+	if(sort->cmp != NULL)
+		return sort->cmp(a->data, a->len, b->data, b->len, sort->arg);
+	if(a->prefix != b->prefix)
+		return (a->prefix < b->prefix) ? -1 : 1;
+	ka = _key_sort(sort, a, &na);
+	kb = _key_sort(sort, b, &nb);
+	if(na > 8 && nb > 8 &&
+			(res = memcmp(ka + 8, kb + 8, (na < nb ? na : nb) - 8)) != 0)
+		return res;
+	return (na > nb) - (na < nb);
+}
+/* Stable merge sort of n items, tmp has room for as many.
+ */
+static void _msort_sort(const sort_t *sort, struct sort_item *items,
+	struct sort_item *tmp, size_t n)
+{
+	struct sort_item item;
+	size_t half = n / 2, i, j, k;
+	if(n <= SORT_INSERT) {
+		for(i = 1; i < n; i++) {
+			item = items[i];
+			for(j = i; j > 0 && _cmp_sort(sort, &items[j-1], &item) > 0; j--)
+				items[j] = items[j-1];
+			items[j] = item;
+		}
+		return;
+	}
+	_msort_sort(sort, items, tmp, half);
+	_msort_sort(sort, items + half, tmp + half, n - half);
+	if(_cmp_sort(sort, &items[half-1], &items[half]) <= 0)
+		return;
+	memcpy(tmp, items, half * sizeof(struct sort_item));
+	for(i = 0, j = half, k = 0; i < half && j < n; )
+		items[k++] = (_cmp_sort(sort, &items[j], &tmp[i]) < 0) ?
+			items[j++] : tmp[i++];
+	while(i < half)
+		items[k++] = tmp[i++];
+}
+/* Sort one slice on the pool.
+ */
+static void _work_sort(void *arg)
+{
+	struct sort_work *work = (struct sort_work*)arg;
+	_msort_sort(work->sort, work->items, work->tmp, work->n);
+}
+/* Open an unnamed temporary file for a run.
+ */
+static file_t *_temp_sort(const sort_t *sort)
+{
+#ifndef _WIN32
+	char path[MAX_PATH];
+	const char *dir = sort->dir;
+	file_t *file;
+	int fd;
+	if(dir[0] == '\0' && ((dir = getenv("TMPDIR")) == NULL ||
+			strlen(dir) + 16 >= MAX_PATH))
+		dir = "/tmp";
+	strcpy(path, dir);
+	strcat(path, "/prs-sortXXXXXX");
+	if((fd = mkstemp(path)) < 0)
+		return NULL;
+	unlink(path);
+	/* closes fd itself when it fails */
+	file = open_fd_file(fd, "w+b");
+#else
+	file_t *file;
+	(void)sort;
+	file = open_memfd_file("sort", "w+b");
+#endif
+	if(file != NULL && get_error_file() != FILE_ERROR_OKAY) {
+		close_file(file);
+		file = NULL;
+	}
+	return file;
+}
+/* Move a source on to its next record; 1, 0 when done or -1.
+ */
+static int _next_sort(const sort_t *sort, struct sort_src *src)
+{
+	const unsigned char *p;
+	unsigned char *grow;
+	size_t need, n;
+	if(src->file == NULL) {
+		if(src->i == src->n)
+			return 0;
+		src->item = src->items[src->i++];
+		return 1;
+	}
+	for(;;) {
+		need = sort->size;
+		if(sort->size == 0) {
+			p = (const unsigned char*)memchr(src->buf + src->pos, '\n',
+				src->len - src->pos);
+			need = (p != NULL) ? (size_t)(p - src->buf) - src->pos + 1 : 0;
+		}
+		if(need != 0 && src->len - src->pos >= need)
+			break;
+		if(src->eof)
+			return (src->pos == src->len) ? 0 : -1;
+		/* move the part record down and read on, growing for long lines */
+		memmove(src->buf, src->buf + src->pos, src->len - src->pos);
+		src->len -= src->pos;
+		src->pos = 0;
+		if(src->len == src->size) {
+			if((grow = (unsigned char*)realloc(src->buf, src->size * 2)) ==
+					NULL)
+				return -1;
+			src->buf = grow;
+			src->size *= 2;
+		}
+		if((n = read_file(src->file, src->buf + src->len, 1,
+				src->size - src->len)) == 0)
+			src->eof = 1;
+		src->len += n;
+	}
+	src->item.data = src->buf + src->pos;
+	src->item.len = (sort->size == 0) ? need - 1 : need;
+	src->pos += need;
+	_prefix_sort(sort, &src->item);
+	return 1;
+}
+/* Whether source a comes out before source b.
+ */
+static int _less_sort(const sort_t *sort, const struct sort_src *srcs,
+	int a, int b)
+{
+	int res = _cmp_sort(sort, &srcs[a].item, &srcs[b].item);
+	return res < 0 || (res == 0 && a < b);
+}
+/* Restore the heap below slot i.
+ */
+static void _sift_sort(const sort_t *sort, const struct sort_src *srcs,
+	int *heap, int n, int i)
+{
+	int c, top = heap[i];
+	while((c = 2 * i + 1) < n) {
+		if(c + 1 < n && _less_sort(sort, srcs, heap[c+1], heap[c]))
+			c++;
+		if(!_less_sort(sort, srcs, heap[c], top))
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = top;
+}
+/* Merge n sources into out; returns records written or -1.
+ */
+static file_off_t _merge_sort(const sort_t *sort, struct sort_src *srcs,
+	int n, file_t *out)
+{
+	file_off_t count = 0;
+	size_t len;
+	int *heap, nheap = 0, i, res = 0;
+	if((heap = (int*)malloc(n * sizeof(int))) == NULL)
+		return -1;
+	for(i = 0; i < n; i++) {
+		if((res = _next_sort(sort, &srcs[i])) < 0)
+			break;
+		if(res > 0)
+			heap[nheap++] = i;
+	}
+	for(i = nheap / 2 - 1; res >= 0 && i >= 0; i--)
+		_sift_sort(sort, srcs, heap, nheap, i);
+	while(res >= 0 && nheap > 0) {
+		i = heap[0];
+		len = srcs[i].item.len + (sort->size == 0);
+		if(write_file(out, srcs[i].item.data, 1, len) != len) {
+			res = -1;
+			break;
+		}
+		count++;
+		if((res = _next_sort(sort, &srcs[i])) == 0)
+			heap[0] = heap[--nheap];
+		if(res >= 0 && nheap > 0)
+			_sift_sort(sort, srcs, heap, nheap, 0);
+	}
+	free(heap);
+	return (res < 0) ? -1 : count;
+}
+/* Merge runs[0..n) into out with read buffers sharing the memory.
+ */
+static file_off_t _merge_runs_sort(const sort_t *sort, file_t **runs, int n,
+	file_t *out)
+{
+	struct sort_src *srcs;
+	file_off_t count = -1;
+	size_t size = sort->memory / (size_t)(n + 1);
+	int i;
+	if(size < (size_t)SORT_READ_MIN)
+		size = SORT_READ_MIN;
+	if(size > (size_t)SORT_READ_MAX)
+		size = SORT_READ_MAX;
+	if((srcs = (struct sort_src*)calloc(n, sizeof(struct sort_src))) == NULL)
+		return -1;
+	for(i = 0; i < n; i++) {
+		srcs[i].file = runs[i];
+		srcs[i].size = size;
+		if((srcs[i].buf = (unsigned char*)malloc(size)) == NULL ||
+				flush_file(runs[i]) != 0 || seek64_file(runs[i], 0, SEEK_SET) < 0)
+			break;
+	}
+	if(i == n)
+		count = _merge_sort(sort, srcs, n, out);
+	for(i = 0; i < n; i++)
+		free(srcs[i].buf);
+	free(srcs);
+	return count;
+}
+/* Sort the items of a run in slices on the pool and merge them to out.
+ */
+static file_off_t _run_sort(const sort_t *sort, tpool_t *pool,
+	struct sort_item *items, struct sort_item *tmp, size_t n, file_t *out)
+{
+	struct sort_work work[SORT_FANIN];
+	struct sort_src srcs[SORT_FANIN];
+	size_t per;
+	int i, slices = 1;
+	if(pool != NULL) {
+		slices = get_threads_tpool(pool);
+		if(slices > SORT_FANIN)
+			slices = SORT_FANIN;
+		if((size_t)slices > n / SORT_SLICE_MIN)
+			slices = (int)(n / SORT_SLICE_MIN);
+		if(slices < 1)
+			slices = 1;
+	}
+	per = (n + (size_t)slices - 1) / (size_t)slices;
+	memset(srcs, 0, sizeof(srcs));
+	for(i = 0; i < slices; i++) {
+		work[i].sort = sort;
+		work[i].items = items + per * (size_t)i;
+		work[i].tmp = tmp + per * (size_t)i;
+		work[i].n = (i == slices - 1) ? n - per * (size_t)i : per;
+		srcs[i].items = work[i].items;
+		srcs[i].n = work[i].n;
+		if(slices == 1 || add_tpool(pool, _work_sort, &work[i]) != 0)
+			_work_sort(&work[i]);
+	}
+	if(slices > 1)
+		wait_tpool(pool);
+	return _merge_sort(sort, srcs, slices, out);
+}
+/* Add a run to the list, growing it.
+ */
+static int _push_sort(file_t ***runs, int *n, int *cap, file_t *run)
+{
+	file_t **grow;
+	if(*n == *cap) {
+		*cap = (*cap == 0) ? 16 : *cap * 2;
+		if((grow = (file_t**)realloc(*runs, *cap * sizeof(file_t*))) == NULL)
+			return -1;
+		*runs = grow;
+	}
+	(*runs)[(*n)++] = run;
+	return 0;
+}
+/* Sort in from its current position into out.
+ */
+PRS_EXPORT file_off_t sort_file(file_t *in, file_t *out, sort_t *sort)
+{
+	struct sort_item *items = NULL, *tmp;
+	unsigned char *buf = NULL, *grow;
+	const unsigned char *p, *q, *end;
+	file_t **runs = NULL, *run;
+	tpool_t *pool = NULL;
+	file_off_t count = -1;
+	size_t cap, len = 0, used, n, max, rec;
+	int nruns = 0, rcap = 0, eof = 0, fanin, i, j, k, m;
+
+	if(in == NULL || out == NULL || sort == NULL)
+		return -1;
+	cap = sort->memory / 2;
+	max = sort->memory / 2 / (2 * sizeof(struct sort_item));
+	if(sort->size > cap)
+		cap = sort->size;
+	if((buf = (unsigned char*)malloc(cap + 1)) == NULL ||
+			(items = (struct sort_item*)malloc(2 * max *
+			sizeof(struct sort_item))) == NULL)
+		goto done;
+	tmp = items + max;
+	if(sort->threads != 1 && (pool = create_tpool(sort->threads)) == NULL)
+		goto done;
+
+	/* sorted runs, spilled unless the input fits in the first */
+	for(;;) {
+		while(len < cap && !eof) {
+			if((n = read_file(in, buf + len, 1, cap - len)) == 0)
+				eof = 1;
+			len += n;
+		}
+		p = buf;
+		end = buf + len;
+		for(n = 0; n < max && p < end; n++, p += rec) {
+			if(sort->size != 0) {
+				if((size_t)(end - p) < sort->size)
+					break;
+				rec = sort->size;
+				items[n].len = rec;
+			} else {
+				if((q = (const unsigned char*)memchr(p, '\n', end - p)) ==
+						NULL) {
+					if(!eof)
+						break;
+					/* the last line, give it its newline */
+					buf[len++] = '\n';
+					q = end++;
+				}
+				rec = (size_t)(q - p) + 1;
+				items[n].len = rec - 1;
+			}
+			items[n].data = p;
+			_prefix_sort(sort, &items[n]);
+		}
+		used = (size_t)(p - buf);
+		if(n == 0) {
+			if(eof) {
+				if(len != 0)
+					goto done;  /* a part record */
+				break;
+			}
+			/* a line longer than the buffer */
+			if((grow = (unsigned char*)realloc(buf, cap * 2 + 1)) == NULL)
+				goto done;
+			buf = grow;
+			cap *= 2;
+			continue;
+		}
+		if(nruns == 0 && eof && used == len) {
+			/* all of it in memory, straight out */
+			count = _run_sort(sort, pool, items, tmp, n, out);
+			goto done;
+		}
+		if((run = _temp_sort(sort)) == NULL ||
+				_push_sort(&runs, &nruns, &rcap, run) < 0) {
+			if(run != NULL)
+				close_file(run);
+			goto done;
+		}
+		if(_run_sort(sort, pool, items, tmp, n, run) < 0)
+			goto done;
+		memmove(buf, buf + used, len - used);
+		len -= used;
+	}
+	destroy_tpool(&pool);
+	/* the merge gets all of the memory for its read buffers */
+	free(items);
+	items = NULL;
+	free(buf);
+	buf = NULL;
+	n = sort->memory / SORT_READ_MIN - 1;
+	fanin = (n < SORT_FANIN) ? (int)n : SORT_FANIN;
+
+	/* merge passes until few enough runs are left for the last one; a
+	 * merged run takes the place of its sources, so ties keep in order */
+	while(nruns > fanin) {
+		for(i = 0, k = 0; i < nruns; i += m, k++) {
+			m = (nruns - i < fanin) ? nruns - i : fanin;
+			run = runs[i];
+			if(m > 1 && ((run = _temp_sort(sort)) == NULL ||
+					_merge_runs_sort(sort, runs + i, m, run) < 0)) {
+				if(run != NULL)
+					close_file(run);
+				memmove(runs + k, runs + i, (nruns - i) * sizeof(file_t*));
+				nruns = k + nruns - i;
+				goto done;
+			}
+			for(j = 0; m > 1 && j < m; j++)
+				close_file(runs[i + j]);
+			runs[k] = run;
+		}
+		nruns = k;
+	}
+	count = (nruns == 0) ? 0 : _merge_runs_sort(sort, runs, nruns, out);
+
+done:
+	if(pool != NULL)
+		destroy_tpool(&pool);
+	for(i = 0; i < nruns; i++)
+		close_file(runs[i]);
+	free(runs);
+	free(items);
+	free(buf);
+	return count;
+}
+#ifdef __cplusplus
+}
+#endif
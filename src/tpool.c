@@ -0,0 +1,181 @@
+/**
+ * @file tpool.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Simple worker thread pool.
+ **************************************************************************
+ * @details Jobs are kept in a linked list, workers sleep on a condition
+ * variable until there is work or the pool is being destroyed.
+ **************************************************************************
+ */
+
+#if defined(__linux) || defined(__UNIX__)
+#define _GNU_SOURCE 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "tpool.h"
+
+/* Job waiting in the pool.
+ */
+struct tpool_job {
+	struct tpool_job *next;
+	void (*func)(void *arg);
+	void *arg;
+};
+/* Worker thread pool structure.
+ */
+struct tpool {
+	pthread_mutex_t lock;
+	pthread_cond_t work;      /* signalled when a job is added */
+	pthread_cond_t idle;      /* signalled when the last job finishes */
+	struct tpool_job *head;
+	struct tpool_job *tail;
+	unsigned int busy;        /* jobs queued or running */
+	int stop;
+	int nthreads;
+	pthread_t *threads;
+};
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Worker thread, runs jobs until the pool stops.
+ */
+static void *_worker_tpool(void *arg)
+{
+	tpool_t *pool = (tpool_t*)arg;
+	struct tpool_job *job;
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;) {
+		while(pool->head == NULL && !pool->stop)
+			pthread_cond_wait(&pool->work, &pool->lock);
+		if(pool->head == NULL)
+			break;
+		job = pool->head;
+		if((pool->head = job->next) == NULL)
+			pool->tail = NULL;
+		pthread_mutex_unlock(&pool->lock);
+		job->func(job->arg);
+		free(job);
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->busy == 0)
+			pthread_cond_broadcast(&pool->idle);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+/* Get number of CPUs available.
+ */
+PRS_EXPORT int get_cpus_tpool(void)
+{
+	long n;
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	n = (long)info.dwNumberOfProcessors;
+#else
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (n < 1) ? 1 : (int)n;
+}
+/* Create the thread pool.
+ */
+PRS_EXPORT tpool_t *create_tpool(int threads)
+{
+	tpool_t *pool;
+	if(threads <= 0)
+		threads = get_cpus_tpool();
+	pool = (tpool_t*)malloc(sizeof(tpool_t));
+	if(pool == NULL) return NULL;
+	pool->threads = (pthread_t*)malloc(sizeof(pthread_t)*threads);
+	if(pool->threads == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+	pool->head = NULL;
+	pool->tail = NULL;
+	pool->busy = 0;
+	pool->stop = 0;
+	for(pool->nthreads = 0; pool->nthreads < threads; pool->nthreads++)
+		if(pthread_create(&pool->threads[pool->nthreads], NULL,
+				_worker_tpool, pool) != 0)
+			break;
+	if(pool->nthreads == 0) {
+		destroy_tpool(&pool);
+		return NULL;
+	}
+	return pool;
+}
+/* Add a job to the end of the queue.
+ */
+PRS_EXPORT int add_tpool(tpool_t *pool, void (*func)(void *arg), void *arg)
+{
+	struct tpool_job *job;
+	if(pool == NULL || func == NULL) return -1;
+	job = (struct tpool_job*)malloc(sizeof(struct tpool_job));
+	if(job == NULL) return -1;
+	job->next = NULL;
+	job->func = func;
+	job->arg = arg;
+	pthread_mutex_lock(&pool->lock);
+	if(pool->tail != NULL)
+		pool->tail->next = job;
+	else
+		pool->head = job;
+	pool->tail = job;
+	pool->busy++;
+	pthread_cond_signal(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+/* Wait until the pool has nothing queued or running.
+ */
+PRS_EXPORT void wait_tpool(tpool_t *pool)
+{
+	if(pool == NULL) return;
+	pthread_mutex_lock(&pool->lock);
+	while(pool->busy > 0)
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+/* Destroy the pool, queued jobs are run first.
+ */
+PRS_EXPORT void destroy_tpool(tpool_t **pool)
+{
+	int i;
+	if(*pool == NULL) return;
+	pthread_mutex_lock(&(*pool)->lock);
+	(*pool)->stop = 1;
+	pthread_cond_broadcast(&(*pool)->work);
+	pthread_mutex_unlock(&(*pool)->lock);
+	for(i = 0; i < (*pool)->nthreads; i++)
+		pthread_join((*pool)->threads[i], NULL);
+	pthread_mutex_destroy(&(*pool)->lock);
+	pthread_cond_destroy(&(*pool)->work);
+	pthread_cond_destroy(&(*pool)->idle);
+	free((*pool)->threads);
+	free(*pool);
+	*pool = NULL;
+}
+/* Get number of threads in pool.
+ */
+PRS_EXPORT int get_threads_tpool(tpool_t *pool)
+{
+	return pool->nthreads;
+}
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,362 @@
+/**
+ * @file utf8.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Checking UTF-8 text and converting it to UTF-16 and UTF-32.
+ **************************************************************************
+ * @details Checking uses the lookup method of Keiser and Lemire: three
+ * table lookups, on the high and low nibble of the byte before and the
+ * high nibble of each byte, flag every bad pair of bytes at once, and a
+ * saturating subtract finds third and fourth bytes that are missing or
+ * extra. Blocks of ASCII only test the top bits. The exact place of an
+ * error is found by decoding one character at a time from the last
+ * boundary before the bad block, which is also how the tail is done.
+ **************************************************************************
+ */
+
+#include <string.h>
+
+#include "utf8.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define UTF8_SIMD 1             /* SSE2 is always there on x86_64 */
+#endif
+
+/* What a pair of bytes can be wrong with; each table entry holds the
+ * errors its nibble allows, so only bits set in all three are real.
+ */
+#define UTF8_TOO_SHORT  0x01    /* lead not followed by a continuation */
+#define UTF8_TOO_LONG   0x02    /* ASCII followed by a continuation */
+#define UTF8_OVERLONG_3 0x04    /* E0 followed by 80..9F */
+#define UTF8_TOO_LARGE  0x08    /* past U+10FFFF */
+#define UTF8_SURROGATE  0x10    /* ED followed by A0..BF */
+#define UTF8_OVERLONG_2 0x20    /* C0 or C1 */
+#define UTF8_LARGE_1000 0x40    /* past U+10FFFF with a second byte 8x */
+#define UTF8_OVERLONG_4 0x40    /* F0 followed by 80..8F */
+#define UTF8_TWO_CONTS  0x80    /* continuation after a continuation */
+#define UTF8_CARRY      (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#ifdef UTF8_SIMD
+/* Errors by the high nibble of the first byte.
+ */
+static const unsigned char _high1_utf8[16] = {
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+	UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+	UTF8_TOO_SHORT,
+	UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+	UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_LARGE_1000 | UTF8_OVERLONG_4
+};
+/* Errors by the low nibble of the first byte.
+ */
+static const unsigned char _low1_utf8[16] = {
+	UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+	UTF8_CARRY | UTF8_OVERLONG_2,
+	UTF8_CARRY,
+	UTF8_CARRY,
+	UTF8_CARRY | UTF8_TOO_LARGE,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000 | UTF8_SURROGATE,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_LARGE_1000
+};
+/* Errors by the high nibble of the second byte.
+ */
+static const unsigned char _high2_utf8[16] = {
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 |
+		UTF8_LARGE_1000 | UTF8_OVERLONG_4,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 |
+		UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE |
+		UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE |
+		UTF8_TOO_LARGE,
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+/* Largest bytes that may end a block; the last three must not start a
+ * character longer than what is left of the block.
+ */
+static const unsigned char _last_utf8[32] = {
+	255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 0xEF, 0xDF, 0xBF
+};
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Decode the character at p, left bytes long at most; returns its length
+ * with the code point in *cp, or zero if it is not well formed.
+ */
+static size_t _one_utf8(const unsigned char *p, size_t left,
+	unsigned int *cp)
+{
+	unsigned int c = p[0];
+	if(c < 0x80) {
+		*cp = c;
+		return 1;
+	}
+	if(c < 0xC2 || c > 0xF4)
+		return 0;
+	if(c < 0xE0) {
+		if(left < 2 || (p[1] & 0xC0) != 0x80)
+			return 0;
+		*cp = ((c & 0x1F) << 6) | (p[1] & 0x3F);
+		return 2;
+	}
+	if(c < 0xF0) {
+		if(left < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 ||
+				(c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] > 0x9F))
+			return 0;
+		*cp = ((c & 0x0F) << 12) | ((p[1] & 0x3Fu) << 6) | (p[2] & 0x3F);
+		return 3;
+	}
+	if(left < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 ||
+			(p[3] & 0xC0) != 0x80 || (c == 0xF0 && p[1] < 0x90) ||
+			(c == 0xF4 && p[1] > 0x8F))
+		return 0;
+	*cp = ((c & 0x07) << 18) | ((p[1] & 0x3Fu) << 12) |
+		((p[2] & 0x3Fu) << 6) | (p[3] & 0x3F);
+	return 4;
+}
+/* Check from i, which is on a character boundary, one at a time.
+ */
+static size_t _scalar_utf8(const unsigned char *p, size_t i, size_t len)
+{
+	unsigned long long word;
+	unsigned int cp;
+	size_t n;
+	while(i < len) {
+		if(p[i] < 0x80) {
+			/* skip ASCII a word at a time */
+			for(i++; i + 8 <= len; i += 8) {
+				memcpy(&word, p + i, 8);
+				if(word & 0x8080808080808080ULL)
+					break;
+			}
+			continue;
+		}
+		if((n = _one_utf8(p + i, len - i, &cp)) == 0)
+			return i;
+		i += n;
+	}
+	return len;
+}
+#ifdef UTF8_SIMD
+/* Check sixteen bytes at a time; returns the start of the first bad
+ * block, or where it stopped.
+ */
+__attribute__((target("ssse3")))
+static size_t _ssse3_utf8(const unsigned char *p, size_t len)
+{
+	const __m128i high1 = _mm_loadu_si128((const __m128i*)_high1_utf8);
+	const __m128i low1 = _mm_loadu_si128((const __m128i*)_low1_utf8);
+	const __m128i high2 = _mm_loadu_si128((const __m128i*)_high2_utf8);
+	const __m128i last = _mm_loadu_si128((const __m128i*)(_last_utf8+16));
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i in, prev = zero, cut = zero, prev1, err;
+	size_t i;
+	for(i = 0; i + 16 <= len; i += 16) {
+		in = _mm_loadu_si128((const __m128i*)(p + i));
+		if(_mm_movemask_epi8(in) == 0) {
+			/* ASCII, fine unless the last block left a character open */
+			err = cut;
+			cut = zero;
+		} else {
+			prev1 = _mm_alignr_epi8(in, prev, 15);
+			err = _mm_and_si128(_mm_and_si128(
+				_mm_shuffle_epi8(high1, _mm_and_si128(
+					_mm_srli_epi16(prev1, 4), nibble)),
+				_mm_shuffle_epi8(low1, _mm_and_si128(prev1, nibble))),
+				_mm_shuffle_epi8(high2, _mm_and_si128(
+					_mm_srli_epi16(in, 4), nibble)));
+			/* third and fourth bytes must be continuations, others not */
+			err = _mm_xor_si128(err, _mm_and_si128(_mm_or_si128(
+				_mm_subs_epu8(_mm_alignr_epi8(in, prev, 14),
+					_mm_set1_epi8(0xE0 - 0x80)),
+				_mm_subs_epu8(_mm_alignr_epi8(in, prev, 13),
+					_mm_set1_epi8(0xF0 - 0x80))),
+				_mm_set1_epi8((char)0x80)));
+			cut = _mm_subs_epu8(in, last);
+		}
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(err, zero)) != 0xFFFF)
+			break;
+		prev = in;
+	}
+	return i;
+}
+/* Check thirty two bytes at a time; returns the start of the first bad
+ * block, or where it stopped.
+ */
+__attribute__((target("avx2")))
+static size_t _avx2_utf8(const unsigned char *p, size_t len)
+{
+	const __m256i high1 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i*)_high1_utf8));
+	const __m256i low1 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i*)_low1_utf8));
+	const __m256i high2 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i*)_high2_utf8));
+	const __m256i last = _mm256_loadu_si256((const __m256i*)_last_utf8);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i in, prev = zero, cut = zero, half, prev1, err;
+	size_t i;
+	for(i = 0; i + 32 <= len; i += 32) {
+		in = _mm256_loadu_si256((const __m256i*)(p + i));
+		if(_mm256_movemask_epi8(in) == 0) {
+			err = cut;
+			cut = zero;
+		} else {
+			/* bytes before each lane come from the lane before it */
+			half = _mm256_permute2x128_si256(prev, in, 0x21);
+			prev1 = _mm256_alignr_epi8(in, half, 15);
+			err = _mm256_and_si256(_mm256_and_si256(
+				_mm256_shuffle_epi8(high1, _mm256_and_si256(
+					_mm256_srli_epi16(prev1, 4), nibble)),
+				_mm256_shuffle_epi8(low1, _mm256_and_si256(prev1,
+					nibble))),
+				_mm256_shuffle_epi8(high2, _mm256_and_si256(
+					_mm256_srli_epi16(in, 4), nibble)));
+			err = _mm256_xor_si256(err, _mm256_and_si256(_mm256_or_si256(
+				_mm256_subs_epu8(_mm256_alignr_epi8(in, half, 14),
+					_mm256_set1_epi8(0xE0 - 0x80)),
+				_mm256_subs_epu8(_mm256_alignr_epi8(in, half, 13),
+					_mm256_set1_epi8(0xF0 - 0x80))),
+				_mm256_set1_epi8((char)0x80)));
+			cut = _mm256_subs_epu8(in, last);
+		}
+		if(!_mm256_testz_si256(err, err))
+			break;
+		prev = in;
+	}
+	return i;
+}
+#endif
+/* Check len bytes of UTF-8.
+ */
+PRS_EXPORT size_t check_utf8(const void *buf, size_t len)
+{
+	const unsigned char *p = (const unsigned char*)buf;
+	size_t i = 0;
+#ifdef UTF8_SIMD
+	if(len >= 32 && __builtin_cpu_supports("avx2"))
+		i = _avx2_utf8(p, len);
+	else if(len >= 16 && __builtin_cpu_supports("ssse3"))
+		i = _ssse3_utf8(p, len);
+	/* errors show up a block late for a character crossing into it */
+	i = split_utf8(p, i);
+#endif
+	return _scalar_utf8(p, i, len);
+}
+/* Find where the last whole character of buf ends.
+ */
+PRS_EXPORT size_t split_utf8(const void *buf, size_t len)
+{
+	const unsigned char *p = (const unsigned char*)buf;
+	size_t j, need;
+	for(j = len; j > 0 && len - j < 3; j--) {
+		if((p[j-1] & 0xC0) == 0x80)
+			continue;
+		if(p[j-1] < 0xC0)
+			return len;
+		need = (p[j-1] < 0xE0) ? 2 : (p[j-1] < 0xF0) ? 3 : 4;
+		return (j - 1 + need > len) ? j - 1 : len;
+	}
+	return len;
+}
+/* Convert len bytes of UTF-8 to UTF-16.
+ */
+PRS_EXPORT size_t decode16_utf8(const void *src, size_t len,
+	unsigned short *dst)
+{
+	const unsigned char *p = (const unsigned char*)src;
+	size_t i = 0, n = 0, k;
+	unsigned int cp;
+#ifdef UTF8_SIMD
+	const __m128i zero = _mm_setzero_si128();
+	__m128i in;
+#endif
+	while(i < len) {
+#ifdef UTF8_SIMD
+		/* runs of ASCII are widened sixteen at a time */
+		for(; p[i] < 0x80 && i + 16 <= len; i += 16, n += 16) {
+			in = _mm_loadu_si128((const __m128i*)(p + i));
+			if(_mm_movemask_epi8(in) != 0)
+				break;
+			_mm_storeu_si128((__m128i*)(dst + n),
+				_mm_unpacklo_epi8(in, zero));
+			_mm_storeu_si128((__m128i*)(dst + n + 8),
+				_mm_unpackhi_epi8(in, zero));
+		}
+		if(i >= len)
+			break;
+#endif
+		if((k = _one_utf8(p + i, len - i, &cp)) == 0)
+			return (size_t)-1;
+		i += k;
+		if(cp >= 0x10000) {
+			cp -= 0x10000;
+			dst[n++] = (unsigned short)(0xD800 | (cp >> 10));
+			dst[n++] = (unsigned short)(0xDC00 | (cp & 0x3FF));
+		} else {
+			dst[n++] = (unsigned short)cp;
+		}
+	}
+	return n;
+}
+/* Convert len bytes of UTF-8 to UTF-32.
+ */
+PRS_EXPORT size_t decode32_utf8(const void *src, size_t len,
+	unsigned int *dst)
+{
+	const unsigned char *p = (const unsigned char*)src;
+	size_t i = 0, n = 0, k;
+#ifdef UTF8_SIMD
+	const __m128i zero = _mm_setzero_si128();
+	__m128i in, lo, hi;
+#endif
+	while(i < len) {
+#ifdef UTF8_SIMD
+		for(; p[i] < 0x80 && i + 16 <= len; i += 16, n += 16) {
+			in = _mm_loadu_si128((const __m128i*)(p + i));
+			if(_mm_movemask_epi8(in) != 0)
+				break;
+			lo = _mm_unpacklo_epi8(in, zero);
+			hi = _mm_unpackhi_epi8(in, zero);
+			_mm_storeu_si128((__m128i*)(dst + n),
+				_mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128((__m128i*)(dst + n + 4),
+				_mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128((__m128i*)(dst + n + 8),
+				_mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128((__m128i*)(dst + n + 12),
+				_mm_unpackhi_epi16(hi, zero));
+		}
+		if(i >= len)
+			break;
+#endif
+		if((k = _one_utf8(p + i, len - i, &dst[n])) == 0)
+			return (size_t)-1;
+		i += k;
+		n++;
+	}
+	return n;
+}
+#ifdef __cplusplus
+}
+#endif
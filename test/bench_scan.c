@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "file.h"
+#include "scan.h"
+
+#define ROWS 2000000
+#define RUNS 3          /* best of, both are timed the same */
+
+/* Compare readf_file("%d %lf") against the scanner. */
+int
+main (void)
+{
+    double t_readf = 0, t_scan = 0, d, sum1 = 0, sum2 = 0, s;
+    long long v;
+    scan_t *scan;
+    file_t *file;
+    clock_t t;
+    int i, n, r;
+
+    file = open_file("bench_scan.txt", "wt");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Cannot open file: %s\n", strerror_file(get_error_file()));
+        return 1;
+    }
+    for(i = 0; i < ROWS; i++)
+        writef_file(file, "%d %f\n", i * 37 - 5000, i * 0.125);
+    close_file(file);
+
+    for(r = 0; r < RUNS; r++) {
+        file = open_file("bench_scan.txt", "rt");
+        sum1 = 0;
+        t = clock();
+        while(readf_file(file, "%d %lf", &n, &d) == 2)
+            sum1 += n + d;
+        s = (double)(clock() - t) / CLOCKS_PER_SEC;
+        t_readf = (r == 0 || s < t_readf) ? s : t_readf;
+        close_file(file);
+
+        file = open_file("bench_scan.txt", "rt");
+        sum2 = 0;
+        t = clock();
+        scan = create_scan(file);
+        while(get_i64_scan(scan, &v) == 0 && get_f64_scan(scan, &d) == 0)
+            sum2 += v + d;
+        destroy_scan(&scan);
+        s = (double)(clock() - t) / CLOCKS_PER_SEC;
+        t_scan = (r == 0 || s < t_scan) ? s : t_scan;
+        close_file(file);
+    }
+    remove("bench_scan.txt");
+
+    printf("readf_file: %.3fs\nscan:       %.3fs\nspeedup:    %.1fx\n",
+        t_readf, t_scan, t_readf / (t_scan > 0 ? t_scan : 1e-9));
+    return sum1 != sum2;
+}
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <time.h>
+#include "file.h"
+
+#define ROWS 2000000
+
+/* Compare writef_file("%lld %.17g\n") against the typed writers. */
+int
+main (void)
+{
+    double t_writef, t_typed;
+    file_t *file;
+    clock_t t;
+    int i;
+
+    file = open_file("bench_write.txt", "wt");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Cannot open file: %s\n", strerror_file(get_error_file()));
+        return 1;
+    }
+    t = clock();
+    for(i = 0; i < ROWS; i++)
+        writef_file(file, "%lld %.17g\n", (long long)i * 7919 - 5000,
+            i * 0.1 + 0.5);
+    flush_file(file);
+    t_writef = (double)(clock() - t) / CLOCKS_PER_SEC;
+    close_file(file);
+
+    file = open_file("bench_write.txt", "wt");
+    t = clock();
+    for(i = 0; i < ROWS; i++) {
+        write_i64_file(file, (long long)i * 7919 - 5000);
+        write_str_file(file, " ");
+        write_f64_file(file, i * 0.1 + 0.5);
+        write_str_file(file, "\n");
+    }
+    flush_file(file);
+    t_typed = (double)(clock() - t) / CLOCKS_PER_SEC;
+    close_file(file);
+    remove("bench_write.txt");
+
+    printf("writef_file: %.3fs\ntyped:       %.3fs\nspeedup:     %.1fx\n",
+        t_writef, t_typed, t_writef / (t_typed > 0 ? t_typed : 1e-9));
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+
+#define BLOCKS 64
+#define BLOCK  4096
+
+static char out[BLOCKS][BLOCK];
+static char in[BLOCKS][BLOCK];
+static int written, readback, failed;
+
+static void
+write_done (file_t *file, void *buf, file_off_t bytes, int err,
+    void *data)
+{
+    (void)file; (void)buf; (void)data;
+    if(err != FILE_ERROR_OKAY || bytes != BLOCK)
+        failed++;
+    written++;
+}
+
+static void
+read_done (file_t *file, void *buf, file_off_t bytes, int err,
+    void *data)
+{
+    long i = (long)data;
+    (void)file;
+    if(err != FILE_ERROR_OKAY || bytes != BLOCK ||
+            memcmp(buf, out[i], BLOCK) != 0)
+        failed++;
+    readback++;
+}
+
+/* program to test asynchronous reads and writes */
+int
+main ()
+{
+    file_t *f;
+    long i;
+
+    f = open_file("test10.bin", "w+b");
+    if(get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    for(i = 0; i < BLOCKS; i++) {
+        memset(out[i], (int)('A' + i % 26), BLOCK);
+        if(submit_write_file(f, out[i], BLOCK, i*BLOCK, write_done, NULL))
+            goto error;
+    }
+    while(written < BLOCKS)
+        reap_file(1);
+    if(get_size_file(f) != BLOCKS*BLOCK)
+        goto error;
+
+    /* read back in reverse order */
+    for(i = BLOCKS-1; i >= 0; i--)
+        if(submit_read_file(f, in[i], BLOCK, i*BLOCK, read_done, (void*)i))
+            goto error;
+    while(readback < BLOCKS)
+        reap_file(1);
+    if(failed || reap_file(0) != 0)
+        goto error;
+
+    /* closing waits for the requests still out and runs their callbacks */
+    readback = 0;
+    for(i = 0; i < BLOCKS; i++)
+        if(submit_read_file(f, in[i], BLOCK, i*BLOCK, read_done, (void*)i))
+            goto error;
+    remove(get_name_file(f));
+    close_file(f);
+    if(failed || readback != BLOCKS || reap_file(0) != 0) {
+        printf("Error: requests not finished on close.\n");
+        return 1;
+    }
+    printf("Asynchronous requests completed.\n");
+    return 0;
+
+error:
+    printf("Error: asynchronous requests failed.\n");
+    remove(get_name_file(f));
+    close_file(f);
+    return 1;
+}
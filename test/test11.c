@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include "tpool.h"
+
+#define JOBS 1000
+
+static long results[JOBS];
+
+static void
+square (void *arg)
+{
+    long *n = (long*)arg;
+    *n = (*n) * (*n);
+}
+
+/* program to test the worker thread pool */
+int
+main ()
+{
+    tpool_t *pool;
+    long i;
+
+    pool = create_tpool(4);
+    if(pool == NULL || get_threads_tpool(pool) != 4)
+        return 1;
+    for(i = 0; i < JOBS; i++) {
+        results[i] = i;
+        if(add_tpool(pool, square, &results[i]) != 0) {
+            destroy_tpool(&pool);
+            return 1;
+        }
+    }
+    wait_tpool(pool);
+    destroy_tpool(&pool);
+    for(i = 0; i < JOBS; i++)
+        if(results[i] != i*i) {
+            printf("Error: job %ld gave %ld.\n", i, results[i]);
+            return 1;
+        }
+    printf("Thread pool ran %d jobs.\n", JOBS);
+    return pool != NULL;
+}
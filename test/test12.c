@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+
+/* program to test vectored reads and writes */
+int
+main ()
+{
+    static char body[100000];
+    char head[16], tail[4], got_head[16], got_body[sizeof(body)];
+    file_vec_t vec[3];
+    file_t *f;
+
+    f = open_file("test12.bin", "w+b");
+    if(get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    memcpy(head, "record header 1", 16);
+    memset(body, 'b', sizeof(body));
+    memcpy(tail, "end", 4);
+    vec[0].buf = head;
+    vec[0].len = sizeof(head);
+    vec[1].buf = body;
+    vec[1].len = sizeof(body);
+    vec[2].buf = tail;
+    vec[2].len = 0;
+
+    /* buffered writes before and after keep their order */
+    write_file(f, "start", 1, 5);
+    if(writev_file(f, vec, 3) != sizeof(head)+sizeof(body))
+        goto error;
+    write_file(f, tail, 1, sizeof(tail));
+    if(tell_file(f) != (long)(5+sizeof(head)+sizeof(body)+sizeof(tail)) ||
+            get_size_file(f) != tell_file(f))
+        goto error;
+
+    seek_file(f, 5, SEEK_SET);
+    vec[0].buf = got_head;
+    vec[1].buf = got_body;
+    vec[2].len = sizeof(tail);
+    if(readv_file(f, vec, 3) != sizeof(head)+sizeof(body)+4 ||
+            memcmp(got_head, head, sizeof(head)) != 0 ||
+            memcmp(got_body, body, sizeof(body)) != 0 ||
+            strcmp(tail, "end") != 0 || getc_file(f) != EOF)
+        goto error;
+
+    /* short read at the end of the file */
+    seek_file(f, -10, SEEK_END);
+    if(readv_file(f, vec, 3) != 10)
+        goto error;
+    remove(get_name_file(f));
+    close_file(f);
+    printf("Vectored transfers are correct.\n");
+    return 0;
+
+error:
+    printf("Error: vectored transfer failed.\n");
+    remove(get_name_file(f));
+    close_file(f);
+    return 1;
+}
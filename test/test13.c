@@ -0,0 +1,47 @@
+#define _XOPEN_SOURCE 700           /* mkdtemp(), rmdir() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "file.h"
+
+#define BIG (((file_off_t)1 << 32) + 1)   /* past any 32-bit offset */
+
+/* program to test 64-bit offsets on a sparse file */
+int
+main ()
+{
+    char dir[256], path[300];
+    const char *tmp;
+    file_t *f;
+    int ok = 0;
+
+    /* kept out of the source tree, and removed whatever happens */
+    if((tmp = getenv("TMPDIR")) == NULL || strlen(tmp) + 16 > sizeof(dir))
+        tmp = "/tmp";
+    sprintf(dir, "%s/test13XXXXXX", tmp);
+    if(mkdtemp(dir) == NULL) {
+        printf("Error: cannot make a temporary directory.\n");
+        return 1;
+    }
+    sprintf(path, "%s/test13.bin", dir);
+    f = open_file(path, "w+b");
+    if(get_error_file() == FILE_ERROR_OKAY) {
+        ok = seek64_file(f, BIG, SEEK_SET) == 0 &&
+            tell64_file(f) == BIG;
+        putc_file(f, '\n');
+        ok = ok && get_size64_file(f) == BIG + 1 &&
+            seek64_file(f, -1, SEEK_END) == 0 &&
+            tell64_file(f) == BIG &&
+            getc_file(f) == '\n';
+    }
+    close_file(f);
+    remove(path);
+    rmdir(dir);
+    if(!ok) {
+        printf("Error: 64-bit offsets failed.\n");
+        return 1;
+    }
+    printf("64-bit offsets are correct.\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+
+/* compare two open files byte by byte from the start */
+static int
+same_file (file_t *a, file_t *b)
+{
+    int c;
+    rewind_file(a);
+    rewind_file(b);
+    while((c = getc_file(a)) != EOF)
+        if(c != getc_file(b))
+            return 0;
+    return getc_file(b) == EOF;
+}
+
+/* program to test copying files */
+int
+main ()
+{
+    file_t *src, *dst;
+    char buf[16];
+    file_off_t size;
+
+    src = open_file("test.c", "rb");
+    if(get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    dst = open_file("test14.txt", "w+b");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        close_file(src);
+        return 1;
+    }
+    size = get_size64_file(src);
+    if(copy_file(src, dst) != size || tell64_file(src) != size ||
+            tell64_file(dst) != size || !same_file(src, dst))
+        goto error;
+
+    /* a range inside the file, positions stay where they were */
+    seek_file(dst, 3, SEEK_SET);
+    if(copy_range_file(src, 0, dst, 10, 8) != 8 || tell_file(dst) != 3)
+        goto error;
+    seek_file(dst, 10, SEEK_SET);
+    read_file(dst, buf, 1, 8);
+    if(memcmp(buf, "#include", 8) != 0)
+        goto error;
+
+    /* append mode always lands at the end */
+    dst = reopen_file(dst, "a+b");
+    seek_file(src, size - 4, SEEK_SET);
+    if(dst == NULL || copy_file(src, dst) != 4 ||
+            get_size64_file(dst) != size + 4)
+        goto error;
+    remove(get_name_file(dst));
+    close_file(dst);
+    close_file(src);
+    printf("Files copied correctly.\n");
+    return 0;
+
+error:
+    printf("Error: file copy failed.\n");
+    if(dst != NULL) {
+        remove(get_name_file(dst));
+        close_file(dst);
+    }
+    close_file(src);
+    return 1;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "pfile.h"
+
+#define LINES 20000
+
+struct total {
+    long lines;
+    long sum;
+    int next;                       /* next chunk index expected */
+    int bad;
+};
+
+/* count lines and add up the numbers on them */
+static void *
+map_chunk (const pfile_chunk_t *chunk, void *arg)
+{
+    long *res = (long*)malloc(sizeof(long)*3);
+    const char *p = chunk->data, *end = chunk->data + chunk->len;
+    (void)arg;
+    if(res == NULL)
+        return NULL;
+    res[0] = res[1] = 0;
+    res[2] = chunk->index;
+    if(chunk->len == 0 || end[-1] != '\n')
+        res[2] = -1;
+    while(p < end) {
+        res[1] += strtol(p, NULL, 10);
+        res[0]++;
+        p = (const char*)memchr(p, '\n', end - p) + 1;
+    }
+    return res;
+}
+
+static void
+reduce_chunk (void *result, void *arg)
+{
+    struct total *t = (struct total*)arg;
+    long *res = (long*)result;
+    if(res == NULL || res[2] != t->next++)
+        t->bad++;
+    if(res != NULL) {
+        t->lines += res[0];
+        t->sum += res[1];
+    }
+    free(res);
+}
+
+static int
+check (file_t *f, int chunks)
+{
+    struct total t = {0, 0, 0, 0};
+    if(run_pfile(f, chunks, 4, map_chunk, reduce_chunk, &t) != 0)
+        return 0;
+    return !t.bad && t.lines == LINES && t.sum == (long)LINES*(LINES-1)/2;
+}
+
+/* program to test parallel processing of a file by lines */
+int
+main ()
+{
+    file_off_t bounds[9];
+    file_t *f;
+    int i, n, ok;
+
+    f = open_file("test15.txt", "w+t");
+    if(get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    for(i = 0; i < LINES; i++)
+        writef_file(f, "%d\n", i);
+    ok = check(f, 0) && check(f, 7) && check(f, 1000);
+    n = split_pfile(f, 8, bounds);
+    ok = ok && n == 8 && bounds[0] == 0 && bounds[n] == get_size64_file(f);
+    f = reopen_file(f, "rtm");
+    ok = ok && f != NULL && check(f, 0) && check(f, 3);
+    if(f != NULL) {
+        remove(get_name_file(f));
+        close_file(f);
+    }
+    if(!ok) {
+        printf("Error: parallel processing failed.\n");
+        return 1;
+    }
+    printf("Parallel processing is correct.\n");
+    return 0;
+}
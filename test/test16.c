@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "scan.h"
+
+#define ROWS 50000
+
+static int
+check (const char *mode)
+{
+    scan_t *scan;
+    file_t *file;
+    long long i, v;
+    double d, e;
+    const char *tok;
+    size_t len;
+    int bad = 0;
+
+    file = open_file("test16.txt", mode);
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Cannot open file: %s\n", strerror_file(get_error_file()));
+        return 1;
+    }
+    scan = create_scan(file);
+    for(i = 0; i < ROWS; i++) {
+        e = (double)i * 0.25 - 17.5;
+        if(get_i64_scan(scan, &v) != 0 || v != i * 1000003LL - 9) {
+            printf("Row %lld: bad integer.\n", i);
+            bad = 1;
+            break;
+        }
+        if(get_f64_scan(scan, &d) != 0 || d != e) {
+            printf("Row %lld: bad double %.17g.\n", i, d);
+            bad = 1;
+            break;
+        }
+    }
+    if(!bad) {
+        if(get_i64_scan(scan, &v) != 0 || v != -9223372036854775807LL - 1)
+            bad = 1;
+        if(get_f64_scan(scan, &d) != 0 || d != 6.02214076e23)
+            bad = 1;
+        if(get_f64_scan(scan, &d) != 0 || d != 0.1)
+            bad = 1;
+        if(get_f64_scan(scan, &d) != 0 || d != 3.14159265358979323846)
+            bad = 1;
+        if(get_i64_scan(scan, &v) != -1 ||
+                get_error_scan(scan) != SCAN_ERROR_RANGE)
+            bad = 1;
+        (void)get_token_scan(scan, &len);
+        if(get_i64_scan(scan, &v) != -1 ||
+                get_error_scan(scan) != SCAN_ERROR_NUMBER)
+            bad = 1;
+        tok = get_token_scan(scan, &len);
+        if(tok == NULL || len != 5 || strncmp(tok, "12abc", 5) != 0)
+            bad = 1;
+        if(get_f64_scan(scan, &d) != -1 ||
+                get_error_scan(scan) != SCAN_ERROR_END)
+            bad = 1;
+        if(bad)
+            printf("Trailing fields scanned wrong.\n");
+    }
+    destroy_scan(&scan);
+    close_file(file);
+    return bad;
+}
+
+/* fields longer than a number window and across the read buffer */
+static int
+longs (void)
+{
+    static char zeros[400000];
+    scan_t *scan;
+    file_t *file;
+    long long v;
+    double d;
+    const char *tok;
+    size_t len;
+    long long end;
+    int bad = 0;
+
+    memset(zeros, '0', sizeof(zeros));
+    file = open_file("test16.txt", "wt");
+    /* a quarter megabyte of zeros, then fields crossing the refill */
+    write_file(file, zeros, 1, (1 << 18) - 100);
+    writef_file(file, " %.*s42 0.%.*s15 -%.*s7 ", 300, zeros, 300, zeros,
+        200, zeros);
+    write_file(file, zeros, 1, sizeof(zeros));
+    writef_file(file, "9 8\n");
+    close_file(file);
+    /* offset just past the long token, which outgrows the read buffer */
+    end = (1 << 18) - 100 + 303 + 305 + 204 + (long long)sizeof(zeros) + 1;
+
+    file = open_file("test16.txt", "rt");
+    scan = create_scan(file);
+    if(get_i64_scan(scan, &v) != 0 || v != 0 ||
+            get_i64_scan(scan, &v) != 0 || v != 42 ||
+            get_f64_scan(scan, &d) != 0 || d != 1.5e-301 ||
+            get_i64_scan(scan, &v) != 0 || v != -7)
+        bad = 1;
+    tok = get_token_scan(scan, &len);
+    if(tok == NULL || len != sizeof(zeros) + 1 || tok[len-1] != '9' ||
+            get_offset_scan(scan) != end ||
+            get_i64_scan(scan, &v) != 0 || v != 8 ||
+            get_offset_scan(scan) != end + 2)
+        bad = 1;
+    if(bad)
+        printf("Long fields scanned wrong.\n");
+    destroy_scan(&scan);
+    close_file(file);
+    return bad;
+}
+
+int
+main (void)
+{
+    scan_t *scan;
+    file_t *file;
+    long long i, v;
+    int bad;
+
+    file = open_file("test16.txt", "wt");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Cannot open file: %s\n", strerror_file(get_error_file()));
+        return 1;
+    }
+    for(i = 0; i < ROWS; i++)
+        writef_file(file, "%lld\t%.2f\n", i * 1000003LL - 9,
+            (double)i * 0.25 - 17.5);
+    writef_file(file, "-9223372036854775808 6.02214076e23 .1 "
+        "3.14159265358979323846\n9223372036854775808 12abc\n");
+    close_file(file);
+
+    bad = check("rt") || check("rm");
+
+    /* destroying the scanner leaves the file after the last field */
+    file = open_file("test16.txt", "rt");
+    scan = create_scan(file);
+    get_i64_scan(scan, &v);
+    destroy_scan(&scan);
+    if(tell64_file(file) != 2 || getc_file(file) != '\t') {
+        printf("File position not handed back.\n");
+        bad = 1;
+    }
+    close_file(file);
+    bad |= longs();
+    remove("test16.txt");
+    if(!bad)
+        printf("All scanner tests passed.\n");
+    return bad;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "file.h"
+
+#define COUNT 100000
+
+/* random double from all 64 bits, skipping nan and inf */
+static double
+random_double (void)
+{
+    unsigned long long bits = 0;
+    double d;
+    int i;
+    do {
+        for(i = 0; i < 4; i++)
+            bits = (bits << 16) ^ (unsigned long long)(rand() & 0xFFFF);
+    } while(((bits >> 52) & 0x7FF) == 0x7FF);
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+int
+main (void)
+{
+    static const double fixed[] = {
+        0.1, 0.5, 1.0, 3.0, 100.0, 123456.789, 1e21, 1e22, 1e-7,
+        5e-324, 2.2250738585072014e-308, 1.7976931348623157e308,
+        0.30000000000000004, 1.0 / 3.0
+    };
+    static const char *fixed_text[] = {
+        "0.1", "0.5", "1", "3", "100", "123456.789", "1e21", "1e22", "1e-7",
+        "5e-324", "2.2250738585072014e-308", "1.7976931348623157e308",
+        "0.30000000000000004", "0.3333333333333333"
+    };
+    char line[128], want[64];
+    long long v;
+    double d, e;
+    file_t *file;
+    int i, bad = 0;
+
+    file = open_file("test17.txt", "wt");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Cannot open file: %s\n", strerror_file(get_error_file()));
+        return 1;
+    }
+    write_i64_file(file, 0);
+    write_str_file(file, " ");
+    write_i64_file(file, -9223372036854775807LL - 1);
+    write_str_file(file, " ");
+    write_i64_file(file, 9223372036854775807LL);
+    write_str_file(file, "\n");
+    /* other writers see typed output in order */
+    writef_file(file, "writef %d\n", 42);
+    for(i = 0; i < (int)(sizeof(fixed)/sizeof(fixed[0])); i++) {
+        write_f64_file(file, fixed[i]);
+        write_str_file(file, "\n");
+    }
+    write_f64_file(file, -0.0);
+    write_str_file(file, " ");
+    write_f64_file(file, -HUGE_VAL);
+    write_str_file(file, "\n");
+    srand(17);
+    for(i = 0; i < COUNT; i++) {
+        v = ((long long)rand() << 32 | rand()) - (1LL << 40);
+        write_i64_file(file, v);
+        write_str_file(file, " ");
+        write_f64_file(file, random_double());
+        write_str_file(file, "\n");
+    }
+    if(get_size64_file(file) != tell64_file(file)) {
+        printf("Size and position disagree after typed writes.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    file = open_file("test17.txt", "rt");
+    if(strcmp(gets_file(file, line, sizeof(line)),
+            "0 -9223372036854775808 9223372036854775807\n") != 0 ||
+            strcmp(gets_file(file, line, sizeof(line)), "writef 42\n") != 0) {
+        printf("Integers written wrong: %s", line);
+        bad = 1;
+    }
+    for(i = 0; !bad && i < (int)(sizeof(fixed)/sizeof(fixed[0])); i++) {
+        sprintf(want, "%s\n", fixed_text[i]);
+        if(strcmp(gets_file(file, line, sizeof(line)), want) != 0) {
+            printf("Double written as %s", line);
+            bad = 1;
+        }
+    }
+    if(!bad && strcmp(gets_file(file, line, sizeof(line)), "-0 -inf\n") != 0) {
+        printf("Signed zero or infinity written as %s", line);
+        bad = 1;
+    }
+    srand(17);
+    for(i = 0; !bad && i < COUNT; i++) {
+        v = ((long long)rand() << 32 | rand()) - (1LL << 40);
+        e = random_double();
+        gets_file(file, line, sizeof(line));
+        sprintf(want, "%lld ", v);
+        d = strtod(line + strlen(want), NULL);
+        if(strncmp(line, want, strlen(want)) != 0 || d != e) {
+            printf("Row %d does not read back: %s", i, line);
+            bad = 1;
+        }
+        /* never longer than the 17 digits printf needs */
+        sprintf(want, "%.17g", e);
+        if(!bad && strlen(line + strcspn(line, " ") + 1) > strlen(want) + 1) {
+            printf("Row %d is longer than %s: %s", i, want, line);
+            bad = 1;
+        }
+    }
+    close_file(file);
+    remove("test17.txt");
+    if(!bad)
+        printf("All typed writer tests passed.\n");
+    return bad;
+}
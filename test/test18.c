@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+#include "bitmap.h"
+#include "clogger.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* backend that only counts what goes through it */
+struct counter {
+    long reads, writes, closed;
+    size_t len;
+};
+
+static long
+count_read (void *ctx, void *buf, size_t len)
+{
+    (void)buf;
+    (void)len;
+    ((struct counter*)ctx)->reads++;
+    return 0;
+}
+
+static long
+count_write (void *ctx, const void *buf, size_t len)
+{
+    struct counter *c = (struct counter*)ctx;
+    (void)buf;
+    c->writes++;
+    c->len += len;
+    return (long)len;
+}
+
+static int
+count_close (void *ctx)
+{
+    ((struct counter*)ctx)->closed = 1;
+    return 0;
+}
+
+/* same lines and numbers through every kind of backend */
+static int
+check_file (file_t *file, const char *kind)
+{
+    char line[64], buf[8];
+    file_vec_t vec[2];
+    const char *next;
+    size_t len;
+    int a, b;
+
+    if(file == NULL || get_error_file() != FILE_ERROR_OKAY) {
+        printf("%s: cannot open.\n", kind);
+        return 1;
+    }
+    writef_file(file, "%d %d\n", 12, 34);
+    write_i64_file(file, 56);
+    write_str_file(file, "\nthird line\n");
+    vec[0].buf = "four";
+    vec[0].len = 4;
+    vec[1].buf = "th\n";
+    vec[1].len = 3;
+    writev_file(file, vec, 2);
+    if(get_size64_file(file) != 27 || get_lines64_file(file) != 4) {
+        printf("%s: size or lines wrong.\n", kind);
+        return 1;
+    }
+    rewind_file(file);
+    if(readf_file(file, "%d %d", &a, &b) != 2 || a != 12 || b != 34) {
+        printf("%s: readf wrong.\n", kind);
+        return 1;
+    }
+    getc_file(file);
+    if(strcmp(gets_file(file, line, sizeof(line)), "56\n") != 0 ||
+            (next = next_line_file(file, &len)) == NULL || len != 11 ||
+            strncmp(next, "third line\n", len) != 0) {
+        printf("%s: lines read wrong.\n", kind);
+        return 1;
+    }
+    if(read_at_file(file, buf, 4, 20) != 4 || memcmp(buf, "four", 4) != 0 ||
+            get_line_at_file(file, 3) != 0 ||
+            strcmp(gets_file(file, line, sizeof(line)), "fourth\n") != 0) {
+        printf("%s: offset reads wrong.\n", kind);
+        return 1;
+    }
+    return 0;
+}
+
+int
+main (void)
+{
+    static const file_io_t counter_io = {
+        count_read, count_write, NULL, count_close
+    };
+    struct counter count = { 0, 0, 0, 0 };
+    file_t *file, *copy;
+    const char *data;
+    Bitmap *bmp, *back;
+    Color pixel;
+    char buf[64];
+    const char *next;
+    size_t len;
+    int bad = 0, fd, fds[2];
+
+    bad |= check_file(file = open_memory_file(NULL, 0, "w+b"), "memory");
+    data = (const char*)get_memory_file(file, &len);
+    if(data == NULL || len != 27 || memcmp(data, "12 34\n56\n", 9) != 0) {
+        printf("memory: contents wrong.\n");
+        bad = 1;
+    }
+    if(reopen_file(file, "rb") != file ||
+            get_error_file() != FILE_ERROR_OPEN) {
+        printf("memory: reopen should fail and keep the file.\n");
+        bad = 1;
+    }
+
+    /* a read-only copy of it, mapped and copied to a memfd */
+    copy = open_memory_file(data, len, "rbm");
+    if(get_view_file(copy, &len) == NULL || len != 27 ||
+            strncmp((const char*)get_view_file(copy, NULL) + 20, "fourth",
+            6) != 0) {
+        printf("memory: mapped view wrong.\n");
+        bad = 1;
+    }
+    close_file(copy);
+    close_file(file);
+
+    bad |= check_file(file = open_memfd_file("test18", "w+b"), "memfd");
+    copy = open_memory_file(NULL, 0, "w+b");
+    if(copy_range_file(file, 6, copy, 0, 3) != 3 ||
+            (data = (const char*)get_memory_file(copy, &len)) == NULL ||
+            len != 3 || memcmp(data, "56\n", 3) != 0) {
+        printf("memfd: copy to memory wrong.\n");
+        bad = 1;
+    }
+    close_file(copy);
+    close_file(file);
+
+    /* bitmap and logger without touching the disk */
+    bmp = create_bitmap(8, 4);
+    pixel.r = 1;
+    pixel.g = 2;
+    pixel.b = 3;
+    fill_bitmap(bmp, pixel);
+    file = open_memory_file(NULL, 0, "w+b");
+    if(write_file_bitmap(bmp, file) != 0) {
+        printf("bitmap: write to memory failed.\n");
+        bad = 1;
+    }
+    rewind_file(file);
+    back = load_file_bitmap(file);
+    if(back == NULL || back->info.width != 8 ||
+            memcmp(back->data, bmp->data, bmp->info.isize) != 0) {
+        printf("bitmap: read back from memory wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+    destroy_bitmap(bmp);
+    if(back != NULL)
+        destroy_bitmap(back);
+
+    init_logger();
+    attach_log(CLOG0, open_memory_file(NULL, 0, "a+"));
+    write_log(CLOG0, "first %d\n", 1);
+    write_log(CLOG0, "second %d\n", 2);
+    if(read_log(CLOG0, buf, sizeof(buf)) != '\n' ||
+            strcmp(buf, "first 1") != 0 ||
+            read_log(CLOG0, buf, 4) != 'c' || strcmp(buf, "sec") != 0 ||
+            read_log(CLOG0, buf, sizeof(buf)) != '\n' ||
+            strcmp(buf, "ond 2") != 0 ||
+            read_log(CLOG0, buf, sizeof(buf)) != EOF) {
+        printf("logger: memory log wrong.\n");
+        bad = 1;
+    }
+    close_log(CLOG0);
+
+    /* user backend sees stdio's large blocks */
+    file = open_io_file(&counter_io, &count, "counter", "wb");
+    writef_file(file, "%s", "hello ");
+    write_str_file(file, "world");
+    close_file(file);
+    if(count.len != 11 || count.writes != 1 || !count.closed) {
+        printf("io: backend saw %ld writes of %lu bytes.\n", count.writes,
+            (unsigned long)count.len);
+        bad = 1;
+    }
+
+    /* pushed back bytes and scanf's read-ahead are not lost */
+    file = open_memory_file("7 x123", 6, "rb");
+    if(readf_file(file, "%d", &fd) != 1 || getc_file(file) != ' ' ||
+            (ungetc_file(file, 'y'), getc_file(file)) != 'y' ||
+            read_file(file, buf, 1, 4) != 4 || memcmp(buf, "x123", 4) != 0) {
+        printf("memory: mixed reads wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+#ifndef _WIN32
+    /* a descriptor that cannot be opened is closed, not leaked */
+    fd = open("test18.c", O_RDONLY);
+    file = open_fd_file(fd, "wb");
+    if(get_error_file() != FILE_ERROR_OPEN || fcntl(fd, F_GETFD) != -1) {
+        printf("fd: descriptor leaked.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* read-ahead a pipe cannot take back is read before the stream */
+    if(pipe(fds) == 0) {
+        write(fds[1], "line1\nline2\nline3\n42 x\n", 23);
+        close(fds[1]);
+        file = open_fd_file(fds[0], "r");
+        if((next = next_line_file(file, &len)) == NULL || len != 6 ||
+                strncmp(next, "line1\n", len) != 0 ||
+                gets_file(file, buf, sizeof(buf)) == NULL ||
+                strcmp(buf, "line2\n") != 0 ||
+                read_file(file, buf, 1, 6) != 6 ||
+                memcmp(buf, "line3\n", 6) != 0 ||
+                readf_file(file, "%d", &fd) != EOF ||
+                get_error_file() != FILE_ERROR_READ ||
+                (next = next_line_file(file, &len)) == NULL || len != 5 ||
+                strncmp(next, "42 x\n", len) != 0 ||
+                next_line_file(file, &len) != NULL) {
+            printf("pipe: read-ahead lost.\n");
+            bad = 1;
+        }
+        close_file(file);
+    }
+#endif
+
+    if(!bad)
+        printf("All backend tests passed.\n");
+    return bad;
+}
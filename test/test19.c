@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "lz.h"
+
+#define LINES 100000
+
+/* compress and decompress one buffer; returns compressed size */
+static size_t
+round_trip (const char *data, size_t len, int *bad)
+{
+    char *pack, *back;
+    size_t n, out = len;
+    pack = (char*)malloc(bound_lz(len));
+    back = (char*)malloc(len + 1);
+    n = compress_lz(data, len, pack, bound_lz(len));
+    if(n == 0 || decompress_lz(pack, n, back, &out) != 0 || out != len ||
+            memcmp(back, data, len) != 0) {
+        printf("Block of %lu bytes does not round trip.\n",
+            (unsigned long)len);
+        *bad = 1;
+    }
+    /* cutting the block short must be caught */
+    out = len;
+    if(n > 2 && len > 0 && decompress_lz(pack, n - 2, back, &out) == 0 &&
+            out == len && memcmp(back, data, len) == 0) {
+        printf("Truncated block was not noticed.\n");
+        *bad = 1;
+    }
+    free(pack);
+    free(back);
+    return n;
+}
+
+int
+main (void)
+{
+    char line[128], *buf;
+    file_off_t size, raw;
+    file_t *file;
+    const char *view;
+    size_t len, i;
+    int bad = 0, n;
+
+    /* codec on its own: empty, tiny, random, runs and text */
+    buf = (char*)malloc(200000);
+    round_trip("", 0, &bad);
+    round_trip("abc", 3, &bad);
+    srand(19);
+    for(i = 0; i < 200000; i++)
+        buf[i] = (char)rand();
+    round_trip(buf, 200000, &bad);
+    memset(buf, 'x', 100000);
+    if(round_trip(buf, 100000, &bad) > 1000) {
+        printf("Run of one byte did not compress.\n");
+        bad = 1;
+    }
+    for(i = 0, len = 0; len < 150000; i++)
+        len += sprintf(buf + len, "%lu: the quick brown fox\n",
+            (unsigned long)i);
+    round_trip(buf, len, &bad);
+    free(buf);
+
+    /* compressed file, written in pieces and read back as text */
+    file = open_file("test19.z", "wz");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Cannot open file: %s\n", strerror_file(get_error_file()));
+        return 1;
+    }
+    for(n = 0; n < LINES; n++)
+        writef_file(file, "2026-10-17 12:00:%02d INFO request %d served\n",
+            n % 60, n);
+    raw = tell64_file(file);
+    close_file(file);
+    file = open_file("test19.z", "az");
+    write_str_file(file, "appended line\n");
+    close_file(file);
+    raw += 14;
+
+    file = open_file("test19.z", "rb");
+    size = get_size64_file(file);
+    close_file(file);
+    if(size * 3 > raw) {
+        printf("Log compressed only from %lld to %lld bytes.\n",
+            (long long)raw, (long long)size);
+        bad = 1;
+    }
+
+    file = open_file("test19.z", "rz");
+    if(get_size64_file(file) != raw || get_lines64_file(file) != LINES + 1) {
+        printf("Uncompressed size or lines wrong.\n");
+        bad = 1;
+    }
+    for(n = 0; !bad && n < LINES; n++) {
+        sprintf(line, "2026-10-17 12:00:%02d INFO request %d served\n",
+            n % 60, n);
+        if(strcmp(gets_file(file, line + 64, 64), line) != 0) {
+            printf("Line %d read back wrong.\n", n);
+            bad = 1;
+        }
+    }
+    if(!bad && strcmp(gets_file(file, line, sizeof(line)),
+            "appended line\n") != 0) {
+        printf("Appended line read back wrong.\n");
+        bad = 1;
+    }
+    /* seeking lands inside any block */
+    if(get_line_at_file(file, 77777) != 0 ||
+            strcmp(gets_file(file, line, sizeof(line)),
+            "2026-10-17 12:00:17 INFO request 77777 served\n") != 0 ||
+            read_at_file(file, line, 4, raw - 14) != 4 ||
+            memcmp(line, "appe", 4) != 0) {
+        printf("Seeking in the compressed file failed.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* mapped view is the whole uncompressed text */
+    file = open_file("test19.z", "rzm");
+    view = (const char*)get_view_file(file, &len);
+    if(view == NULL || (file_off_t)len != raw ||
+            memcmp(view + len - 14, "appended line\n", 14) != 0) {
+        printf("Mapped view of compressed file wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* plain files are not taken for compressed ones */
+    file = open_file("test.c", "rz");
+    if(get_error_file() != FILE_ERROR_OPEN) {
+        printf("Plain file opened as compressed.\n");
+        bad = 1;
+    }
+    close_file(file);
+    remove("test19.z");
+    if(!bad)
+        printf("All compression tests passed.\n");
+    return bad;
+}
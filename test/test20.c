@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "pfile.h"
+#include "crc.h"
+
+#define SIZE 300000
+
+/* one bit at a time, to check the fast versions against */
+static unsigned int
+slow_crc (const unsigned char *p, size_t len)
+{
+    unsigned int crc = 0xFFFFFFFFU;
+    int k;
+    while(len-- > 0) {
+        crc ^= *p++;
+        for(k = 0; k < 8; k++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78U : crc >> 1;
+    }
+    return ~crc;
+}
+
+/* checksum of one chunk, with its length for combining */
+static void *
+map_chunk (const pfile_chunk_t *chunk, void *arg)
+{
+    unsigned int *res = (unsigned int*)malloc(sizeof(unsigned int) * 2);
+    (void)arg;
+    if(res != NULL) {
+        res[0] = update_crc(0, chunk->data, chunk->len);
+        res[1] = (unsigned int)chunk->len;
+    }
+    return res;
+}
+
+static void
+reduce_chunk (void *result, void *arg)
+{
+    unsigned int *res = (unsigned int*)result, *crc = (unsigned int*)arg;
+    *crc = combine_crc(*crc, res[0], res[1]);
+    free(res);
+}
+
+int
+main (void)
+{
+    unsigned char *data, *back;
+    unsigned int crc, whole;
+    file_t *file;
+    size_t i, cut;
+    int bad = 0;
+
+    if(update_crc(0, "123456789", 9) != 0xE3069283U ||
+            update_crc(0, "", 0) != 0) {
+        printf("Check value of CRC32C wrong.\n");
+        bad = 1;
+    }
+    data = (unsigned char*)malloc(SIZE);
+    back = (unsigned char*)malloc(SIZE);
+    srand(20);
+    for(i = 0; i < SIZE; i++)
+        data[i] = (unsigned char)(i % 100 == 0 ? '\n' : 'a' + rand() % 26);
+    whole = slow_crc(data, SIZE);
+    if(update_crc(0, data, SIZE) != whole ||
+            update_crc(update_crc(0, data, 7), data + 7, SIZE - 7) != whole) {
+        printf("CRC32C of data wrong.\n");
+        bad = 1;
+    }
+    for(i = 0; i < 50; i++) {
+        cut = (size_t)rand() % SIZE;
+        if(combine_crc(update_crc(0, data, cut),
+                update_crc(0, data + cut, SIZE - cut), SIZE - cut) != whole) {
+            printf("Combining at %lu wrong.\n", (unsigned long)cut);
+            bad = 1;
+            break;
+        }
+    }
+
+    /* checksummed while written, then while read back */
+    file = open_file("test20.txt", "wb");
+    set_checksum_file(file, 1);
+    write_file(file, data, 1, 1000);
+    write_str_file(file, "");
+    write_file(file, data + 1000, 1, SIZE - 1000);
+    if(get_checksum_file(file) != whole) {
+        printf("Checksum of written data wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+    file = open_file("test20.txt", "rb");
+    set_checksum_file(file, 1);
+    while(read_file(file, back, 1, 4096) > 0)
+        ;
+    if(get_checksum_file(file) != whole) {
+        printf("Checksum of read data wrong.\n");
+        bad = 1;
+    }
+    /* parallel readers combine their pieces in order */
+    crc = 0;
+    if(run_pfile(file, 8, 4, map_chunk, reduce_chunk, &crc) != 0 ||
+            crc != whole) {
+        printf("Combined checksum of chunks wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+    remove("test20.txt");
+    free(data);
+    free(back);
+    if(!bad)
+        printf("All checksum tests passed.\n");
+    return bad;
+}
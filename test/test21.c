@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+
+#define SIZE (4 << 20)
+
+/* read the whole file and compare it to data */
+static int
+check_file (file_t *file, const unsigned char *data, unsigned char *back)
+{
+    size_t got = 0, n;
+    while((n = read_file(file, back + got, 1, 65536)) > 0)
+        got += n;
+    return got == SIZE && memcmp(back, data, SIZE) == 0;
+}
+
+int
+main (void)
+{
+    unsigned char *data, *back;
+    const unsigned char *view;
+    file_t *file;
+    size_t i, len;
+    int bad = 0;
+
+    data = (unsigned char*)malloc(SIZE);
+    back = (unsigned char*)malloc(SIZE);
+    if(data == NULL || back == NULL)
+        return 1;
+    srand(21);
+    for(i = 0; i < SIZE; i++)
+        data[i] = (unsigned char)rand();
+
+    /* large stream buffer for writing, then no buffer at all */
+    file = open_file("test21.dat", "wb");
+    if(get_error_file() != FILE_ERROR_OKAY ||
+            set_buffer_file(file, 1 << 20) != 0) {
+        printf("Could not set stream buffer.\n");
+        return 1;
+    }
+    for(i = 0; i < SIZE; i += 4096)
+        write_file(file, data + i, 1, 4096);
+    if(advise_file(file, 0, 0, FILE_ADVISE_DONTNEED) != 0) {
+        printf("Dropping a written file failed.\n");
+        bad = 1;
+    }
+    reopen_file(file, "rb");
+    if(advise_file(file, 0, 0, FILE_ADVISE_SEQUENTIAL) != 0 ||
+            advise_file(file, 0, 1 << 20, FILE_ADVISE_WILLNEED) != 0) {
+        printf("Advising a read failed.\n");
+        bad = 1;
+    }
+    if(!check_file(file, data, back)) {
+        printf("Buffered file reads back wrong.\n");
+        bad = 1;
+    }
+    if(advise_file(file, 0, 0, FILE_ADVISE_DONTNEED) != 0 ||
+            advise_file(file, 0, 0, 99) != -1 ||
+            advise_file(file, -1, 0, FILE_ADVISE_NORMAL) != -1) {
+        printf("Advice checks wrong.\n");
+        bad = 1;
+    }
+    reopen_file(file, "rb");
+    set_buffer_file(file, 0);
+    if(!check_file(file, data, back)) {
+        printf("Unbuffered file reads back wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* a dropped range of a mapping comes back from the file */
+    file = open_file("test21.dat", "rbm");
+    view = (const unsigned char*)get_view_file(file, &len);
+    if(view == NULL || len != SIZE ||
+            advise_file(file, 0, 0, FILE_ADVISE_RANDOM) != 0 ||
+            advise_file(file, 12345, 1 << 20, FILE_ADVISE_DONTNEED) != 0 ||
+            memcmp(view, data, SIZE) != 0) {
+        printf("Advising a mapping failed.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* nothing to advise behind a memory file */
+    file = open_memory_file(data, 1000, "rb");
+    if(advise_file(file, 0, 0, FILE_ADVISE_DONTNEED) != 0) {
+        printf("Advising a memory file failed.\n");
+        bad = 1;
+    }
+    close_file(file);
+    remove("test21.dat");
+    free(data);
+    free(back);
+    if(!bad)
+        printf("All advice tests passed.\n");
+    return bad;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "bitmap.h"
+
+#define SIZE ((3 << 20) + 123)
+#define MORE 5001
+
+/* read the whole file with plain stdio and compare it to data */
+static int
+check_plain (const char *name, const unsigned char *data, size_t len)
+{
+    unsigned char *back = (unsigned char*)malloc(len + 1);
+    FILE *fp = fopen(name, "rb");
+    int ok = 0;
+    if(back != NULL && fp != NULL)
+        ok = fread(back, 1, len + 1, fp) == len &&
+            memcmp(back, data, len) == 0;
+    if(fp != NULL)
+        fclose(fp);
+    free(back);
+    return ok;
+}
+
+int
+main (void)
+{
+    unsigned char *data, *back, *aligned;
+    file_t *file, *plain;
+    Bitmap *bmp;
+    size_t i, got, n;
+    int bad = 0, c;
+
+    data = (unsigned char*)malloc(SIZE + MORE);
+    back = (unsigned char*)malloc(SIZE + MORE + 1);
+    aligned = (unsigned char*)alloc_direct_file(SIZE + MORE);
+    if(data == NULL || back == NULL || aligned == NULL ||
+            ((size_t)aligned & 4095) != 0) {
+        printf("Could not allocate buffers.\n");
+        return 1;
+    }
+    srand(22);
+    for(i = 0; i < SIZE + MORE; i++)
+        data[i] = (unsigned char)rand();
+    memcpy(aligned, data, SIZE + MORE);
+
+    /* small unaligned writes, then one large aligned one */
+    file = open_file("test22.dat", "wbd");
+    if(get_error_file() != FILE_ERROR_OKAY) {
+        printf("Could not open direct file.\n");
+        return 1;
+    }
+    /* nothing buffers in front of the aligned transfers */
+    if(set_buffer_file(file, 1 << 20) != -1) {
+        printf("Direct file took a stream buffer.\n");
+        bad = 1;
+    }
+    for(i = 0; i < 100000; i += n) {
+        n = 1 + (size_t)rand() % 3000;
+        write_file(file, data + i, 1, n);
+    }
+    write_file(file, data + i, 1, 1 << 20);
+    write_file(file, data + i + (1 << 20), 1, SIZE - i - (1 << 20));
+    if(tell64_file(file) != SIZE)
+        bad = 1;
+    close_file(file);
+    if(bad || !check_plain("test22.dat", data, SIZE)) {
+        printf("Direct writes read back wrong.\n");
+        bad = 1;
+    }
+
+    /* appending picks up the partial last block */
+    file = open_file("test22.dat", "abd");
+    write_file(file, data + SIZE, 1, MORE);
+    close_file(file);
+    if(!check_plain("test22.dat", data, SIZE + MORE)) {
+        printf("Direct append reads back wrong.\n");
+        bad = 1;
+    }
+
+    /* aligned and unaligned reads, seeks and characters */
+    file = open_file("test22.dat", "rbd");
+    memset(aligned, 0, SIZE + MORE);
+    got = read_file(file, aligned, 1, 1 << 20);
+    got += read_file(file, back, 1, 777);
+    memcpy(aligned + got - 777, back, 777);
+    while((n = read_file(file, aligned + got, 1, 65536)) > 0)
+        got += n;
+    if(got != SIZE + MORE || memcmp(aligned, data, got) != 0) {
+        printf("Direct reads wrong.\n");
+        bad = 1;
+    }
+    seek64_file(file, 12345, SEEK_SET);
+    c = getc_file(file);
+    seek64_file(file, -1, SEEK_END);
+    if(c != data[12345] || getc_file(file) != data[SIZE + MORE - 1] ||
+            getc_file(file) != EOF ||
+            get_size64_file(file) != SIZE + MORE) {
+        printf("Direct seeks wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* write only, so a direct reader cannot write */
+    file = open_file("test22.dat", "rbd");
+    if(write_file(file, data, 1, 10) == 10 && flush_file(file) == 0) {
+        printf("Direct reader wrote.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* a bitmap dumped around the page cache matches a plain one */
+    bmp = create_bitmap(333, 217);
+    randomise_bitmap(bmp);
+    write_bitmap(bmp, "test22.bmp");
+    file = open_file("test22d.bmp", "wbd");
+    write_file_bitmap(bmp, file);
+    close_file(file);
+    destroy_bitmap(bmp);
+    plain = open_file("test22.bmp", "rb");
+    file = open_file("test22d.bmp", "rb");
+    n = read_file(plain, data, 1, SIZE);
+    if(n == 0 || read_file(file, back, 1, SIZE) != n ||
+            memcmp(data, back, n) != 0) {
+        printf("Direct bitmap differs.\n");
+        bad = 1;
+    }
+    close_file(plain);
+    close_file(file);
+
+    remove("test22.dat");
+    remove("test22.bmp");
+    remove("test22d.bmp");
+    free_direct_file(aligned);
+    free(data);
+    free(back);
+    if(!bad)
+        printf("All direct I/O tests passed.\n");
+    return bad;
+}
@@ -0,0 +1,138 @@
+#define _XOPEN_SOURCE 500           /* ftruncate(), truncate(), fileno() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "file.h"
+
+#define MB (1L << 20)
+
+/* compare two files byte for byte */
+static int
+same_files (const char *a, const char *b)
+{
+    static char ba[65536], bb[65536];
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    size_t na, nb;
+    int same = (fa != NULL && fb != NULL);
+    while(same) {
+        na = fread(ba, 1, sizeof(ba), fa);
+        nb = fread(bb, 1, sizeof(bb), fb);
+        if(na != nb || memcmp(ba, bb, na) != 0)
+            same = 0;
+        if(na == 0)
+            break;
+    }
+    if(fa != NULL)
+        fclose(fa);
+    if(fb != NULL)
+        fclose(fb);
+    return same;
+}
+
+/* bytes of disk a file takes up */
+static long
+used_bytes (const char *name)
+{
+    struct stat st;
+    return stat(name, &st) == 0 ? (long)st.st_blocks * 512 : -1;
+}
+
+int
+main (void)
+{
+    static char data[65536];
+    file_t *src, *dst;
+    struct stat st;
+    size_t i;
+    int bad = 0;
+
+    for(i = 0; i < sizeof(data); i++)
+        data[i] = (char)(i * 7 + 1);
+
+    /* data, hole, data, hole up to the end */
+    src = open_file("test23a.dat", "wb");
+    write_file(src, data, 1, sizeof(data));
+    seek64_file(src, 8 * MB, SEEK_SET);
+    write_file(src, data, 1, sizeof(data));
+    seek64_file(src, 32 * MB, SEEK_SET);
+    write_file(src, data, 1, 1);
+    flush_file(src);
+    if(ftruncate(fileno(get_handle_file(src)), 40 * MB) != 0)
+        bad = 1;
+    close_file(src);
+
+    /* into a new file: holes stay holes */
+    src = open_file("test23a.dat", "rb");
+    dst = open_file("test23b.dat", "wb");
+    if(copy_file(src, dst) != 40 * MB || tell64_file(dst) != 40 * MB) {
+        printf("Sparse copy has the wrong length.\n");
+        bad = 1;
+    }
+    close_file(src);
+    close_file(dst);
+    if(!same_files("test23a.dat", "test23b.dat")) {
+        printf("Sparse copy differs.\n");
+        bad = 1;
+    }
+    if(used_bytes("test23a.dat") < 4 * MB &&
+            used_bytes("test23b.dat") > 4 * MB) {
+        printf("Sparse copy filled in the holes.\n");
+        bad = 1;
+    }
+
+    /* over an old file: holes clear what was there */
+    dst = open_file("test23c.dat", "wb");
+    memset(data, 0x5A, sizeof(data));
+    for(i = 0; i < 48 * MB / sizeof(data); i++)
+        write_file(dst, data, 1, sizeof(data));
+    close_file(dst);
+    src = open_file("test23a.dat", "rb");
+    dst = open_file("test23c.dat", "r+b");
+    if(copy_range_file(src, 0, dst, 0, 40 * MB) != 40 * MB) {
+        printf("Sparse copy over a file has the wrong length.\n");
+        bad = 1;
+    }
+    close_file(src);
+    close_file(dst);
+    if(truncate("test23c.dat", 40 * MB) != 0 ||
+            !same_files("test23a.dat", "test23c.dat")) {
+        printf("Sparse copy over a file differs.\n");
+        bad = 1;
+    }
+
+    /* reserved space is there, the size is not */
+    dst = open_file("test23d.dat", "wb");
+    if(reserve_file(dst, 8 * MB) == 0) {
+        if(stat("test23d.dat", &st) != 0 || st.st_size != 0 ||
+                used_bytes("test23d.dat") < 8 * MB) {
+            printf("Reserve changed the size or reserved nothing.\n");
+            bad = 1;
+        }
+    }
+    write_file(dst, data, 1, 1000);
+    if(get_size64_file(dst) != 1000 || reserve_file(dst, -1) != -1) {
+        printf("Reserve checks wrong.\n");
+        bad = 1;
+    }
+    close_file(dst);
+    dst = open_file("test23d.dat", "ab");
+    reserve_file(dst, MB);
+    write_file(dst, data, 1, 24);
+    close_file(dst);
+    if(stat("test23d.dat", &st) != 0 || st.st_size != 1024 ||
+            used_bytes("test23d.dat") >= MB) {
+        printf("Append after reserve or release wrong.\n");
+        bad = 1;
+    }
+
+    remove("test23a.dat");
+    remove("test23b.dat");
+    remove("test23c.dat");
+    remove("test23d.dat");
+    if(!bad)
+        printf("All sparse and reserve tests passed.\n");
+    return bad;
+}
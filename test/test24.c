@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define SIZE 300000
+
+int
+main (void)
+{
+    char *data;
+    const char *line;
+    file_t *file;
+    char buf[16];
+    size_t i, len;
+    int bad = 0, c;
+#ifndef _WIN32
+    int fds[2];
+#endif
+
+    data = (char*)malloc(SIZE);
+    if(data == NULL)
+        return 1;
+    srand(24);
+    for(i = 0; i < SIZE; i++)
+        data[i] = (rand() % 40 == 0) ? '\n' : (char)('a' + rand() % 26);
+
+    /* bytes out through the macro and the function, mixed with others */
+    file = open_file("test24.txt", "wb");
+    set_checksum_file(file, 1);
+    for(i = 0; i < 1000; i++)
+        PUTC_FILE(file, data[i]);
+    write_str_file(file, "");
+    write_file(file, data + 1000, 1, 1000);
+    for(i = 2000; i < SIZE; i++)
+        putc_file(file, data[i]);
+    if(tell64_file(file) != SIZE)
+        bad = 1;
+    PUTC_FILE(file, 'X');
+    seek64_file(file, -1, SEEK_END);
+    PUTC_FILE(file, '\n');
+    if(get_checksum_file(file) == 0 || get_size64_file(file) != SIZE + 1) {
+        printf("Buffered byte output wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* bytes in, mixed with lines, seeks and unget */
+    file = open_file("test24.txt", "rb");
+    for(i = 0; i < 5000; i++)
+        if(GETC_FILE(file) != (unsigned char)data[i])
+            bad = 1;
+    ungetc_file(file, data[4999]);
+    if(getc_file(file) != (unsigned char)data[4999])
+        bad = 1;
+    line = next_line_file(file, &len);
+    if(line == NULL || memcmp(line, data + 5000, len) != 0 ||
+            line[len-1] != '\n')
+        bad = 1;
+    i = 5000 + len;
+    if(GETC_FILE(file) != (unsigned char)data[i] ||
+            tell64_file(file) != (file_off_t)i + 1)
+        bad = 1;
+    seek64_file(file, 123456, SEEK_SET);
+    for(i = 123456; i < SIZE && (c = GETC_FILE(file)) != EOF; i++)
+        if(c != (unsigned char)data[i])
+            break;
+    if(i != SIZE || GETC_FILE(file) != '\n' || GETC_FILE(file) != EOF ||
+            getc_file(file) != EOF) {
+        printf("Buffered byte input wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+    /* mapped files and read-write switches */
+    file = open_file("test24.txt", "rbm");
+    for(i = 0; i < SIZE && GETC_FILE(file) == (unsigned char)data[i]; i++)
+        ;
+    if(i != SIZE) {
+        printf("Mapped byte input wrong.\n");
+        bad = 1;
+    }
+    /* the view is the macro's buffer, other reads pick up where it is */
+    rewind_file(file);
+    if(GETC_FILE(file) != (unsigned char)data[0] ||
+            ((file_buf_t*)file)->rlen - ((file_buf_t*)file)->rpos != SIZE ||
+            tell64_file(file) != 1 ||
+            GETC_FILE(file) != (unsigned char)data[1] ||
+            (ungetc_file(file, data[1]), getc_file(file)) !=
+            (unsigned char)data[1] || read_file(file, buf, 1, 4) != 4 ||
+            memcmp(buf, data + 2, 4) != 0 ||
+            GETC_FILE(file) != (unsigned char)data[6] ||
+            (line = next_line_file(file, &len)) == NULL ||
+            line != (const char*)get_view_file(file, NULL) + 7 ||
+            GETC_FILE(file) != (unsigned char)data[7 + len] ||
+            seek64_file(file, -2, SEEK_CUR) != 0 ||
+            GETC_FILE(file) != (unsigned char)data[6 + len] ||
+            seek64_file(file, -1, SEEK_END) != 0 ||
+            GETC_FILE(file) != '\n' || GETC_FILE(file) != EOF) {
+        printf("Mapped byte input mixed with other reads wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+    file = open_file("test24.txt", "r+b");
+    GETC_FILE(file);
+    seek64_file(file, 1, SEEK_SET);
+    PUTC_FILE(file, '#');
+    seek64_file(file, 0, SEEK_SET);
+    if(GETC_FILE(file) != (unsigned char)data[0] || GETC_FILE(file) != '#' ||
+            GETC_FILE(file) != (unsigned char)data[2]) {
+        printf("Switching between reads and writes wrong.\n");
+        bad = 1;
+    }
+    seek64_file(file, 0, SEEK_SET);
+    PUTC_FILE(file, '<');
+    write_str_file(file, ">");
+    line = next_line_file(file, &len);
+    if(line == NULL || memcmp(line, data + 2, len) != 0 ||
+            line[len-1] != '\n' || (seek64_file(file, 0, SEEK_SET),
+            GETC_FILE(file)) != '<' || GETC_FILE(file) != '>') {
+        printf("Lines after buffered output wrong.\n");
+        bad = 1;
+    }
+    close_file(file);
+
+#ifndef _WIN32
+    /* a pipe keeps the bytes read ahead for the other readers */
+    if(pipe(fds) == 0) {
+        write(fds[1], "abcdef\n12\n", 10);
+        close(fds[1]);
+        file = open_fd_file(fds[0], "rb");
+        if(GETC_FILE(file) != 'a' || tell64_file(file) != -1 ||
+                get_error_file() != FILE_ERROR_TELL ||
+                getc_file(file) != 'b' || read_file(file, buf, 1, 2) != 2 ||
+                memcmp(buf, "cd", 2) != 0 ||
+                readf_file(file, "%d", &c) != EOF ||
+                get_error_file() != FILE_ERROR_READ ||
+                gets_file(file, buf, sizeof(buf)) == NULL ||
+                strcmp(buf, "ef\n") != 0 || GETC_FILE(file) != '1' ||
+                (line = next_line_file(file, &len)) == NULL || len != 2 ||
+                memcmp(line, "2\n", 2) != 0 || GETC_FILE(file) != EOF) {
+            printf("Byte input from a pipe lost.\n");
+            bad = 1;
+        }
+        close_file(file);
+    }
+#endif
+
+    remove("test24.txt");
+    free(data);
+    if(!bad)
+        printf("All byte buffer tests passed.\n");
+    return bad;
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "find.h"
+
+#define SIZE 700000
+#define MAX_MATCH 200000
+
+static find_match_t got[MAX_MATCH];
+static find_match_t want[MAX_MATCH];
+static size_t ngot;
+
+/* collect matches */
+static int
+each_match (const find_match_t *match, void *arg)
+{
+    (void)arg;
+    if(ngot < MAX_MATCH)
+        got[ngot++] = *match;
+    return 0;
+}
+
+/* order by offset, then pattern */
+static int
+cmp_match (const void *a, const void *b)
+{
+    const find_match_t *x = (const find_match_t*)a;
+    const find_match_t *y = (const find_match_t*)b;
+    if(x->offset != y->offset)
+        return x->offset < y->offset ? -1 : 1;
+    return (x->pattern > y->pattern) - (x->pattern < y->pattern);
+}
+
+/* every match the slow way */
+static size_t
+slow_find (const char *data, size_t len, const char **pats, size_t count)
+{
+    size_t i, k, n = 0, m;
+    file_off_t line = 0;
+    for(i = 0; i < len; i++) {
+        for(k = 0; k < count; k++) {
+            m = strlen(pats[k]);
+            if(m <= len - i && memcmp(data + i, pats[k], m) == 0 &&
+                    n < MAX_MATCH) {
+                want[n].offset = (file_off_t)i;
+                want[n].line = line;
+                want[n].pattern = k;
+                n++;
+            }
+        }
+        if(data[i] == '\n')
+            line++;
+    }
+    return n;
+}
+
+/* compare find_all_file() and find_file() with the slow way */
+static int
+check (const char *mode, const char *data, const char **pats, size_t count)
+{
+    find_t *find = create_find(pats, count);
+    file_t *file = open_file("test25.txt", mode);
+    find_match_t match, *found;
+    size_t n = slow_find(data, SIZE, pats, count), i;
+    int ok = (find != NULL);
+
+    ngot = 0;
+    if(ok && find_all_file(file, find, each_match, NULL) != (file_off_t)n)
+        ok = 0;
+    qsort(got, ngot, sizeof(find_match_t), cmp_match);
+    for(i = 0; ok && i < n; i++)
+        if(cmp_match(&got[i], &want[i]) != 0 || got[i].line != want[i].line)
+            ok = 0;
+    /* one at a time from the start again */
+    rewind_file(file);
+    for(ngot = 0; ok && ngot < MAX_MATCH &&
+            find_file(file, find, &match) == 1; ngot++)
+        got[ngot] = match;
+    qsort(got, ngot, sizeof(find_match_t), cmp_match);
+    if(ngot != n)
+        ok = 0;
+    for(i = 0; ok && i < n; i++)
+        if(cmp_match(&got[i], &want[i]) != 0 || got[i].line != want[i].line)
+            ok = 0;
+    /* somewhere else, lines counted back from the end */
+    seek64_file(file, SIZE - 5000, SEEK_SET);
+    if(ok && find_file(file, find, &match) == 1) {
+        found = (find_match_t*)bsearch(&match, want, n, sizeof(find_match_t),
+            cmp_match);
+        if(found == NULL || found->line != match.line ||
+                match.offset < SIZE - 5000)
+            ok = 0;
+    }
+    close_file(file);
+    destroy_find(&find);
+    if(!ok)
+        printf("Search for %s (%lu patterns, mode %s) wrong.\n", pats[0],
+            (unsigned long)count, mode);
+    return ok;
+}
+
+int
+main (void)
+{
+    const char *one[] = { "q" };
+    const char *two[] = { "ab" };
+    const char *five[] = { "abcab" };
+    const char *classic[] = { "he", "she", "his", "hers" };
+    const char *nl[] = { "c\nab", "\n", "bab", "c\nab" };
+    const char *many[64];
+    char names[64][8], *data;
+    const char *bad[] = { "ok", "" };
+    static char longpat[41];
+    const char *lp[1];
+    file_t *file;
+    size_t i;
+    int ok = 1;
+
+    data = (char*)malloc(SIZE);
+    if(data == NULL)
+        return 1;
+    srand(25);
+    for(i = 0; i < SIZE; i++)
+        data[i] = (rand() % 50 == 0) ? '\n' : "abchers q"[rand() % 9];
+    /* a long pattern that shows up across buffer boundaries */
+    memcpy(longpat, data + 262130, 40);
+    memcpy(data + 5, longpat, 40);
+    memcpy(data + SIZE - 40, longpat, 40);
+    lp[0] = longpat;
+    file = open_file("test25.txt", "wb");
+    write_file(file, data, 1, SIZE);
+    close_file(file);
+
+    for(i = 0; i < 64; i++) {
+        sprintf(names[i], "%c%c%c", "abc"[i % 3], "hers"[i / 3 % 4],
+            " q\n"[i / 12 % 3]);
+        names[i][3 + i % 2] = '\0';
+        if(i % 2)
+            names[i][3] = 'a';
+        many[i] = names[i];
+    }
+    ok &= check("rb", data, one, 1);
+    ok &= check("rb", data, two, 1);
+    ok &= check("rbm", data, five, 1);
+    ok &= check("rb", data, five, 1);
+    ok &= check("rb", data, lp, 1);
+    ok &= check("rbm", data, classic, 4);
+    ok &= check("rb", data, classic, 4);
+    ok &= check("rb", data, nl, 4);
+    ok &= check("rb", data, many, 64);
+    ok &= check("rbm", data, many, 64);
+    if(create_find(bad, 2) != NULL || create_find(one, 0) != NULL) {
+        printf("Empty patterns taken.\n");
+        ok = 0;
+    }
+    remove("test25.txt");
+    free(data);
+    if(ok)
+        printf("All search tests passed.\n");
+    return !ok;
+}
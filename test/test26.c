@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "hash.h"
+#include "chunk.h"
+
+#define SIZE (3 << 20)
+#define MAX_CHUNK 4096
+
+typedef struct {
+    file_off_t offset;
+    size_t length;
+    unsigned long long hash[2];
+} piece_t;
+
+static piece_t got[MAX_CHUNK];
+static size_t ngot;
+
+/* collect chunks */
+static int
+each_chunk (const chunk_block_t *block, void *arg)
+{
+    (void)arg;
+    if(ngot < MAX_CHUNK) {
+        got[ngot].offset = block->offset;
+        got[ngot].length = block->length;
+        got[ngot].hash[0] = block->hash[0];
+        got[ngot].hash[1] = block->hash[1];
+        ngot++;
+    }
+    return 0;
+}
+
+/* check the reference values of both hashes */
+static int
+check_hashes (void)
+{
+    static const struct {
+        const char *text;
+        unsigned long long h64, h64s, h128[2];
+    } known[] = {
+        { "", 0xef46db3751d8e999ULL, 0xcf10bc2abb92e160ULL,
+            { 0x0ULL, 0x0ULL } },
+        { "a", 0xd24ec4f1a98c6e5bULL, 0x1033aa399f89f153ULL,
+            { 0x85555565f6597889ULL, 0xe6b53a48510e895aULL } },
+        { "abc", 0x44bc2cf5ad770999ULL, 0xc936fe02972367ccULL,
+            { 0xb4963f3f3fad7867ULL, 0x3ba2744126ca2d52ULL } },
+        { "hello world, chunked and hashed!", 0xa5371d92af1043bbULL,
+            0x3c10d643c6ec9683ULL,
+            { 0x0b08d82977a0a861ULL, 0xac250f59cee94926ULL } }
+    };
+    unsigned char bytes[772];
+    unsigned long long h[2];
+    size_t i;
+    int ok = 1;
+    for(i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+        digest128_hash(known[i].text, strlen(known[i].text), 0, h);
+        if(digest64_hash(known[i].text, strlen(known[i].text), 0) !=
+                known[i].h64 ||
+                digest64_hash(known[i].text, strlen(known[i].text), 25) !=
+                known[i].h64s ||
+                h[0] != known[i].h128[0] || h[1] != known[i].h128[1])
+            ok = 0;
+    }
+    /* long enough for every lane, at an odd address */
+    for(i = 0; i < 768; i++)
+        bytes[i + 1] = (unsigned char)i;
+    memcpy(bytes + 769, "xyz", 3);
+    digest128_hash(bytes + 1, 771, 25, h);
+    if(digest64_hash(bytes + 1, 771, 0) != 0xe921a1b45bd779f8ULL ||
+            h[0] != 0x00e6c6604e10dc43ULL || h[1] != 0xe6cdbe3a2bc5cf69ULL)
+        ok = 0;
+    if(!ok)
+        printf("Hashes differ from the reference.\n");
+    return ok;
+}
+
+/* chunk a file both ways, check chunks against the data */
+static int
+check_chunks (const char *name, const char *mode, const unsigned char *data,
+    size_t size, chunk_t *chunk)
+{
+    static piece_t all[MAX_CHUNK];
+    chunk_block_t block;
+    file_t *file = open_file(name, mode);
+    unsigned long long h[2];
+    size_t i, nall;
+    file_off_t total = 0;
+    int ok = (file != NULL);
+
+    ngot = 0;
+    if(ok && chunk_all_file(file, chunk, each_chunk, NULL) != (file_off_t)ngot)
+        ok = 0;
+    nall = ngot;
+    memcpy(all, got, nall * sizeof(piece_t));
+    for(i = 0; ok && i < nall; i++) {
+        digest128_hash(data + all[i].offset, all[i].length, 0, h);
+        if(all[i].offset != total || all[i].length > 65536 ||
+                (all[i].length < 2048 && i + 1 < nall) ||
+                h[0] != all[i].hash[0] || h[1] != all[i].hash[1])
+            ok = 0;
+        total += (file_off_t)all[i].length;
+    }
+    if(total != (file_off_t)size)
+        ok = 0;
+    /* one at a time gives the same chunks */
+    rewind_file(file);
+    for(ngot = 0; ok && chunk_file(file, chunk, &block) == 1; ) {
+        each_chunk(&block, NULL);
+        if(tell64_file(file) != block.offset + (file_off_t)block.length ||
+                memcmp(block.data, data + block.offset, block.length) != 0)
+            ok = 0;
+    }
+    if(ngot != nall || memcmp(got, all, nall * sizeof(piece_t)) != 0)
+        ok = 0;
+    close_file(file);
+    if(!ok)
+        printf("Chunks of %s (mode %s) wrong.\n", name, mode);
+    return ok;
+}
+
+int
+main (void)
+{
+    static piece_t first[MAX_CHUNK];
+    unsigned char *data;
+    chunk_t *chunk;
+    file_t *file;
+    size_t i, j, nfirst, shared = 0;
+    int ok = 1;
+
+    data = (unsigned char*)malloc(SIZE + 100);
+    if(data == NULL)
+        return 1;
+    srand(26);
+    for(i = 0; i < SIZE; i++)
+        data[i] = (unsigned char)(rand() >> 4);
+    ok &= check_hashes();
+
+    chunk = create_chunk(0, 0, 0);
+    if(chunk == NULL || create_chunk(2048, 5000, 65536) != NULL ||
+            create_chunk(8192, 8192, 65536) != NULL) {
+        printf("Chunk sizes checked wrong.\n");
+        return 1;
+    }
+    file = open_file("test26.dat", "wb");
+    write_file(file, data, 1, SIZE);
+    close_file(file);
+    ok &= check_chunks("test26.dat", "rb", data, SIZE, chunk);
+    ok &= check_chunks("test26.dat", "rbm", data, SIZE, chunk);
+    nfirst = ngot;
+    memcpy(first, got, nfirst * sizeof(piece_t));
+    if(nfirst < SIZE / 8192 / 2 || nfirst > SIZE / 8192 * 2) {
+        printf("Average chunk %lu bytes, far off.\n",
+            (unsigned long)(SIZE / nfirst));
+        ok = 0;
+    }
+
+    /* bytes put in near the start only change the chunks around them */
+    memmove(data + 100100, data + 100000, SIZE - 100000);
+    memset(data + 100000, 'x', 100);
+    file = open_file("test26.dat", "wb");
+    write_file(file, data, 1, SIZE + 100);
+    close_file(file);
+    ok &= check_chunks("test26.dat", "rb", data, SIZE + 100, chunk);
+    for(i = 0; i < ngot; i++)
+        for(j = 0; j < nfirst; j++)
+            if(got[i].hash[0] == first[j].hash[0] &&
+                    got[i].hash[1] == first[j].hash[1]) {
+                shared++;
+                break;
+            }
+    if(shared + 3 < nfirst) {
+        printf("Only %lu of %lu chunks shared after an insert.\n",
+            (unsigned long)shared, (unsigned long)nfirst);
+        ok = 0;
+    }
+
+    destroy_chunk(&chunk);
+    remove("test26.dat");
+    free(data);
+    if(ok)
+        printf("All chunk and hash tests passed.\n");
+    return !ok;
+}
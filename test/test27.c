@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "sort.h"
+
+#define LINES 150000
+#define RECORDS 100000
+
+static char **lines;
+
+/* order two lines by bytes */
+static int
+cmp_line (const void *a, const void *b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* order lines by their number, largest first */
+static int
+cmp_number (const void *a, size_t alen, const void *b, size_t blen,
+    void *arg)
+{
+    long x = strtol((const char*)a, NULL, 10);
+    long y = strtol((const char*)b, NULL, 10);
+    (void)alen;
+    (void)blen;
+    ++*(long*)arg;
+    return (x < y) - (x > y);
+}
+
+/* sort test27.txt into test27.out, check against sorted lines */
+static int
+check_lines (sort_t *sort, size_t count, const char *what)
+{
+    file_t *in = open_file("test27.txt", "rb");
+    file_t *out = open_file("test27.out", "wb");
+    file_off_t n = sort_file(in, out, sort);
+    size_t i = 0, len;
+    const char *line;
+    int ok = (n == (file_off_t)count);
+
+    close_file(in);
+    close_file(out);
+    out = open_file("test27.out", "rb");
+    while(ok && (line = next_line_file(out, &len)) != NULL) {
+        if(i >= count || len != strlen(lines[i]) + 1 ||
+                memcmp(line, lines[i], len - 1) != 0 || line[len-1] != '\n')
+            ok = 0;
+        i++;
+    }
+    close_file(out);
+    if(!ok || i != count) {
+        printf("Sorting lines %s wrong.\n", what);
+        return 0;
+    }
+    return 1;
+}
+
+int
+main (void)
+{
+    static unsigned char rec[RECORDS][16];
+    unsigned char r[16];
+    file_t *file, *out;
+    sort_t *sort;
+    size_t i, j, len;
+    long calls = 0, prev, x;
+    int ok = 1;
+
+    /* random lines, a few empty and one far longer than the buffers */
+    lines = (char**)malloc(LINES * sizeof(char*));
+    srand(27);
+    file = open_file("test27.txt", "wb");
+    for(i = 0; i < LINES; i++) {
+        len = (i == 777) ? 100000 : (size_t)(rand() % 24);
+        lines[i] = (char*)malloc(len + 1);
+        for(j = 0; j < len; j++)
+            lines[i][j] = "abcdefgh xyz"[rand() % (i % 3 ? 12 : 2)];
+        lines[i][len] = '\0';
+        write_file(file, lines[i], 1, len);
+        if(i + 1 < LINES)
+            write_file(file, "\n", 1, 1);
+    }
+    close_file(file);
+    qsort(lines, LINES, sizeof(char*), cmp_line);
+
+    /* all in memory on several threads, then spilled in many runs */
+    sort = create_sort(0);
+    set_threads_sort(sort, 4);
+    ok &= check_lines(sort, LINES, "in memory");
+    set_memory_sort(sort, 1 << 16);
+    set_temp_sort(sort, ".");
+    ok &= check_lines(sort, LINES, "spilled");
+    set_threads_sort(sort, 1);
+    set_memory_sort(sort, 1 << 20);
+    ok &= check_lines(sort, LINES, "on one thread");
+    destroy_sort(&sort);
+
+    /* numbers, through a comparator */
+    file = open_file("test27.txt", "wb");
+    for(i = 0; i < 20000; i++)
+        writef_file(file, "%d\n", rand() % 100000 - 50000);
+    close_file(file);
+    sort = create_sort(0);
+    set_compare_sort(sort, cmp_number, &calls);
+    set_memory_sort(sort, 1 << 16);
+    file = open_file("test27.txt", "rb");
+    out = open_file("test27.out", "w+b");
+    if(sort_file(file, out, sort) != 20000 || calls == 0)
+        ok = 0;
+    rewind_file(out);
+    for(i = 0, prev = 50000; readf_file(out, "%ld", &x) == 1; i++) {
+        if(x > prev)
+            ok = 0;
+        prev = x;
+    }
+    if(i != 20000) {
+        printf("Sorting with a comparator wrong.\n");
+        ok = 0;
+    }
+    close_file(file);
+    close_file(out);
+    destroy_sort(&sort);
+
+    /* records by a two byte key, equal keys keep their order */
+    file = open_file("test27.dat", "wb");
+    for(i = 0; i < RECORDS; i++) {
+        memset(r, 0, sizeof(r));
+        r[4] = (unsigned char)(rand() % 7);
+        r[5] = (unsigned char)rand();
+        r[8] = (unsigned char)(i >> 16);
+        r[9] = (unsigned char)(i >> 8);
+        r[10] = (unsigned char)i;
+        write_file(file, r, 1, sizeof(r));
+    }
+    close_file(file);
+    sort = create_sort(16);
+    set_key_sort(sort, 4, 2);
+    set_memory_sort(sort, 1 << 18);
+    file = open_file("test27.dat", "rb");
+    out = open_file("test27.out", "w+b");
+    if(sort_file(file, out, sort) != RECORDS)
+        ok = 0;
+    rewind_file(out);
+    if(read_file(out, rec, sizeof(rec[0]), RECORDS) != RECORDS)
+        ok = 0;
+    for(i = 1; ok && i < RECORDS; i++) {
+        j = memcmp(rec[i-1] + 4, rec[i] + 4, 2) < 0 ||
+            (memcmp(rec[i-1] + 4, rec[i] + 4, 2) == 0 &&
+            memcmp(rec[i-1] + 8, rec[i] + 8, 3) < 0);
+        if(!j) {
+            printf("Records out of order at %lu.\n", (unsigned long)i);
+            ok = 0;
+        }
+    }
+    close_file(file);
+    close_file(out);
+
+    /* a part record at the end */
+    file = open_file("test27.dat", "ab");
+    write_file(file, "xyz", 1, 3);
+    close_file(file);
+    file = open_file("test27.dat", "rb");
+    out = open_file("test27.out", "wb");
+    if(sort_file(file, out, sort) != -1) {
+        printf("Part record not refused.\n");
+        ok = 0;
+    }
+    close_file(file);
+    close_file(out);
+    destroy_sort(&sort);
+
+    for(i = 0; i < LINES; i++)
+        free(lines[i]);
+    free(lines);
+    remove("test27.txt");
+    remove("test27.dat");
+    remove("test27.out");
+    if(ok)
+        printf("All sort tests passed.\n");
+    return !ok;
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "record.h"
+
+#define COUNT 50000
+
+typedef struct {
+    double value;
+    long when;
+    int sensor;
+    char tag[4];
+} sample_t;
+
+/* the sample every index should hold */
+static void
+make_sample (sample_t *s, long i)
+{
+    memset(s, 0, sizeof(*s));
+    s->value = (double)i * 0.5;
+    s->when = 1000000L + i;
+    s->sensor = (int)(i % 97);
+    memcpy(s->tag, "tmp", 4);
+}
+
+int
+main (void)
+{
+    static sample_t batch[1000];
+    const sample_t *view;
+    sample_t s, want;
+    record_t *rec;
+    file_t *file;
+    file_off_t count;
+    long i;
+    int ok = 1;
+
+    /* one at a time, then in bulk */
+    rec = open_record("test28.dat", "w", sizeof(sample_t));
+    for(i = 0; i < 1000; i++) {
+        make_sample(&s, i);
+        if(put_record(rec, i, &s) != 0)
+            ok = 0;
+    }
+    for(; i < COUNT; i += 1000) {
+        for(count = 0; count < 1000; count++)
+            make_sample(&batch[count], i + (long)count);
+        if(append_record(rec, batch, 1000) != i)
+            ok = 0;
+    }
+    /* read back and overwrite in the middle of writing */
+    make_sample(&want, 777);
+    if(get_record(rec, 777, &s) != 0 || memcmp(&s, &want, sizeof(s)) != 0 ||
+            get_record(rec, COUNT, &s) != -1 ||
+            put_record(rec, COUNT + 1, &s) != -1)
+        ok = 0;
+    make_sample(&s, -1);
+    put_record(rec, 12345, &s);
+    if(get_count_record(rec) != COUNT || !ok) {
+        printf("Writing records wrong.\n");
+        ok = 0;
+    }
+    close_record(rec);
+
+    /* mapped, read in place */
+    rec = open_record("test28.dat", "r", 0);
+    view = (const sample_t*)get_view_record(rec, &count);
+    if(rec == NULL || view == NULL || count != COUNT ||
+            get_size_record(rec) != sizeof(sample_t)) {
+        printf("Mapped record file wrong.\n");
+        return 1;
+    }
+    for(i = 0; i < COUNT; i++) {
+        make_sample(&want, (i == 12345) ? -1 : i);
+        if(memcmp(&view[i], &want, sizeof(want)) != 0)
+            ok = 0;
+    }
+    if(get_record(rec, COUNT - 1, &s) != 0 ||
+            memcmp(&s, &view[COUNT-1], sizeof(s)) != 0 ||
+            append_record(rec, &s, 1) != -1) {
+        printf("Reading mapped records wrong.\n");
+        ok = 0;
+    }
+    close_record(rec);
+
+    /* a torn record at the end is dropped and written over */
+    file = open_file("test28.dat", "ab");
+    write_file(file, "torn", 1, 4);
+    close_file(file);
+    rec = open_record("test28.dat", "r+", sizeof(sample_t));
+    if(rec == NULL || get_count_record(rec) != COUNT) {
+        printf("Torn record not dropped.\n");
+        return 1;
+    }
+    for(i = COUNT - 3; i < COUNT; i++) {
+        get_record(rec, i, &s);
+        s.sensor = -s.sensor;
+        put_record(rec, i, &s);
+    }
+    make_sample(&s, COUNT);
+    put_record(rec, COUNT, &s);
+    close_record(rec);
+    rec = open_record("test28.dat", "r+", 0);
+    make_sample(&want, COUNT - 2);
+    want.sensor = -want.sensor;
+    if(get_count_record(rec) != COUNT + 1 ||
+            get_record(rec, COUNT - 2, &s) != 0 ||
+            memcmp(&s, &want, sizeof(s)) != 0) {
+        printf("Updating records wrong.\n");
+        ok = 0;
+    }
+    close_record(rec);
+
+    /* wrong size, not a record file or missing */
+    if(open_record("test28.dat", "r", 8) != NULL ||
+            open_record("test28.dat", "w", 0) != NULL ||
+            open_record("test28.c", "r", 0) != NULL ||
+            open_record("test28.none", "r+", 0) != NULL ||
+            open_record("test28.none", "r", 0) != NULL ||
+            open_record("test28.none/x.dat", "w", 8) != NULL) {
+        printf("Bad record files opened.\n");
+        ok = 0;
+    }
+
+    remove("test28.dat");
+    if(ok)
+        printf("All record tests passed.\n");
+    return !ok;
+}
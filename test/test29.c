@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "utf8.h"
+
+#define TEXT 300000
+
+/* encode code point c at p, returns its length */
+static size_t
+encode (unsigned char *p, unsigned long c)
+{
+    if(c < 0x80) {
+        p[0] = (unsigned char)c;
+        return 1;
+    }
+    if(c < 0x800) {
+        p[0] = (unsigned char)(0xC0 | (c >> 6));
+        p[1] = (unsigned char)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    if(c < 0x10000) {
+        p[0] = (unsigned char)(0xE0 | (c >> 12));
+        p[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+        p[2] = (unsigned char)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    p[0] = (unsigned char)(0xF0 | (c >> 18));
+    p[1] = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+    p[2] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+    p[3] = (unsigned char)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+/* a random code point, mostly ASCII, never a surrogate */
+static unsigned long
+random_char (void)
+{
+    unsigned long c;
+    switch(rand() % 8) {
+    case 0: c = 0x80 + (unsigned long)rand() % 0x780; break;
+    case 1: c = 0x800 + (unsigned long)rand() % 0xF800; break;
+    case 2: c = 0x10000 + (unsigned long)rand() % 0x100000; break;
+    default: c = (unsigned long)(rand() % 0x7F) + 1; break;
+    }
+    return (c >= 0xD800 && c < 0xE000) ? 'x' : c;
+}
+
+/* byte by byte reference: offset of the first bad character */
+static size_t
+reference (const unsigned char *p, size_t len)
+{
+    size_t i = 0, n, k;
+    unsigned char lo, hi;
+    while(i < len) {
+        if(p[i] < 0x80) {
+            i++;
+            continue;
+        }
+        lo = 0x80;
+        hi = 0xBF;
+        if(p[i] >= 0xC2 && p[i] <= 0xDF)
+            n = 2;
+        else if(p[i] >= 0xE0 && p[i] <= 0xEF)
+            n = 3;
+        else if(p[i] >= 0xF0 && p[i] <= 0xF4)
+            n = 4;
+        else
+            return i;
+        if(p[i] == 0xE0)
+            lo = 0xA0;
+        else if(p[i] == 0xED)
+            hi = 0x9F;
+        else if(p[i] == 0xF0)
+            lo = 0x90;
+        else if(p[i] == 0xF4)
+            hi = 0x8F;
+        if(i + n > len || p[i+1] < lo || p[i+1] > hi)
+            return i;
+        for(k = 2; k < n; k++)
+            if((p[i+k] & 0xC0) != 0x80)
+                return i;
+        i += n;
+    }
+    return len;
+}
+
+/* every way of reading test29.txt with checking on; returns the offset */
+static file_off_t
+read_checked (int how)
+{
+    file_t *file = open_file("test29.txt", how == 2 ? "rbm" : "rb");
+    char buf[7], line[100];
+    size_t len;
+    file_off_t bad;
+    int c;
+    set_utf8_file(file, 1);
+    if(how == 0) {
+        while(next_line_file(file, &len) != NULL)
+            ;
+    } else if(how == 1) {
+        while((c = GETC_FILE(file)) != EOF)
+            ;
+    } else if(how == 2) {
+        while(next_line_file(file, &len) != NULL &&
+                (c = getc_file(file)) != EOF)
+            ;
+    } else if(how == 3) {
+        while(read_file(file, buf, 1, sizeof(buf)) > 0)
+            ;
+    } else {
+        /* lines with short reads in between, pushing read-ahead back */
+        while(next_line_file(file, &len) != NULL &&
+                read_file(file, buf, 1, 3) > 0 &&
+                gets_file(file, line, sizeof(line)) != NULL)
+            ;
+    }
+    bad = check_utf8_file(file);
+    if(bad >= 0 && get_error_file() != FILE_ERROR_UTF8)
+        bad = -2;
+    close_file(file);
+    return bad;
+}
+
+int
+main (void)
+{
+    static const char *bad[] = {
+        "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF",
+        "\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x80\x80\x80", "\xF0\x8F\xBF",
+        "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\x80", "\xBF\x80",
+        "\xE2\x82", "\xE2\x82\xE2\x82\xAC", "\xC3\xC3\xA9", "\xF0\x9F\x98",
+        "\xF0\x9F\x98\x80\x80"
+    };
+    static unsigned char text[TEXT + 8], buf[256];
+    static unsigned short u16[TEXT];
+    static unsigned int u32[TEXT], want[TEXT];
+    size_t i, j, k, n, len, units;
+    file_t *file;
+    int ok = 1, how;
+
+    /* random valid text, some code points at the edges */
+    srand(29);
+    for(len = n = 0; len < TEXT - 4; n++) {
+        want[n] = (unsigned int)random_char();
+        if(n % 1000 == 7)
+            want[n] = (n % 3000 == 7) ? 0x10FFFF : (n % 3000 == 1007) ?
+                0xFFFF : 0x7FF;
+        len += encode(text + len, want[n]);
+    }
+    if(check_utf8(text, len) != len || reference(text, len) != len) {
+        printf("Valid text refused.\n");
+        ok = 0;
+    }
+
+    /* each bad sequence anywhere in text of every kind */
+    for(i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        for(j = 0; j < 200; j++) {
+            memcpy(buf, text + (j * 37) % 1000, sizeof(buf));
+            k = strlen(bad[i]);
+            memcpy(buf + j % 100, bad[i], k);
+            n = 100 + (size_t)rand() % 150;
+            if(check_utf8(buf, n) != reference(buf, n)) {
+                printf("Bad sequence %lu at %lu missed.\n",
+                    (unsigned long)i, (unsigned long)(j % 100));
+                ok = 0;
+                break;
+            }
+        }
+    }
+
+    /* random bytes near UTF-8 */
+    for(i = 0; ok && i < 20000; i++) {
+        n = (size_t)rand() % sizeof(buf);
+        memcpy(buf, text + (size_t)rand() % 10000, n);
+        for(j = (size_t)rand() % 3; j > 0 && n > 0; j--)
+            buf[(size_t)rand() % n] = (unsigned char)rand();
+        if(check_utf8(buf, n) != reference(buf, n)) {
+            printf("Random bytes checked wrong.\n");
+            ok = 0;
+        }
+    }
+
+    /* characters cut off at the end */
+    if(split_utf8("ab\xE2\x82", 4) != 2 ||
+            split_utf8("ab\xE2\x82\xAC", 5) != 5 ||
+            split_utf8("\xF0\x9F\x98", 3) != 0 || split_utf8("abc", 3) != 3 ||
+            split_utf8("a\x80\x80\x80", 4) != 4 || split_utf8("", 0) != 0 ||
+            check_utf8("ab\xE2\x82", 4) != 2) {
+        printf("Splitting wrong.\n");
+        ok = 0;
+    }
+
+    /* conversions */
+    n = decode32_utf8(text, len, u32);
+    units = decode16_utf8(text, len, u16);
+    for(i = j = 0; n != (size_t)-1 && i < n; i++) {
+        if(u32[i] != want[i])
+            break;
+        if(want[i] >= 0x10000) {
+            if(u16[j] != 0xD800 + ((want[i] - 0x10000) >> 10) ||
+                    u16[j+1] != 0xDC00 + ((want[i] - 0x10000) & 0x3FF))
+                break;
+            j += 2;
+        } else if(u16[j++] != want[i]) {
+            break;
+        }
+    }
+    if(i != n || j != units || decode16_utf8("a\xED\xA0\x80", 4, u16) !=
+            (size_t)-1 || decode32_utf8("a\xC3", 2, u32) != (size_t)-1) {
+        printf("Converting wrong.\n");
+        ok = 0;
+    }
+
+    /* text read from a file is checked as it goes */
+    for(i = 0; i < len; i++)
+        if(i % 61 == 60 && text[i] < 0x80)
+            text[i] = '\n';
+    file = open_file("test29.txt", "wb");
+    write_file(file, text, 1, len);
+    close_file(file);
+    for(how = 0; how < 5; how++) {
+        if(read_checked(how) != -1) {
+            printf("Good file refused reading %d.\n", how);
+            ok = 0;
+        }
+    }
+    k = len - 70000;
+    while(text[k] >= 0x80)
+        k++;
+    text[k] = 0xC0;
+    file = open_file("test29.txt", "wb");
+    write_file(file, text, 1, len);
+    write_file(file, "\xE2\x82", 1, 2);
+    close_file(file);
+    for(how = 0; how < 5; how++) {
+        if(read_checked(how) != (file_off_t)k) {
+            printf("Bad file not caught reading %d.\n", how);
+            ok = 0;
+        }
+    }
+    text[k] = 'x';
+    file = open_file("test29.txt", "wb");
+    write_file(file, text, 1, len);
+    write_file(file, "\xE2\x82", 1, 2);
+    close_file(file);
+    if(read_checked(0) != (file_off_t)len || read_checked(2) !=
+            (file_off_t)len) {
+        printf("Cut off end not caught.\n");
+        ok = 0;
+    }
+
+    remove("test29.txt");
+    if(ok)
+        printf("All UTF-8 tests passed.\n");
+    return !ok;
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "clogger.h"
+#include "tpool.h"
+
+#define THREADS 4
+#define MESSAGES 20000
+
+static int ids[THREADS];
+
+/* one producer, numbering its messages */
+static void
+producer (void *arg)
+{
+    int id = *(int*)arg, i;
+    for(i = 0; i < MESSAGES; i++)
+        write_log(CLOG0, "thread %d message %d %s\n", id, i,
+            (i % 1000 == 0) ? "padding the line out a bit further" : "");
+}
+
+/* log from every thread, then check each kept its order; returns the
+ * number of messages found, or -1
+ */
+static long
+run (size_t ring, int overflow, unsigned long *noted)
+{
+    tpool_t *pool = create_tpool(THREADS);
+    int next[THREADS], id, n, i;
+    const char *line;
+    char text[128];
+    unsigned long drops;
+    file_t *file;
+    long found = 0;
+    size_t len;
+
+    remove("test30.log");
+    open_log(CLOG0, "test30.log");
+    if(set_async_log(CLOG0, ring, overflow) != 0 ||
+            set_async_log(CLOG0, ring, overflow) != -1)
+        return -1;
+    for(i = 0; i < THREADS; i++) {
+        ids[i] = i;
+        next[i] = 0;
+        add_tpool(pool, producer, &ids[i]);
+    }
+    wait_tpool(pool);
+    destroy_tpool(&pool);
+    close_log(CLOG0);
+
+    *noted = 0;
+    file = open_file("test30.log", "rb");
+    while((line = next_line_file(file, &len)) != NULL) {
+        /* the slice has no terminator */
+        if(len >= sizeof(text))
+            return -1;
+        memcpy(text, line, len);
+        text[len] = '\0';
+        if(sscanf(text, "thread %d message %d", &id, &n) == 2) {
+            if(id < 0 || id >= THREADS || n < next[id])
+                return -1;
+            next[id] = n + 1;
+            found++;
+        } else if(sscanf(text, "clogger: %lu messages dropped", &drops)
+                == 1) {
+            *noted += drops;
+        } else {
+            return -1;
+        }
+    }
+    close_file(file);
+    return found;
+}
+
+int
+main (void)
+{
+    char buf[64];
+    unsigned long noted;
+    const char *line;
+    file_t *file;
+    long found;
+    size_t len;
+    int ok = 1, i;
+
+    init_logger();
+
+    /* nothing may be lost when producers wait */
+    if(run(0, CLOG_BLOCK, &noted) != THREADS * MESSAGES ||
+            run(4096, CLOG_BLOCK, &noted) != THREADS * MESSAGES) {
+        printf("Blocking async log lost messages.\n");
+        ok = 0;
+    }
+
+    /* a small ring drops, counted or not */
+    found = run(4096, CLOG_COUNT, &noted);
+    if(found < 0 || (unsigned long)found + noted != THREADS * MESSAGES) {
+        printf("Counted drops wrong: %ld found, %lu noted.\n", found,
+            noted);
+        ok = 0;
+    }
+    found = run(4096, CLOG_DROP, &noted);
+    if(found <= 0 || found > THREADS * MESSAGES || noted != 0) {
+        printf("Dropping async log wrong.\n");
+        ok = 0;
+    }
+
+    /* reading sees what was written, long messages are cut */
+    remove("test30.log");
+    open_log(CLOG0, "test30.log");
+    set_async_log(CLOG0, 4096, CLOG_BLOCK);
+    write_log(CLOG0, "first %d\n", 1);
+    write_log(CLOG0, "%2000d\n", 2);
+    flush_log(CLOG0);
+    if(read_log(CLOG0, buf, sizeof(buf)) != '\n' ||
+            strcmp(buf, "first 1") != 0 || get_dropped_log(CLOG0) != 0) {
+        printf("Reading async log wrong.\n");
+        ok = 0;
+    }
+    close_log(CLOG0);
+    file = open_file("test30.log", "rb");
+    if(get_size64_file(file) != 8 + 1015) {
+        printf("Long message not cut short.\n");
+        ok = 0;
+    }
+    close_file(file);
+
+    /* every drop is noted by the time the log is closed */
+    remove("test30.log");
+    open_log(CLOG0, "test30.log");
+    set_async_log(CLOG0, 4096, CLOG_COUNT);
+    for(i = 0; i < 100; i++)
+        write_log(CLOG0, "%1000d\n", i);
+    close_log(CLOG0);
+    found = 0;
+    noted = 0;
+    file = open_file("test30.log", "rb");
+    while((line = next_line_file(file, &len)) != NULL) {
+        if(len > 9 && strncmp(line, "clogger: ", 9) == 0)
+            noted += strtoul(line + 9, NULL, 10);
+        else
+            found++;
+    }
+    close_file(file);
+    if((unsigned long)found + noted != 100) {
+        printf("Drops at close not noted: %ld found, %lu noted.\n", found,
+            noted);
+        ok = 0;
+    }
+
+    remove("test30.log");
+    if(ok)
+        printf("All async log tests passed.\n");
+    return !ok;
+}
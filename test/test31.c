@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "clogger.h"
+
+#define MESSAGES 20000
+
+static char want[1 << 20];
+static size_t nwant;
+
+/* decode test31.log; returns the messages, text in *text of *len */
+static long
+decode (int stamp, char **text, size_t *len)
+{
+    file_t *in = open_file("test31.log", "rb");
+    file_t *out = open_memory_file(NULL, 0, "w");
+    const void *data;
+    long res = decode_log(in, out, stamp);
+    data = get_memory_file(out, len);
+    *text = (char*)malloc(*len + 1);
+    memcpy(*text, data, *len);
+    (*text)[*len] = '\0';
+    close_file(out);
+    close_file(in);
+    return res;
+}
+
+/* decode a log of one message of format fmt with a string argument */
+static long
+crafted (const char *fmt)
+{
+    unsigned char rec[128];
+    size_t len = strlen(fmt), n;
+    file_t *in, *out;
+    long res;
+    memcpy(rec, "PRSLOG\001\n", 8);
+    n = 8;
+    rec[n++] = 'F';
+    memcpy(rec + n, "\001\0\0\0", 4);
+    rec[n+4] = (unsigned char)len;
+    memset(rec + n + 5, 0, 3);
+    memcpy(rec + n + 8, fmt, len);
+    n += 8 + len;
+    /* id 1, no time, an 8 byte string "abcd" */
+    memcpy(rec + n, "M\001\0\0\0\0\0\0\0\0\0\0\0\010\0\0\0"
+        "\004\0\0\0abcd", 25);
+    n += 25;
+    in = open_memory_file(rec, n, "r");
+    out = open_memory_file(NULL, 0, "w");
+    res = decode_log(in, out, 0);
+    close_file(out);
+    close_file(in);
+    return res;
+}
+
+/* write the messages of every kind, keeping their text in want */
+static void
+mixed (void)
+{
+    static const char cut[3] = { 'a', 'b', 'c' };
+    const char *none = NULL;
+    int i;
+    nwant = 0;
+    for(i = 0; i < 100; i++) {
+        write_log(CLOG0, "plain %d of %u, %ld %lld %zu %hd %hhu\n", i,
+            100u, -7L * i, 1LL << 40, (size_t)i, (short)-i,
+            (unsigned char)(i + 250));
+        nwant += (size_t)sprintf(want + nwant,
+            "plain %d of %u, %ld %lld %lu %hd %hhu\n", i, 100u, -7L * i,
+            1LL << 40, (unsigned long)i, (short)-i, (unsigned char)(i + 250));
+        write_log(CLOG0, "%-8s|%5.2f|%e|%x|%#o|%c|%%|%*d|%.*s|%.3s\n",
+            "name", i / 3.0, i * 1e10, i * 4099, i, 'A' + i % 26, 6, i,
+            i % 4, "string", cut);
+        nwant += (size_t)sprintf(want + nwant,
+            "%-8s|%5.2f|%e|%x|%#o|%c|%%|%*d|%.*s|%.3s\n",
+            "name", i / 3.0, i * 1e10, i * 4099, i, 'A' + i % 26, 6, i,
+            i % 4, "string", cut);
+    }
+    write_log(CLOG0, "null %s\n", none);
+    nwant += (size_t)sprintf(want + nwant, "null %s\n", "(null)");
+    /* no raw form for long double, stored as text */
+    write_log(CLOG0, "long double %Lf\n", (long double)2.5);
+    nwant += (size_t)sprintf(want + nwant, "long double %Lf\n",
+        (long double)2.5);
+    write_log(CLOG0, "%s\n", "done");
+    nwant += (size_t)sprintf(want + nwant, "done\n");
+}
+
+int
+main (void)
+{
+    char *text, *p;
+    size_t len;
+    file_t *file, *out;
+    long res, n;
+    int ok = 1, i, id;
+
+    init_logger();
+
+    /* written and read back the same as printf would */
+    remove("test31.log");
+    attach_log(CLOG0, open_file("test31.log", "wb"));
+    if(set_binary_log(CLOG0) != 0 || set_binary_log(CLOG0) != -1) {
+        printf("Binary mode not set once.\n");
+        ok = 0;
+    }
+    mixed();
+    close_log(CLOG0);
+    res = decode(0, &text, &len);
+    if(res != 203 || len != nwant || memcmp(text, want, len) != 0) {
+        printf("Decoded text wrong: %ld messages.\n", res);
+        ok = 0;
+    }
+    free(text);
+
+    /* each message stamped with its time */
+    res = decode(1, &text, &len);
+    if(res != 203 || len < 30 || text[4] != '-' || text[10] != ' ' ||
+            text[19] != '.' || text[29] != ' ' ||
+            strncmp(text + 30, "plain 0 ", 8) != 0) {
+        printf("Stamped text wrong.\n");
+        ok = 0;
+    }
+    free(text);
+
+    /* a second session starts its formats over */
+    attach_log(CLOG0, open_file("test31.log", "ab"));
+    set_binary_log(CLOG0);
+    write_log(CLOG0, "again %d\n", 2);
+    close_log(CLOG0);
+    res = decode(0, &text, &len);
+    if(res != 204 || len != nwant + 8 ||
+            strcmp(text + nwant, "again 2\n") != 0) {
+        printf("Second session wrong.\n");
+        ok = 0;
+    }
+    free(text);
+
+    /* a record cut off at the end is left out, text is refused */
+    file = open_file("test31.log", "rb");
+    len = (size_t)get_size64_file(file);
+    text = (char*)malloc(len);
+    read_file(file, text, 1, len);
+    close_file(file);
+    file = open_file("test31.log", "wb");
+    write_file(file, text, 1, len - 1);
+    close_file(file);
+    free(text);
+    res = decode(0, &text, &len);
+    free(text);
+    file = open_file("test31.c", "rb");
+    out = open_memory_file(NULL, 0, "w");
+    if(res != 203 || decode_log(file, out, 0) != -1) {
+        printf("Damaged logs decoded wrong.\n");
+        ok = 0;
+    }
+    close_file(out);
+    close_file(file);
+
+    /* formats write_log() never stores raw are refused, not printed */
+    if(crafted("%s %n x\n") != -1 || crafted("%Lf\n") != -1 ||
+            crafted("%ls\n") != -1 || crafted("%s x\n") != 1) {
+        printf("Crafted formats decoded wrong.\n");
+        ok = 0;
+    }
+
+    /* through the ring of an async log */
+    remove("test31.log");
+    attach_log(CLOG0, open_file("test31.log", "wb"));
+    set_async_log(CLOG0, 4096, CLOG_BLOCK);
+    set_binary_log(CLOG0);
+    for(i = 0; i < MESSAGES; i++)
+        write_log(CLOG0, "async %d %s\n", i, (i % 3) ? "x" : "yy");
+    mixed();
+    close_log(CLOG0);
+    res = decode(0, &text, &len);
+    for(p = text, n = 0; n < MESSAGES; n++) {
+        if(sscanf(p, "async %d", &id) != 1 || id != n)
+            break;
+        p = strchr(p, '\n') + 1;
+    }
+    if(res != MESSAGES + 203 || n != MESSAGES ||
+            (size_t)(text + len - p) != nwant ||
+            memcmp(p, want, nwant) != 0) {
+        printf("Async binary log wrong.\n");
+        ok = 0;
+    }
+    free(text);
+
+    remove("test31.log");
+    if(ok)
+        printf("All binary log tests passed.\n");
+    return !ok;
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+
+/* program to test mapped read mode against plain stdio reads */
+int
+main ()
+{
+    file_t *map, *file;
+    const char *view;
+    char buf[64], line[64];
+    size_t len;
+    int c;
+
+    map = open_file("test.c", "rbm");
+    if(map == NULL || get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    file = open_file("test.c", "rb");
+    if(file == NULL || get_error_file() != FILE_ERROR_OKAY) {
+        close_file(map);
+        return 1;
+    }
+    view = get_view_file(map, &len);
+    if(view == NULL || (long)len != get_size_file(file))
+        goto error;
+    while((c = getc_file(file)) != EOF)
+        if(c != getc_file(map))
+            goto error;
+    if(getc_file(map) != EOF || tell_file(map) != (long)len)
+        goto error;
+
+    /* seeking and reading through the mapping */
+    seek_file(map, 10, SEEK_SET);
+    if(read_file(map, buf, 1, sizeof(buf)) != (int)sizeof(buf) ||
+            memcmp(buf, view + 10, sizeof(buf)) != 0)
+        goto error;
+    seek_file(map, -5, SEEK_END);
+    if(read_file(map, buf, 1, sizeof(buf)) != 5)
+        goto error;
+    rewind_file(map);
+    rewind_file(file);
+    if(gets_file(map, line, sizeof(line)) == NULL ||
+            gets_file(file, buf, sizeof(buf)) == NULL ||
+            strcmp(line, buf) != 0)
+        goto error;
+    if(get_lines_file(map) != get_lines_file(file))
+        goto error;
+    close_file(file);
+    close_file(map);
+    printf("Mapped view matches file.\n");
+    return 0;
+
+error:
+    printf("Error: mapped view does not match file.\n");
+    close_file(file);
+    close_file(map);
+    return 1;
+}
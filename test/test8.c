@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+
+/* program to test the line index and random line access */
+int
+main ()
+{
+    char buf[64], expect[64];
+    file_t *f, *g = NULL;
+    int i;
+
+    f = open_file("test8.txt", "w+t");
+    if(get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    for(i = 0; i < 1000; i++)
+        writef_file(f, "Line number %d of the index test.\n", i);
+    if(get_lines_file(f) != 1000)
+        goto error;
+
+    /* the index grows with the file */
+    seek_file(f, 0, SEEK_END);
+    for(i = 1000; i < 1500; i++)
+        writef_file(f, "Line number %d of the index test.\n", i);
+    if(get_lines_file(f) != 1500)
+        goto error;
+    for(i = 1499; i >= 0; i -= 37) {
+        if(get_line_at_file(f, i) != 0 ||
+                gets_file(f, buf, sizeof(buf)) == NULL)
+            goto error;
+        sprintf(expect, "Line number %d of the index test.\n", i);
+        if(strcmp(buf, expect) != 0)
+            goto error;
+    }
+    if(get_line_at_file(f, 1500) == 0)
+        goto error;
+    get_error_file();
+
+    /* rewriting a line drops everything indexed after it */
+    get_line_at_file(f, 10);
+    writef_file(f, "short\nlines\n");
+    if(get_lines_file(f) != 1502)
+        goto error;
+    get_line_at_file(f, 11);
+    if(gets_file(f, buf, sizeof(buf)) == NULL || strcmp(buf, "lines\n"))
+        goto error;
+
+    /* same answers through a mapped view */
+    f = reopen_file(f, "rtm");
+    if(f == NULL || get_lines_file(f) != 1502 ||
+            get_line_at_file(f, 1400) != 0 ||
+            gets_file(f, buf, sizeof(buf)) == NULL ||
+            strcmp(buf, "Line number 1398 of the index test.\n") != 0)
+        goto error;
+    close_file(f);
+
+    /* the size and the index follow writes through another handle */
+    f = open_file("test8.txt", "wt");
+    writef_file(f, "a\nb\n");
+    close_file(f);
+    f = open_file("test8.txt", "rt");
+    g = open_file("test8.txt", "at");
+    if(get_error_file() != FILE_ERROR_OKAY || get_size_file(f) != 4 ||
+            get_lines_file(f) != 2)
+        goto error;
+    writef_file(g, "c\nd\n");
+    flush_file(g);
+    if(get_size_file(f) != 8 || get_lines_file(f) != 4 ||
+            get_line_at_file(f, 3) != 0 ||
+            gets_file(f, buf, sizeof(buf)) == NULL || strcmp(buf, "d\n"))
+        goto error;
+    close_file(g);
+    remove(get_name_file(f));
+    close_file(f);
+    printf("Line index is correct.\n");
+    return 0;
+
+error:
+    printf("Error: line index is wrong.\n");
+    if(g != NULL)
+        close_file(g);
+    if(f != NULL) {
+        remove(get_name_file(f));
+        close_file(f);
+    }
+    return 1;
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+#include "file.h"
+
+/* program to test the zero-copy line cursor */
+int
+main ()
+{
+    static char big[200000];
+    const char *line;
+    file_t *f;
+    size_t len;
+    int i, n;
+
+    f = open_file("test9.txt", "w+b");
+    if(get_error_file() != FILE_ERROR_OKAY)
+        return 1;
+    memset(big, 'x', sizeof(big));
+    for(i = 0; i < 100; i++)
+        writef_file(f, "line %d\n", i);
+    write_file(f, big, 1, sizeof(big));
+    writef_file(f, "\nlast line");
+    rewind_file(f);
+
+    /* short lines, then one longer than the buffer */
+    for(n = 0; (line = next_line_file(f, &len)) != NULL && n < 100; n++) {
+        char expect[32];
+        sprintf(expect, "line %d\n", n);
+        if(len != strlen(expect) || memcmp(line, expect, len) != 0)
+            goto error;
+        if(n == 50 && tell_file(f) != 10*7 + 41*8)
+            goto error;
+    }
+    if(line == NULL || len != sizeof(big) + 1 ||
+            memcmp(line, big, sizeof(big)) != 0)
+        goto error;
+    line = next_line_file(f, &len);
+    if(line == NULL || len != 9 || memcmp(line, "last line", 9) != 0)
+        goto error;
+    if(next_line_file(f, &len) != NULL)
+        goto error;
+
+    /* other calls pick up right after the last line handed out */
+    rewind_file(f);
+    next_line_file(f, &len);
+    if(getc_file(f) != 'l' || tell_file(f) != 8)
+        goto error;
+    remove(get_name_file(f));
+    close_file(f);
+    printf("Line cursor is correct.\n");
+    return 0;
+
+error:
+    printf("Error: line cursor is wrong.\n");
+    remove(get_name_file(f));
+    close_file(f);
+    return 1;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file prslog.c
+ * @author Philip R. Simonson
+ * @date 17 Oct 2026
+ * @brief Turn a binary log written by clogger back into text.
+ * @details
+ *
+ * Usage: prslog [-t] log [text]
+ *
+ * Reads a log made with set_binary_log() a record at a time, so logs of
+ * any size take little memory, and writes the messages to text or to
+ * standard output. With -t each message starts with its UTC time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "file.h"
+#include "clogger.h"
+
+/* Decode the log named on the command line.
+ */
+int main(int argc, char **argv)
+{
+	file_t *in, *out;
+	int stamp = 0, err;
+	long res;
+	if(argc > 1 && strcmp(argv[1], "-t") == 0) {
+		stamp = 1;
+		argc--;
+		argv++;
+	}
+	if(argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: prslog [-t] log [text]\n");
+		return 2;
+	}
+	in = open_file(argv[1], "rb");
+	if(in == NULL || (err = get_error_file()) != FILE_ERROR_OKAY) {
+		fprintf(stderr, "prslog: %s: %s\n", argv[1],
+			strerror_file(in == NULL ? FILE_ERROR_OPEN : err));
+		if(in != NULL)
+			close_file(in);
+		return 1;
+	}
+	out = (argc == 3) ? open_file(argv[2], "wb") : open_fd_file(1, "wb");
+	if(out == NULL || (err = get_error_file()) != FILE_ERROR_OKAY) {
+		fprintf(stderr, "prslog: %s: %s\n", (argc == 3) ? argv[2] :
+			"standard output",
+			strerror_file(out == NULL ? FILE_ERROR_OPEN : err));
+		if(out != NULL)
+			close_file(out);
+		close_file(in);
+		return 1;
+	}
+	res = decode_log(in, out, stamp);
+	close_file(in);
+	close_file(out);
+	if(res < 0) {
+		fprintf(stderr, "prslog: %s: not a binary log or damaged\n",
+			argv[1]);
+		return 1;
+	}
+	return 0;
+}